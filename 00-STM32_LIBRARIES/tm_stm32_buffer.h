@@ -28,7 +28,7 @@
 \endverbatim
  */
 #ifndef TM_BUFFER_H
-#define TM_BUFFER_H 130
+#define TM_BUFFER_H 140
 
 /* C++ detection */
 #ifdef __cplusplus
@@ -63,6 +63,12 @@ extern "C" {
     string is also filled in user buffer
 - In all other cases, if there is no string delimiter in buffer, buffer will not return anything and will check for it first.
 \endverbatim
+ *
+ * \par Shared implementation
+ *
+ * This library is an alias for generic buffer library (buffer.h/buffer.c) which is also used by WizFi360 library.
+ * There is only one implementation of cyclic buffer in project, and USART library and WizFi360 stack can share the same buffer structure.
+ * Buffer is lock-free single producer, single consumer buffer and its size must be power of 2.
  *
  * \par Changelog
  *
@@ -82,43 +88,22 @@ extern "C" {
   - December 25, 2015
   - Added option for writing strings to buffer
   - Write/Read is now interrupt safe
+
+ Version 1.4
+  - Library is now alias for generic buffer.h library, tm_stm32_buffer.c is removed
+  - Buffer size must be power of 2
 \endverbatim
  *
  * \par Dependencies
  *
 \verbatim
- - STM32Fxxx HAL
  - defines.h
+ - buffer.h
 \endverbatim
  */
 #include "defines.h"
-#include "stdlib.h"
-#include "string.h"
-#if defined(USE_HAL_DRIVER)
-#include "stm32fxxx_hal.h"
-#endif
-
-/**
- * @defgroup TM_BUFFER_Macros
- * @brief    Library defines
- * @{
- */
-
-#define BUFFER_INITIALIZED     0x01 /*!< Buffer initialized flag */
-#define BUFFER_MALLOC          0x02 /*!< Buffer uses malloc for memory */
-
-/* Custom allocation and free functions if needed */
-#ifndef LIB_ALLOC_FUNC
-#define LIB_ALLOC_FUNC         malloc
-#endif
-#ifndef LIB_FREE_FUNC
-#define LIB_FREE_FUNC          free
-#endif
+#include "buffer.h"
 
-/**
- * @}
- */
- 
 /**
  * @defgroup TM_BUFFER_Typedefs
  * @brief    Library Typedefs
@@ -126,17 +111,9 @@ extern "C" {
  */
 
 /**
- * @brief  Buffer structure
+ * @brief  Buffer structure, same as @ref BUFFER_t
  */
-typedef struct _TM_BUFFER_t {
-	uint16_t Size;           /*!< Size of buffer in units of bytes, DO NOT MOVE OFFSET, 0 */
-	uint16_t In;             /*!< Input pointer to save next value, DO NOT MOVE OFFSET, 1 */
-	uint16_t Out;            /*!< Output pointer to read next value, DO NOT MOVE OFFSET, 2 */
-	uint8_t* Buffer;         /*!< Pointer to buffer data array, DO NOT MOVE OFFSET, 3 */
-	uint8_t Flags;           /*!< Flags for buffer, DO NOT MOVE OFFSET, 4 */
-	uint8_t StringDelimiter; /*!< Character for string delimiter when reading from buffer as string, DO NOT MOVE OFFSET, 5 */
-	void* UserParameters;    /*!< Pointer to user value if needed */
-} TM_BUFFER_t;
+typedef BUFFER_t TM_BUFFER_t;
 
 /**
  * @}
@@ -144,126 +121,24 @@ typedef struct _TM_BUFFER_t {
 
 /**
  * @defgroup TM_BUFFER_Functions
- * @brief    Library Functions
+ * @brief    Library Functions, mapped to generic buffer functions. Check buffer.h for description
  * @{
  */
 
-/**
- * @brief  Initializes buffer structure for work
- * @param  *Buffer: Pointer to @ref TM_BUFFER_t structure to initialize
- * @param  Size: Size of buffer in units of bytes
- * @param  *BufferPtr: Pointer to array for buffer storage. Its length should be equal to @param Size parameter.
- *           If NULL is passed as parameter, @ref malloc will be used to allocate memory on heap.
- * @retval Buffer initialization status:
- *            - 0: Buffer initialized OK
- *            - > 0: Buffer initialization error. Malloc has failed with allocation
- */
-uint8_t TM_BUFFER_Init(TM_BUFFER_t* Buffer, uint16_t Size, uint8_t* BufferPtr);
-
-/**
- * @brief  Free memory for buffer allocated using @ref malloc
- * @note   This function has sense only if malloc was used for dynamic allocation
- * @param  *Buffer: Pointer to @ref TM_BUFFER_t structure
- * @retval None
- */
-void TM_BUFFER_Free(TM_BUFFER_t* Buffer);
-
-/**
- * @brief  Writes data to buffer
- * @param  *Buffer: Pointer to @ref TM_BUFFER_t structure
- * @param  *Data: Pointer to data to be written
- * @param  count: Number of elements of type unsigned char to write
- * @retval Number of elements written in buffer 
- */
-uint16_t TM_BUFFER_Write(TM_BUFFER_t* Buffer, uint8_t* Data, uint16_t count);
-
-/**
- * @brief  Reads data from buffer
- * @param  *Buffer: Pointer to @ref TM_BUFFER_t structure
- * @param  *Data: Pointer to data where read values will be stored
- * @param  count: Number of elements of type unsigned char to read
- * @retval Number of elements read from buffer 
- */
-uint16_t TM_BUFFER_Read(TM_BUFFER_t* Buffer, uint8_t* Data, uint16_t count);
-
-/**
- * @brief  Gets number of free elements in buffer 
- * @param  *Buffer: Pointer to @ref TM_BUFFER_t structure
- * @retval Number of free elements in buffer
- */
-uint16_t TM_BUFFER_GetFree(TM_BUFFER_t* Buffer);
-
-/**
- * @brief  Gets number of elements in buffer 
- * @param  *Buffer: Pointer to @ref TM_BUFFER_t structure
- * @retval Number of elements in buffer
- */
-uint16_t TM_BUFFER_GetFull(TM_BUFFER_t* Buffer);
-
-/**
- * @brief  Resets (clears) buffer pointers
- * @param  *Buffer: Pointer to @ref TM_BUFFER_t structure
- * @retval None
- */
-void TM_BUFFER_Reset(TM_BUFFER_t* Buffer);
-
-/**
- * @brief  Checks if specific element value is stored in buffer
- * @param  *Buffer: Pointer to @ref TM_BUFFER_t structure
- * @param  uint8_t Element: Element to check
- * @retval Status of element:
- *            -  < 0: Element was not found
- *            - >= 0: Element found, location in buffer is returned
- *                   Ex: If value 1 is returned, it means 1 read from buffer and your element will be returned
- */
-int16_t TM_BUFFER_FindElement(TM_BUFFER_t* Buffer, uint8_t Element);
-
-/**
- * @brief  Checks if specific data sequence are stored in buffer
- * @param  *Buffer: Pointer to @ref TM_BUFFER_t structure
- * @param  uint8_t* Data: Array with data sequence
- * @param  Size: Data size in units of bytes
- * @retval Status of sequence:
- *            -  < 0: Sequence was not found
- *            - >= 0: Sequence found, start sequence location in buffer is returned
- */
-int16_t TM_BUFFER_Find(TM_BUFFER_t* Buffer, uint8_t* Data, uint16_t Size);
-
-/**
- * @brief  Sets string delimiter character when reading from buffer as string
- * @param  Buffer: Pointer to @ref TM_BUFFER_t structure
- * @param  StringDelimIter: Character as string delimiter
- * @retval None
- */
-#define TM_BUFFER_SetStringDelimiter(Buffer, StrDel)  ((Buffer)->StringDelimiter = (StrDel))
-
-/**
- * @brief  Writes string formatted data to buffer
- * @param  *Buffer: Pointer to @ref TM_BUFFER_t structure
- * @param  *buff: Pointer to string to write 
- * @retval Number of characters written
- */
-uint16_t TM_BUFFER_WriteString(TM_BUFFER_t* Buffer, char* buff);
-
-/**
- * @brief  Reads from buffer as string
- * @param  *Buffer: Pointer to @ref TM_BUFFER_t structure
- * @param  *buff: Pointer to buffer where string will be stored
- * @param  buffsize: Buffer size in units of bytes
- * @retval Number of characters in string
- */
-uint16_t TM_BUFFER_ReadString(TM_BUFFER_t* Buffer, char* buff, uint16_t buffsize);
-
-/**
- * @brief  Checks if character exists in location in buffer
- * @param  *Buffer: Pointer to @ref TM_BUFFER_t structure
- * @param  pos: Position in buffer, starting from 0
- * @param  *element: Pointer to save value at desired position to be stored into
- * @retval Check status:
- *            - 0: Buffer is not so long as position desired
- *            - > 0: Position to check was inside buffer data size
- */
-int8_t TM_BUFFER_CheckElement(TM_BUFFER_t* Buffer, uint16_t pos, uint8_t* element);
+#define TM_BUFFER_Init                BUFFER_Init
+#define TM_BUFFER_Free                BUFFER_Free
+#define TM_BUFFER_Write               BUFFER_Write
+#define TM_BUFFER_WriteChar           BUFFER_WriteChar
+#define TM_BUFFER_Read                BUFFER_Read
+#define TM_BUFFER_GetFree             BUFFER_GetFree
+#define TM_BUFFER_GetFull             BUFFER_GetFull
+#define TM_BUFFER_Reset               BUFFER_Reset
+#define TM_BUFFER_FindElement         BUFFER_FindElement
+#define TM_BUFFER_Find                BUFFER_Find
+#define TM_BUFFER_SetStringDelimiter  BUFFER_SetStringDelimiter
+#define TM_BUFFER_WriteString         BUFFER_WriteString
+#define TM_BUFFER_ReadString          BUFFER_ReadString
+#define TM_BUFFER_CheckElement        BUFFER_CheckElement
 
 /**
  * @}
@@ -129,6 +129,44 @@
 
 #endif
 
+/* Buffers work with index masking, sizes must be power of 2 */
+#if defined(USART1) && !BUFFER_IS_POWER_OF_2(TM_USART1_BUFFER_SIZE)
+#error "TM_USART1_BUFFER_SIZE must be power of 2!"
+#endif
+#if defined(USART2) && !BUFFER_IS_POWER_OF_2(TM_USART2_BUFFER_SIZE)
+#error "TM_USART2_BUFFER_SIZE must be power of 2!"
+#endif
+#if defined(USART3) && !BUFFER_IS_POWER_OF_2(TM_USART3_BUFFER_SIZE)
+#error "TM_USART3_BUFFER_SIZE must be power of 2!"
+#endif
+#if defined(UART4) && !BUFFER_IS_POWER_OF_2(TM_UART4_BUFFER_SIZE)
+#error "TM_UART4_BUFFER_SIZE must be power of 2!"
+#endif
+#if defined(UART5) && !BUFFER_IS_POWER_OF_2(TM_UART5_BUFFER_SIZE)
+#error "TM_UART5_BUFFER_SIZE must be power of 2!"
+#endif
+#if defined(USART6) && !BUFFER_IS_POWER_OF_2(TM_USART6_BUFFER_SIZE)
+#error "TM_USART6_BUFFER_SIZE must be power of 2!"
+#endif
+#if defined(UART7) && !BUFFER_IS_POWER_OF_2(TM_UART7_BUFFER_SIZE)
+#error "TM_UART7_BUFFER_SIZE must be power of 2!"
+#endif
+#if defined(UART8) && !BUFFER_IS_POWER_OF_2(TM_UART8_BUFFER_SIZE)
+#error "TM_UART8_BUFFER_SIZE must be power of 2!"
+#endif
+#if defined(USART4) && !BUFFER_IS_POWER_OF_2(TM_USART4_BUFFER_SIZE)
+#error "TM_USART4_BUFFER_SIZE must be power of 2!"
+#endif
+#if defined(USART5) && !BUFFER_IS_POWER_OF_2(TM_USART5_BUFFER_SIZE)
+#error "TM_USART5_BUFFER_SIZE must be power of 2!"
+#endif
+#if defined(USART7) && !BUFFER_IS_POWER_OF_2(TM_USART7_BUFFER_SIZE)
+#error "TM_USART7_BUFFER_SIZE must be power of 2!"
+#endif
+#if defined(USART8) && !BUFFER_IS_POWER_OF_2(TM_USART8_BUFFER_SIZE)
+#error "TM_USART8_BUFFER_SIZE must be power of 2!"
+#endif
+
 /* Set variables for buffers */
 #ifdef USART1
 uint8_t USART1_Buffer[TM_USART1_BUFFER_SIZE];
@@ -196,7 +234,7 @@ TM_BUFFER_t TM_UART8 = {TM_UART8_BUFFER_SIZE, 0, 0, UART8_Buffer, 0, USART_STRIN
 
 /* STM32F0xx added */
 #ifdef USART4
-TM_BUFFER_t TM_USART4 = {TM_USART8_BUFFER_SIZE, 0, 0, USART4_Buffer, 0, USART_STRING_DELIMITER};
+TM_BUFFER_t TM_USART4 = {TM_USART4_BUFFER_SIZE, 0, 0, USART4_Buffer, 0, USART_STRING_DELIMITER};
 #endif
 #ifdef USART5
 TM_BUFFER_t TM_USART5 = {TM_USART5_BUFFER_SIZE, 0, 0, USART5_Buffer, 0, USART_STRING_DELIMITER};
@@ -217,7 +255,8 @@ void TM_UART5_InitPins(TM_USART_PinsPack_t pinspack);
 void TM_USART6_InitPins(TM_USART_PinsPack_t pinspack);
 void TM_UART7_InitPins(TM_USART_PinsPack_t pinspack);
 void TM_UART8_InitPins(TM_USART_PinsPack_t pinspack);
-static void TM_USART_INT_InsertToBuffer(TM_BUFFER_t* u, uint8_t c);
+static __INLINE void TM_USART_INT_InsertToBuffer(TM_BUFFER_t* u, uint8_t c);
+static __INLINE void TM_USART_INT_CheckErrors(USART_TypeDef* USARTx);
 static void TM_USART_INT_ClearAllFlags(USART_TypeDef* USARTx, IRQn_Type irq);
 static TM_BUFFER_t* TM_USART_INT_GetUSARTBuffer(USART_TypeDef* USARTx);
 static uint8_t TM_USART_INT_GetSubPriority(USART_TypeDef* USARTx);
@@ -442,9 +481,29 @@ __weak void TM_USART_InitCustomPinsCallback(USART_TypeDef* USARTx, uint16_t Alte
 	*/
 }
 
+__weak void TM_USART_IdleLineCallback(USART_TypeDef* USARTx) { 
+	/* NOTE: This function Should not be modified, when the callback is needed,
+           the TM_USART_IdleLineCallback could be implemented in the user file
+	*/
+}
+
+__weak void TM_USART_ErrorCallback(USART_TypeDef* USARTx) { 
+	/* NOTE: This function Should not be modified, when the callback is needed,
+           the TM_USART_ErrorCallback could be implemented in the user file
+	*/
+}
+
 /* Private functions */
-static void TM_USART_INT_InsertToBuffer(TM_BUFFER_t* u, uint8_t c) {
-	TM_BUFFER_Write(u, &c, 1);
+static __INLINE void TM_USART_INT_InsertToBuffer(TM_BUFFER_t* u, uint8_t c) {
+	/* Store byte directly, without function call in interrupt */
+	TM_BUFFER_WriteChar(u, c);
+}
+
+static __INLINE void TM_USART_INT_CheckErrors(USART_TypeDef* USARTx) {
+	/* Notify parity, framing, noise and overrun errors */
+	if (USARTx->USART_STATUS_REG & USART_ISR_ERRORS) {
+		TM_USART_ErrorCallback(USARTx);
+	}
 }
 
 static TM_BUFFER_t* TM_USART_INT_GetUSARTBuffer(USART_TypeDef* USARTx) {
@@ -845,6 +904,9 @@ void TM_USART8_InitPins(TM_USART_PinsPack_t pinspack) {
 /* Interrupt handlers */
 #ifdef USART1
 void USART1_IRQHandler(void) {
+	/* Report receive errors before data register read clears them */
+	TM_USART_INT_CheckErrors(USART1);
+	
 	/* Check if interrupt was because data is received */
 	if (USART1->USART_STATUS_REG & USART_ISR_RXNE) {
 #ifdef TM_USART1_USE_CUSTOM_IRQ
@@ -863,6 +925,9 @@ void USART1_IRQHandler(void) {
 
 #ifdef USART2
 void USART2_IRQHandler(void) {
+	/* Report receive errors before data register read clears them */
+	TM_USART_INT_CheckErrors(USART2);
+	
 	/* Check if interrupt was because data is received */
 	if (USART2->USART_STATUS_REG & USART_ISR_RXNE) {
 #ifdef TM_USART2_USE_CUSTOM_IRQ
@@ -881,6 +946,9 @@ void USART2_IRQHandler(void) {
 
 #ifdef USART3
 void USART3_IRQHandler(void) {
+	/* Report receive errors before data register read clears them */
+	TM_USART_INT_CheckErrors(USART3);
+	
 	/* Check if interrupt was because data is received */
 	if (USART3->USART_STATUS_REG & USART_ISR_RXNE) {
 #ifdef TM_USART3_USE_CUSTOM_IRQ
@@ -899,6 +967,9 @@ void USART3_IRQHandler(void) {
 
 #ifdef UART4
 void UART4_IRQHandler(void) {
+	/* Report receive errors before data register read clears them */
+	TM_USART_INT_CheckErrors(UART4);
+	
 	/* Check if interrupt was because data is received */
 	if (UART4->USART_STATUS_REG & USART_ISR_RXNE) {
 #ifdef TM_UART4_USE_CUSTOM_IRQ
@@ -917,6 +988,9 @@ void UART4_IRQHandler(void) {
 
 #ifdef UART5
 void UART5_IRQHandler(void) {
+	/* Report receive errors before data register read clears them */
+	TM_USART_INT_CheckErrors(UART5);
+	
 	/* Check if interrupt was because data is received */
 	if (UART5->USART_STATUS_REG & USART_ISR_RXNE) {
 #ifdef TM_UART5_USE_CUSTOM_IRQ
@@ -935,6 +1009,9 @@ void UART5_IRQHandler(void) {
 
 #ifdef USART6
 void USART6_IRQHandler(void) {
+	/* Report receive errors before data register read clears them */
+	TM_USART_INT_CheckErrors(USART6);
+	
 	/* Check if interrupt was because data is received */
 	if (USART6->USART_STATUS_REG & USART_ISR_RXNE) {
 #ifdef TM_USART6_USE_CUSTOM_IRQ
@@ -953,6 +1030,9 @@ void USART6_IRQHandler(void) {
 
 #ifdef UART7
 void UART7_IRQHandler(void) {
+	/* Report receive errors before data register read clears them */
+	TM_USART_INT_CheckErrors(UART7);
+	
 	/* Check if interrupt was because data is received */
 	if (UART7->USART_STATUS_REG & USART_ISR_RXNE) {
 #ifdef TM_UART7_USE_CUSTOM_IRQ
@@ -971,6 +1051,9 @@ void UART7_IRQHandler(void) {
 
 #ifdef UART8
 void UART8_IRQHandler(void) {
+	/* Report receive errors before data register read clears them */
+	TM_USART_INT_CheckErrors(UART8);
+	
 	/* Check if interrupt was because data is received */
 	if (UART8->USART_STATUS_REG & USART_ISR_RXNE) {
 #ifdef TM_UART8_USE_CUSTOM_IRQ
@@ -990,6 +1073,9 @@ void UART8_IRQHandler(void) {
 #if defined(STM32F0xx)
 #ifdef USART8
 void USART3_8_IRQHandler(void) {
+	/* Report receive errors before data register read clears them */
+	TM_USART_INT_CheckErrors(USART3);
+	
 	/* Check if interrupt was because data is received */
 	if (USART3->USART_STATUS_REG & USART_ISR_RXNE) {
 #ifdef TM_USART3_USE_CUSTOM_IRQ
@@ -1001,6 +1087,9 @@ void USART3_8_IRQHandler(void) {
 #endif
 	}
 
+	/* Report receive errors before data register read clears them */
+	TM_USART_INT_CheckErrors(USART4);
+	
 	/* Check if interrupt was because data is received */
 	if (USART4->USART_STATUS_REG & USART_ISR_RXNE) {
 #ifdef TM_USART4_USE_CUSTOM_IRQ
@@ -1012,6 +1101,9 @@ void USART3_8_IRQHandler(void) {
 #endif
 	}
 
+	/* Report receive errors before data register read clears them */
+	TM_USART_INT_CheckErrors(USART5);
+	
 	/* Check if interrupt was because data is received */
 	if (USART5->USART_STATUS_REG & USART_ISR_RXNE) {
 #ifdef TM_USART5_USE_CUSTOM_IRQ
@@ -1023,6 +1115,9 @@ void USART3_8_IRQHandler(void) {
 #endif
 	}
 
+	/* Report receive errors before data register read clears them */
+	TM_USART_INT_CheckErrors(USART6);
+	
 	/* Check if interrupt was because data is received */
 	if (USART6->USART_STATUS_REG & USART_ISR_RXNE) {
 #ifdef TM_USART6_USE_CUSTOM_IRQ
@@ -1034,6 +1129,9 @@ void USART3_8_IRQHandler(void) {
 #endif
 	}
 
+	/* Report receive errors before data register read clears them */
+	TM_USART_INT_CheckErrors(USART7);
+	
 	/* Check if interrupt was because data is received */
 	if (USART7->USART_STATUS_REG & USART_ISR_RXNE) {
 #ifdef TM_USART7_USE_CUSTOM_IRQ
@@ -1045,6 +1143,9 @@ void USART3_8_IRQHandler(void) {
 #endif
 	}
 
+	/* Report receive errors before data register read clears them */
+	TM_USART_INT_CheckErrors(USART8);
+	
 	/* Check if interrupt was because data is received */
 	if (USART8->USART_STATUS_REG & USART_ISR_RXNE) {
 #ifdef TM_USART8_USE_CUSTOM_IRQ
@@ -1066,6 +1167,9 @@ void USART3_8_IRQHandler(void) {
 }
 #elif defined(USART6)
 void USART3_6_IRQHandler(void) {
+	/* Report receive errors before data register read clears them */
+	TM_USART_INT_CheckErrors(USART3);
+	
 	/* Check if interrupt was because data is received */
 	if (USART3->USART_STATUS_REG & USART_ISR_RXNE) {
 #ifdef TM_USART3_USE_CUSTOM_IRQ
@@ -1077,6 +1181,9 @@ void USART3_6_IRQHandler(void) {
 #endif
 	}
 
+	/* Report receive errors before data register read clears them */
+	TM_USART_INT_CheckErrors(USART4);
+	
 	/* Check if interrupt was because data is received */
 	if (USART4->USART_STATUS_REG & USART_ISR_RXNE) {
 #ifdef TM_USART4_USE_CUSTOM_IRQ
@@ -1088,6 +1195,9 @@ void USART3_6_IRQHandler(void) {
 #endif
 	}
 
+	/* Report receive errors before data register read clears them */
+	TM_USART_INT_CheckErrors(USART5);
+	
 	/* Check if interrupt was because data is received */
 	if (USART5->USART_STATUS_REG & USART_ISR_RXNE) {
 #ifdef TM_USART5_USE_CUSTOM_IRQ
@@ -1099,6 +1209,9 @@ void USART3_6_IRQHandler(void) {
 #endif
 	}
 
+	/* Report receive errors before data register read clears them */
+	TM_USART_INT_CheckErrors(USART6);
+	
 	/* Check if interrupt was because data is received */
 	if (USART6->USART_STATUS_REG & USART_ISR_RXNE) {
 #ifdef TM_USART6_USE_CUSTOM_IRQ
@@ -1118,6 +1231,9 @@ void USART3_6_IRQHandler(void) {
 }
 #elif defined(USART4)
 void USART3_6_IRQHandler(void) {
+	/* Report receive errors before data register read clears them */
+	TM_USART_INT_CheckErrors(USART3);
+	
 	/* Check if interrupt was because data is received */
 	if (USART3->USART_STATUS_REG & USART_ISR_RXNE) {
 #ifdef TM_USART3_USE_CUSTOM_IRQ
@@ -1129,6 +1245,9 @@ void USART3_6_IRQHandler(void) {
 #endif
 	}
 
+	/* Report receive errors before data register read clears them */
+	TM_USART_INT_CheckErrors(USART4);
+	
 	/* Check if interrupt was because data is received */
 	if (USART4->USART_STATUS_REG & USART_ISR_RXNE) {
 #ifdef TM_USART4_USE_CUSTOM_IRQ
@@ -1369,6 +1488,11 @@ static void TM_USART_INT_Init(
 
 static UART_HandleTypeDef UART_Handle;
 static void TM_USART_INT_ClearAllFlags(USART_TypeDef* USARTx, IRQn_Type irq) {
+	/* Notify idle line, if enabled, before flag is cleared */
+	if ((USARTx->CR1 & USART_CR1_IDLEIE) && (USARTx->USART_STATUS_REG & USART_ISR_IDLE)) {
+		TM_USART_IdleLineCallback(USARTx);
+	}
+	
 	UART_Handle.Instance = USARTx;
 	
 #ifdef __HAL_UART_CLEAR_PEFLAG
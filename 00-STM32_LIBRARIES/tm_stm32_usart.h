@@ -28,7 +28,7 @@
 \endverbatim
  */
 #ifndef TM_USART_H
-#define TM_USART_H 120
+#define TM_USART_H 150
 
 /* C++ detection */
 #ifdef __cplusplus
@@ -78,6 +78,11 @@ void TM_X_ReceiveHandler(uint8_t c) {
  *
  * @note If you use custom receive interrupt handler, then incoming data is not stored in internal buffer
  *
+ * When received bytes are only passed to another library's cyclic buffer, custom handler is not needed.
+ * Internal buffers are @ref TM_BUFFER_t structures (same implementation as WizFi360 library buffer),
+ * so library can use USART buffer (eg. <code>&TM_USART1</code>) directly as its receive buffer.
+ * Interrupt stores each byte into it with inline write, without any other function call.
+ *
  * \par USART Internal cyclic buffer
  *
  * In your project you can set internal cyclic buffer length, default is 32Bytes, with:
@@ -88,6 +93,7 @@ void TM_X_ReceiveHandler(uint8_t c) {
 \endcode
  *
  * in your project's defines.h file. This will set default length for each buffer.
+ * Buffer size must be power of 2, otherwise compilation fails.
  * So if you are working with F429 (it has 8 U(S)ARTs) then you will use 8kB RAM if 
  * you set define above to 1024.
  *
@@ -181,6 +187,18 @@ USART8       |PC2    PC3     |PC8    PC9     |PD13   PD14
   - December 26, 2015
   - On reinitialization USART with other baudrate, USART didn't work properly and needs some time to start.
   - With forcing register reset this has been fixed
+   
+ Version 1.3
+  - Buffers use shared cyclic buffer implementation, sizes must be power of 2
+  - Received byte is stored into buffer with inline write in interrupt
+  - Internal buffers are exported to be used directly by other libraries
+  - Fixed USART4 buffer size on STM32F0xx
+   
+ Version 1.4
+  - Added TM_USART_IdleLineCallback for idle line interrupt
+   
+ Version 1.5
+  - Added TM_USART_ErrorCallback for receive errors
 \endverbatim
  *
  * \b Dependencies
@@ -502,6 +520,18 @@ typedef enum {
 #if !defined(USART_ISR_RXNE)
 #define USART_ISR_RXNE                      USART_SR_RXNE
 #endif
+#if !defined(USART_ISR_IDLE)
+#define USART_ISR_IDLE                      USART_SR_IDLE
+#endif
+#if !defined(USART_ISR_ORE)
+#define USART_ISR_PE                        USART_SR_PE
+#define USART_ISR_FE                        USART_SR_FE
+#define USART_ISR_NE                        USART_SR_NE
+#define USART_ISR_ORE                       USART_SR_ORE
+#endif
+
+/* Receive error flags */
+#define USART_ISR_ERRORS                    (USART_ISR_PE | USART_ISR_FE | USART_ISR_NE | USART_ISR_ORE)
 
 /**
  * @brief  Default string delimiter for USART
@@ -524,6 +554,44 @@ typedef enum {
 /* Wait for TX empty */
 #define USART_WAIT(USARTx)                  while (!((USARTx)->USART_STATUS_REG & USART_FLAG_TXE))
 
+/* Internal receive buffers, filled in RX interrupt when custom IRQ handler is not used */
+#ifdef USART1
+extern TM_BUFFER_t TM_USART1;
+#endif
+#ifdef USART2
+extern TM_BUFFER_t TM_USART2;
+#endif
+#ifdef USART3
+extern TM_BUFFER_t TM_USART3;
+#endif
+#ifdef UART4
+extern TM_BUFFER_t TM_UART4;
+#endif
+#ifdef UART5
+extern TM_BUFFER_t TM_UART5;
+#endif
+#ifdef USART6
+extern TM_BUFFER_t TM_USART6;
+#endif
+#ifdef UART7
+extern TM_BUFFER_t TM_UART7;
+#endif
+#ifdef UART8
+extern TM_BUFFER_t TM_UART8;
+#endif
+#ifdef USART4
+extern TM_BUFFER_t TM_USART4;
+#endif
+#ifdef USART5
+extern TM_BUFFER_t TM_USART5;
+#endif
+#ifdef USART7
+extern TM_BUFFER_t TM_USART7;
+#endif
+#ifdef USART8
+extern TM_BUFFER_t TM_USART8;
+#endif
+
  /**
  * @}
  */
@@ -686,6 +754,29 @@ int16_t TM_USART_FindString(USART_TypeDef* USARTx, char* str);
  */
 void TM_USART_InitCustomPinsCallback(USART_TypeDef* USARTx, uint16_t AlternateFunction);
 
+/**
+ * @brief  Callback for idle line detection on USARTx.
+ *
+ *         Called from USART interrupt handler when idle line interrupt is enabled (USART_CR1_IDLEIE bit set by user)
+ *         and line became idle after received data. Useful together with DMA reception.
+ * @note   With __weak parameter to prevent link errors if not defined by user
+ * @param  *USARTx: Pointer to USARTx peripheral where idle line was detected
+ * @retval None
+ */
+void TM_USART_IdleLineCallback(USART_TypeDef* USARTx);
+
+/**
+ * @brief  Callback for receive errors on USARTx.
+ *
+ *         Called from USART interrupt handler when parity, framing, noise or overrun error flag is set,
+ *         before received data are read and flags are cleared. Error interrupt is generated only on received byte,
+ *         unless USART_CR3_EIE bit is set by user (needed with DMA reception).
+ * @note   With __weak parameter to prevent link errors if not defined by user
+ * @param  *USARTx: Pointer to USARTx peripheral where error was detected
+ * @retval None
+ */
+void TM_USART_ErrorCallback(USART_TypeDef* USARTx);
+
 /**
  * @brief  Callback function for receive interrupt on USART1 in case you have enabled custom USART handler mode 
  * @note   With __weak parameter to prevent link errors if not defined by user
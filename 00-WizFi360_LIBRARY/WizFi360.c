@@ -66,22 +66,114 @@
 /* Maximum number of return data size in one +IPD from WizFi360 module */
 #define ESP8255_MAX_BUFF_SIZE          5842
 
-/* Temporary buffer */
-static BUFFER_t TMP_Buffer;
-static BUFFER_t USART_Buffer;
-static uint8_t TMPBuffer[WizFi360_TMPBUFFER_SIZE];
-static uint8_t USARTBuffer[WizFi360_USARTBUFFER_SIZE];
+/* Cyclic buffers work with index masking */
+#if !BUFFER_IS_POWER_OF_2(WizFi360_TMPBUFFER_SIZE)
+#error "WizFi360_TMPBUFFER_SIZE must be power of 2!"
+#endif
+#if WizFi360_TMPBUFFER_SIZE > BUFFER_MAX_SIZE
+#error "Buffer size is too big for 16-bit buffer indexes, define BUFFER_WIDE_INDEX = 1 in global compiler defines!"
+#endif
 
-#if WizFi360_USE_APSEARCH
-/* AP list */
-static WizFi360_APs_t WizFi360_APs;
+/* USART buffer, transport can fill its own buffer directly */
+#if !BUFFER_IS_POWER_OF_2(WizFi360_USARTBUFFER_SIZE)
+#error "WizFi360_USARTBUFFER_SIZE must be power of 2!"
+#endif
+#if WizFi360_USARTBUFFER_SIZE > BUFFER_MAX_SIZE
+#error "Buffer size is too big for 16-bit buffer indexes, define BUFFER_WIDE_INDEX = 1 in global compiler defines!"
 #endif
 
-/* Create data array for connections */
-#if WizFi360_USE_SINGLE_CONNECTION_BUFFER == 1
-static char ConnectionData[WizFi360_CONNECTION_BUFFER_SIZE]; /*!< Data array */
+/* Transmit buffer, sent in background by transport if it supports it */
+#if WizFi360_TXBUFFER_SIZE
+#if !BUFFER_IS_POWER_OF_2(WizFi360_TXBUFFER_SIZE)
+#error "WizFi360_TXBUFFER_SIZE must be power of 2!"
+#endif
+#if WizFi360_TXBUFFER_SIZE > BUFFER_MAX_SIZE
+#error "Buffer size is too big for 16-bit buffer indexes, define BUFFER_WIDE_INDEX = 1 in global compiler defines!"
+#endif
+#endif
+
+/* RTS flow control watermarks in percent of USART buffer */
+#if WizFi360_FLOWCONTROL_LOW >= WizFi360_FLOWCONTROL_HIGH || WizFi360_FLOWCONTROL_HIGH > 100
+#error "WizFi360_FLOWCONTROL_LOW must be lower than WizFi360_FLOWCONTROL_HIGH, both in percent!"
 #endif
 
+/* RTS/CTS flow control is used on module when transport controls both lines */
+#define WizFi360_FLOWCONTROL_AVAILABLE(WizFi360)  ((WizFi360)->Transport->FlowControl && (WizFi360)->Transport->SetRTS)
+
+/* Delay with transport */
+#define WizFi360_DELAYMS(WizFi360, x)             (WizFi360)->Transport->Delay((WizFi360)->Transport->Arg, (x))
+
+/* Tokens detected directly in USART buffer as they arrive, other responses are handled by line parser */
+#define WizFi360_TOKEN_WRAPPER          0
+#define WizFi360_TOKEN_OK               1
+static const char* const WizFi360_Tokens[] = {
+	"> ", "OK\r\n"
+};
+
+/* Received line types, lines up to IPD are accepted during any active command */
+#define WizFi360_LINE_OTHER             0
+#define WizFi360_LINE_OK                1
+#define WizFi360_LINE_SENDOK            2
+#define WizFi360_LINE_ERROR             3
+#define WizFi360_LINE_READY             4
+#define WizFi360_LINE_BUSY              5
+#define WizFi360_LINE_IPD               6
+#define WizFi360_LINE_FAIL              7
+#define WizFi360_LINE_WDTRESET          8
+#define WizFi360_LINE_WIFICONNECTED     9
+#define WizFi360_LINE_WIFIDISCONNECT    10
+#define WizFi360_LINE_WIFIGOTIP         11
+#define WizFi360_LINE_CONNECT           12
+#define WizFi360_LINE_CLOSED            13
+#define WizFi360_LINE_CONNECTFAIL       14
+#define WizFi360_LINE_ALREADYCONNECTED  15
+#define WizFi360_LINE_ISRESPONSE(line)  ((line) != WizFi360_LINE_OTHER && (line) <= WizFi360_LINE_IPD)
+#define WizFi360_LINE_HASLINK(line)     ((line) == WizFi360_LINE_IPD || ((line) >= WizFi360_LINE_CONNECT && (line) <= WizFi360_LINE_CONNECTFAIL))
+
+/* Known lines, compared character by character as they are received. '#' stands for link ID digit */
+typedef struct {
+	const char* Str;
+	uint8_t Length;
+	uint8_t Line;
+} WizFi360_Line_t;
+static const WizFi360_Line_t WizFi360_Lines[] = {
+	{"OK\r\n", 4, WizFi360_LINE_OK},
+	{"\r\n", 2, WizFi360_LINE_OTHER},
+	{"SEND OK\r\n", 9, WizFi360_LINE_SENDOK},
+	{"+IPD,", 5, WizFi360_LINE_IPD},
+	{"#,CONNECT\r\n", 11, WizFi360_LINE_CONNECT},
+	{"#,CLOSED\r\n", 10, WizFi360_LINE_CLOSED},
+	{"#,CONNECT FAIL\r\n", 16, WizFi360_LINE_CONNECTFAIL},
+	{"> ", 2, WizFi360_LINE_OTHER},
+	{"ERROR\r\n", 7, WizFi360_LINE_ERROR},
+	{"busy p...\r\n", 11, WizFi360_LINE_BUSY},
+	{"ready\r\n", 7, WizFi360_LINE_READY},
+	{"WIFI CONNECTED\r\n", 16, WizFi360_LINE_WIFICONNECTED},
+	{"WIFI GOT IP\r\n", 13, WizFi360_LINE_WIFIGOTIP},
+	{"WIFI DISCONNECT\r\n", 17, WizFi360_LINE_WIFIDISCONNECT},
+	{"FAIL\r\n", 6, WizFi360_LINE_FAIL},
+	{"wdt reset\r\n", 11, WizFi360_LINE_WDTRESET},
+	{"ALREADY CONNECTED\r\n", 19, WizFi360_LINE_ALREADYCONNECTED},
+};
+#define WizFi360_LINES_COUNT            (sizeof(WizFi360_Lines) / sizeof(WizFi360_Lines[0]))
+#define WizFi360_LINE_CHAR(c, ch)       ((c) == (ch) || ((c) == '#' && (ch) >= '0' && (ch) <= '9'))
+
+/* Data sent confirmation can also follow other text without new line */
+#define WizFi360_SENDOK_SUFFIX          "SEND OK\r\n"
+
+/* Stream parser states */
+#define WizFi360_PARSER_START           0 /* Start of new line */
+#define WizFi360_PARSER_LINE            1 /* Current line is compared with known line */
+#define WizFi360_PARSER_IPD             2 /* Numbers of +IPD header are parsed, header ends with colon */
+#define WizFi360_PARSER_SKIP            3 /* Unknown line is skipped to its end */
+#define WizFi360_PARSER_RESPONSE        4 /* Command response is left in USART buffer until complete line is received */
+
+/* Fields of +IPD header, IP address takes 4 fields */
+#define WizFi360_IPD_FIELD_LINK         0
+#define WizFi360_IPD_FIELD_LENGTH       1
+#define WizFi360_IPD_FIELD_IP           2
+#define WizFi360_IPD_FIELD_PORT         6
+
 /* Private functions */
 #if WizFi360_USE_APSEARCH
 static void ParseCWLAP(WizFi360_t* WizFi360, char* Buffer);
@@ -92,15 +184,41 @@ static void ParseCWJAP(WizFi360_t* WizFi360, char* Buffer);
 static void ParseCWLIF(WizFi360_t* WizFi360, char* Buffer);
 static void ParseIP(char* ip_str, uint8_t* arr, uint8_t* cnt);
 static void ParseMAC(char* ptr, uint8_t* arr, uint8_t* cnt);
-static void ParseReceived(WizFi360_t* WizFi360, char* Received, uint8_t from_usart_buffer, uint16_t bufflen);
-void CopyCharacterUSART2TMP(WizFi360_t* WizFi360);
-static char* EscapeString(char* str);
-char* ReverseEscapeString(char* str);
+static void ParseReceived(WizFi360_t* WizFi360, uint8_t line, uint8_t link, char* Received, uint8_t from_usart_buffer);
+static uint8_t FindLine(uint8_t line, uint8_t length, uint8_t ch);
+static void ParseConnectionStatus(WizFi360_t* WizFi360, uint8_t line, uint8_t link);
+static void ParseStream(WizFi360_t* WizFi360);
+static uint8_t ParseResponse(WizFi360_t* WizFi360, BUFFER_Pos_t checked);
+static void ResetUSARTBuffer(WizFi360_t* WizFi360);
 static WizFi360_Result_t SendCommand(WizFi360_t* WizFi360, uint8_t Command, char* CommandStr, char* StartRespond);
+static WizFi360_Result_t StartCommand(WizFi360_t* WizFi360, uint8_t Command, char* StartRespond);
+static void CommandAdd(WizFi360_t* WizFi360, const void* data, uint16_t length, uint8_t persistent);
+static void CommandAddString(WizFi360_t* WizFi360, const char* str);
+static void CommandAddEscaped(WizFi360_t* WizFi360, const char* str);
+static void CommandAddNumber(WizFi360_t* WizFi360, uint32_t num);
+static void CommandAddHex(WizFi360_t* WizFi360, uint8_t num);
+static char* CommandAlloc(WizFi360_t* WizFi360, uint8_t length);
+static void CommandEnd(WizFi360_t* WizFi360);
+static void CommandFlush(WizFi360_t* WizFi360);
+static void DetectBaudrateReset(WizFi360_t* WizFi360);
+#if WizFi360_USE_BAUDRATE_PROBE
+static void DetectBaudrateProbe(WizFi360_t* WizFi360);
+#endif
 static WizFi360_Result_t SendUARTCommand(WizFi360_t* WizFi360, uint32_t baudrate, char* cmd);
+static void SetUSARTBaudrate(WizFi360_t* WizFi360, uint32_t baudrate);
+#if WizFi360_USE_BAUDRATE_ESCALATION
+static void EscalateBaudrate(WizFi360_t* WizFi360);
+static uint8_t TestBaudrate(WizFi360_t* WizFi360);
+#endif
 static WizFi360_Result_t SendMACCommand(WizFi360_t* WizFi360, uint8_t* addr, char* cmd, uint8_t command);
 static void CallConnectionCallbacks(WizFi360_t* WizFi360);
 static void ProcessSendData(WizFi360_t* WizFi360);
+static void ProcessTokens(WizFi360_t* WizFi360);
+static void TransmitBlocks(WizFi360_t* WizFi360, const WizFi360_LL_Block_t* Blocks, uint8_t count);
+static void FlowControlUpdate(WizFi360_t* WizFi360);
+static void TokenReceived(void* arg, uint8_t token, BUFFER_Pos_t pos);
+static void GetBufferStats(BUFFER_t* Buffer, WizFi360_BufferStats_t* Stats);
+static uint32_t AdviseBufferSize(uint32_t required, WizFi360_BufferStats_t* Stats, uint32_t min);
 void* mem_mem(void* haystack, size_t haystacksize, void* needle, size_t needlesize);
 
 #define CHARISNUM(x)    ((x) >= '0' && (x) <= '9')
@@ -115,6 +233,13 @@ static uint32_t WizFi360_Baudrate[] = {
 	9600, 57600, 115200, 921600
 };
 
+#if WizFi360_USE_BAUDRATE_ESCALATION
+/* List of baudrates tried with escalation */
+static const uint32_t WizFi360_EscalationBaudrate[] = {
+	WizFi360_ESCALATION_BAUDRATES
+};
+#endif
+
 /* Check IDLE */
 #define WizFi360_CHECK_IDLE(WizFi360)                         \
 do {                                                        \
@@ -158,80 +283,117 @@ do {                                                        \
 /******************************************/
 /*          Basic AT commands Set         */
 /******************************************/
-WizFi360_Result_t WizFi360_Init(WizFi360_t* WizFi360, uint32_t baudrate) {
-	uint8_t i;
-	
+WizFi360_Result_t WizFi360_Init(WizFi360_t* WizFi360, uint32_t baudrate, const WizFi360_Transport_t* transport) {
 	/* Save settings */
 	WizFi360->Timeout = 0;
 	
-	/* Init temporary buffer */
-	if (BUFFER_Init(&TMP_Buffer, WizFi360_TMPBUFFER_SIZE, TMPBuffer)) {
+	/* Check transport, required functions must be set */
+	if (transport == NULL || !transport->Open || !transport->Send || !transport->SetBaudrate || !transport->Delay) {
 		/* Return from function */
-		WizFi360_RETURNWITHSTATUS(WizFi360, ESP_NOHEAP);
+		WizFi360_RETURNWITHSTATUS(WizFi360, ESP_ERROR);
 	}
 	
-	/* Init USART working */
-	if (BUFFER_Init(&USART_Buffer, WizFi360_USARTBUFFER_SIZE, USARTBuffer)) {
+	/* Save transport */
+	WizFi360->Transport = transport;
+	
+	/* Init temporary buffer */
+	if (BUFFER_Init(&WizFi360->TMP_Buffer, WizFi360_TMPBUFFER_SIZE, WizFi360->TMPBuffer)) {
 		/* Return from function */
 		WizFi360_RETURNWITHSTATUS(WizFi360, ESP_NOHEAP);
 	}
-
-	/* Init RESET pin */
-	WizFi360_RESET_INIT;
-	
-	/* Set pin low */
-	WizFi360_RESET_LOW;
 	
-	/* Delay for while */
-	WizFi360_DELAYMS(100);
+	if (WizFi360->Transport->RxBuffer) {
+		/* Use USART buffer from transport */
+		WizFi360->USART_Buffer = WizFi360->Transport->RxBuffer;
+		
+		/* Check if it can be used */
+		if (WizFi360->USART_Buffer->Size == 0 || !BUFFER_IS_POWER_OF_2(WizFi360->USART_Buffer->Size)) {
+			/* Return from function */
+			WizFi360_RETURNWITHSTATUS(WizFi360, ESP_ERROR);
+		}
+		
+		/* Responses are parsed line by line */
+		BUFFER_SetStringDelimiter(WizFi360->USART_Buffer, '\n');
+	} else {
+#if WizFi360_USE_USARTBUFFER
+		/* Init USART working */
+		WizFi360->USART_Buffer = &WizFi360->USART_BufferData;
+		if (BUFFER_Init(WizFi360->USART_Buffer, WizFi360_USARTBUFFER_SIZE, WizFi360->USARTBuffer)) {
+			/* Return from function */
+			WizFi360_RETURNWITHSTATUS(WizFi360, ESP_NOHEAP);
+		}
+#else
+		/* Stack has no USART buffer, transport must provide it */
+		WizFi360_RETURNWITHSTATUS(WizFi360, ESP_ERROR);
+#endif
+	}
 	
-	/* Set pin high */
-	WizFi360_RESET_HIGH;
+#if WizFi360_TXBUFFER_SIZE
+	/* Init transmit buffer */
+	if (BUFFER_Init(&WizFi360->TX_Buffer, WizFi360_TXBUFFER_SIZE, WizFi360->TXBuffer)) {
+		/* Return from function */
+		WizFi360_RETURNWITHSTATUS(WizFi360, ESP_NOHEAP);
+	}
+#endif
 	
-	/* Delay for while */
-	WizFi360_DELAYMS(100);
+	/* Set flow control watermarks */
+	WizFi360->FlowControl_High = (uint32_t)WizFi360->USART_Buffer->Size * WizFi360_FLOWCONTROL_HIGH / 100;
+	WizFi360->FlowControl_Low = (uint32_t)WizFi360->USART_Buffer->Size * WizFi360_FLOWCONTROL_LOW / 100;
+	WizFi360->FlowControl_Stopped = 0;
 	
+	/* Init token matcher for USART buffer */
+	if (BUFFER_MatcherInit(&WizFi360->USART_Matcher, WizFi360_Tokens, sizeof(WizFi360_Tokens) / sizeof(WizFi360_Tokens[0]))) {
+		/* Return from function */
+		WizFi360_RETURNWITHSTATUS(WizFi360, ESP_ERROR);
+	}
+
 	/* Save current baudrate */
 	WizFi360->Baudrate = baudrate;
 	
-	/* Init USART */
-	WizFi360_LL_USARTInit(WizFi360->Baudrate);
+	/* Module starts without flow control */
+	if (WizFi360->Transport->FlowControl) {
+		WizFi360->Transport->FlowControl(WizFi360->Transport->Arg, 0);
+	}
 	
-	/* Set allowed timeout */
-	WizFi360->Timeout = 1000;
+	/* Open transport */
+	if (WizFi360->Transport->Open(WizFi360->Transport->Arg, WizFi360, WizFi360->Baudrate)) {
+		/* Return from function */
+		WizFi360_RETURNWITHSTATUS(WizFi360, ESP_ERROR);
+	}
 	
-	/* Reset device */
-	SendCommand(WizFi360, WizFi360_COMMAND_RST, "AT+RST\r\n", "ready\r\n");
+	/* Allow module to send */
+	if (WizFi360->Transport->SetRTS) {
+		WizFi360->Transport->SetRTS(WizFi360->Transport->Arg, 0);
+	}
 	
-	/* Wait till idle */
-	WizFi360_WaitReady(WizFi360);
-
-	/* Check status */
-	if (!WizFi360->Flags.F.LastOperationStatus) {
-		/* Check for baudrate, try with predefined baudrates */
-		for (i = 0; i < sizeof(WizFi360_Baudrate) / sizeof(WizFi360_Baudrate[0]); i++) {
-			/* Init USART */
-			WizFi360_LL_USARTInit(WizFi360->Baudrate);
-			
-			/* Set allowed timeout */
-			WizFi360->Timeout = 1000;
-			
-			/* Reset device */
-			SendCommand(WizFi360, WizFi360_COMMAND_RST, "AT+RST\r\n", "ready\r\n");
-			
-			/* Wait till idle */
-			WizFi360_WaitReady(WizFi360);
+	/* Reset module if transport has reset pin */
+	if (WizFi360->Transport->Reset) {
+		/* Set pin low */
+		WizFi360->Transport->Reset(WizFi360->Transport->Arg, 0);
 		
-			/* Check status */
-			if (WizFi360->Flags.F.LastOperationStatus) {
-				/* Save current baudrate */
-				WizFi360->Baudrate = WizFi360_Baudrate[i];
-				
-				break;
-			}
-		}
+		/* Delay for while */
+		WizFi360_DELAYMS(WizFi360, 100);
+		
+		/* Set pin high */
+		WizFi360->Transport->Reset(WizFi360->Transport->Arg, 1);
+		
+		/* Delay for while */
+		WizFi360_DELAYMS(WizFi360, 100);
 	}
 	
+#if WizFi360_USE_BAUDRATE_PROBE
+	/* Find baudrate where module responds to AT command */
+	DetectBaudrateProbe(WizFi360);
+	
+	/* Reset device only when it does not respond on any baudrate */
+	if (!WizFi360->Flags.F.LastOperationStatus) {
+		DetectBaudrateReset(WizFi360);
+	}
+#else
+	/* Reset device and find baudrate where it responds */
+	DetectBaudrateReset(WizFi360);
+#endif
+	
 	/* Check status */
 	if (!WizFi360->Flags.F.LastOperationStatus) {		
 		/* Device is not connected */
@@ -258,6 +420,16 @@ WizFi360_Result_t WizFi360_Init(WizFi360_t* WizFi360, uint32_t baudrate) {
 	/* Wait till idle */
 	WizFi360_WaitReady(WizFi360);
 	
+	/* Enable RTS/CTS flow control on module and USART, baudrate stays the same. On error, USART stays without flow control */
+	if (WizFi360_FLOWCONTROL_AVAILABLE(WizFi360)) {
+		SendUARTCommand(WizFi360, WizFi360->Baudrate, "AT+UART_CUR");
+	}
+	
+#if WizFi360_USE_BAUDRATE_ESCALATION
+	/* Step up to highest baudrate where communication works without errors */
+	EscalateBaudrate(WizFi360);
+#endif
+	
 	/* Enable multiple connections */
 	while (WizFi360_SetMux(WizFi360, 1) != ESP_OK);
 	
@@ -273,13 +445,16 @@ WizFi360_Result_t WizFi360_Init(WizFi360_t* WizFi360, uint32_t baudrate) {
 	/* Get softAP MAC */
 	while (WizFi360_GetAPIP(WizFi360) != ESP_OK);
 	
-	/* Return OK */
-	return WizFi360_WaitReady(WizFi360);
+	/* Wait till idle */
+	WizFi360_WaitReady(WizFi360);
+	
+	/* Start buffer statistics after module startup */
+	return WizFi360_ResetBufferStats(WizFi360);
 }
 
 WizFi360_Result_t WizFi360_DeInit(WizFi360_t* WizFi360) {
 	/* Clear temporary buffer */
-	BUFFER_Free(&TMP_Buffer);
+	BUFFER_Free(&WizFi360->TMP_Buffer);
 	
 	/* Return OK from function */
 	WizFi360_RETURNWITHSTATUS(WizFi360, ESP_OK);
@@ -292,16 +467,21 @@ WizFi360_Result_t WizFi360_RestoreDefault(WizFi360_t* WizFi360) {
 	}
 	
 	/* Little delay */
-	WizFi360_DELAYMS(2);
+	WizFi360_DELAYMS(WizFi360, 2);
+	
+	/* Default settings have flow control disabled */
+	if (WizFi360->Transport->FlowControl) {
+		WizFi360->Transport->FlowControl(WizFi360->Transport->Arg, 0);
+	}
 	
 	/* Reset USART to default ESP baudrate */
-	WizFi360_LL_USARTInit(WizFi360_DEFAULT_BAUDRATE);
+	WizFi360->Transport->SetBaudrate(WizFi360->Transport->Arg, WizFi360_DEFAULT_BAUDRATE);
 	
 	/* Wait till ready, ESP will send data in default baudrate after reset */
 	WizFi360_WaitReady(WizFi360);
 	
 	/* Reset USART buffer */
-	BUFFER_Reset(&USART_Buffer);
+	ResetUSARTBuffer(WizFi360);
 	
 	/* Return OK */
 	WizFi360_RETURNWITHSTATUS(WizFi360, ESP_OK);
@@ -328,48 +508,56 @@ WizFi360_Result_t WizFi360_SetUARTDefault(WizFi360_t* WizFi360, uint32_t baudrat
 }
 
 WizFi360_Result_t WizFi360_SetSleepMode(WizFi360_t* WizFi360, WizFi360_SleepMode_t SleepMode) {
-	char tmp[20];
-	
 	/* Check idle mode */
 	WizFi360_CHECK_IDLE(WizFi360);
 	
-	/* Format command */
-	sprintf(tmp, "AT+SLEEP=%d\r\n", SleepMode);
-	
 	/* Send command */
-	SendCommand(WizFi360, WizFi360_COMMAND_SLEEP, tmp, "+SLEEP");
+	if (StartCommand(WizFi360, WizFi360_COMMAND_SLEEP, "+SLEEP") == ESP_OK) {
+		CommandAddString(WizFi360, "AT+SLEEP=");
+		CommandAddNumber(WizFi360, SleepMode);
+		CommandEnd(WizFi360);
+	}
 	
 	/* Wait ready */
 	return WizFi360_WaitReady(WizFi360);
 }
 
 WizFi360_Result_t WizFi360_Sleep(WizFi360_t* WizFi360, uint32_t Milliseconds) {
-	char tmp[20];
-	
 	/* Check idle mode */
 	WizFi360_CHECK_IDLE(WizFi360);
 	
-	/* Format command */
-	sprintf(tmp, "AT+GSLP=%u\r\n", Milliseconds);
-	
 	/* Send command */
-	SendCommand(WizFi360, WizFi360_COMMAND_GSLP, tmp, NULL);
+	if (StartCommand(WizFi360, WizFi360_COMMAND_GSLP, NULL) == ESP_OK) {
+		CommandAddString(WizFi360, "AT+GSLP=");
+		CommandAddNumber(WizFi360, Milliseconds);
+		CommandEnd(WizFi360);
+	}
 	
 	/* Wait ready */
 	return WizFi360_WaitReady(WizFi360);
 }
 
 WizFi360_Result_t WizFi360_Update(WizFi360_t* WizFi360) {
-	char Received[256];
-	char ch;
-	uint8_t lastcmd;
-	uint16_t stringlength;
+	BUFFER_Size_t count;
+	uint8_t* data;
+	uint8_t lastcmd, event[2];
+	
+	/* Get current time from transport, if it has clock */
+	if (WizFi360->Transport->Now) {
+		WizFi360->Time = WizFi360->Transport->Now(WizFi360->Transport->Arg);
+	}
 	
 	/* If timeout is set to 0 */
 	if (WizFi360->Timeout == 0) {
 		WizFi360->Timeout = 30000;
 	}
 	
+	/* Save maximal time between update calls */
+	if ((WizFi360->Time - WizFi360->Stats.LastUpdateTime) > WizFi360->Stats.MaxUpdateInterval) {
+		WizFi360->Stats.MaxUpdateInterval = WizFi360->Time - WizFi360->Stats.LastUpdateTime;
+	}
+	WizFi360->Stats.LastUpdateTime = WizFi360->Time;
+	
 	/* Check timeout */
 	if ((WizFi360->Time - WizFi360->StartTime) > WizFi360->Timeout) {
 		/* Save temporary active command */
@@ -378,6 +566,9 @@ WizFi360_Result_t WizFi360_Update(WizFi360_t* WizFi360) {
 		/* Timeout reached, reset command */
 		WizFi360->ActiveCommand = WizFi360_COMMAND_IDLE;
 		
+		/* Command without response has failed */
+		WizFi360->Flags.F.LastOperationStatus = 0;
+		
 		/* Timeout reached */
 		if (lastcmd == WizFi360_COMMAND_CIPSTART) {
 			/* We get timeout on cipstart */
@@ -388,72 +579,27 @@ WizFi360_Result_t WizFi360_Update(WizFi360_t* WizFi360) {
 		}
 	}
 	
-	/* We are waiting to send data */
-	if (WizFi360_COMMAND_SENDDATA) {
-		/* Check what we are searching for */
-		if (WizFi360->Flags.F.WaitForWrapper) {
-			int16_t found;
-			uint8_t dummy[2];
-			/* Wait for character */
-			if ((found = BUFFER_Find(&USART_Buffer, (uint8_t *)"> ", 2)) >= 0) {
-				if (found == 0) {
-					/* Make a dummy read */
-					BUFFER_Read(&USART_Buffer, dummy, 2);
-				}
-			} else if ((found = BUFFER_Find(&TMP_Buffer, (uint8_t *)"> ", 0)) >= 0) {
-				if (found == 0) {
-					/* Make 2 dummy reads */
-					BUFFER_Read(&TMP_Buffer, dummy, 2);
-				}
-			}
-			if (found >= 0) {
-				/* Send data */
-				ProcessSendData(WizFi360);
-			}
-		}
-	}
+	/* Check for tokens received since last call */
+	ProcessTokens(WizFi360);
 	
-	/* If AT+UART command was used, only check if "OK" exists in buffer */
-	if (
-		WizFi360->ActiveCommand == WizFi360_COMMAND_UART && /*!< Active command is UART change */
-		!WizFi360->IPD.InIPD                               /*!< We are not in IPD mode */
-	) {
-		/* Check for "OK\r" */
-		if (BUFFER_Find(&USART_Buffer, (uint8_t *)"OK\r", 3) >= 0) {
-			/* Clear buffer */
-			BUFFER_Reset(&USART_Buffer);
-			
-			/* We are OK here */
-			WizFi360->ActiveCommand = WizFi360_COMMAND_IDLE;
-			
-			/* Last command is OK */
-			WizFi360->Flags.F.LastOperationStatus = 1;
-			
-			/* Return from function */
-			//return ESP_OK;
-		}
+	/* We are waiting to send data and wrapper has been received */
+	if (WizFi360->Flags.F.WaitForWrapper && WizFi360->Flags.F.WrapperReceived) {
+		/* Send data */
+		ProcessSendData(WizFi360);
 	}
 	
-	/* Get string from USART buffer if we are not in IPD mode */
-	while (
-		!WizFi360->IPD.InIPD &&                                                             /*!< Not in IPD mode */
-		//!WizFi360->Flags.F.WaitForWrapper &&
-		(stringlength = BUFFER_ReadString(&USART_Buffer, Received, sizeof(Received))) > 0 /*!< Something in USART buffer */
-	) {		
-		/* Parse received string */
-		printf("Received : %s \r\n", Received);
-		ParseReceived(WizFi360, Received, 1, stringlength);
-	}
+	/* Parse data from USART buffer if we are not in IPD mode */
+	ParseStream(WizFi360);
 	
-	/* Get string from TMP buffer when no command active */
+	/* Get saved line type and link ID from TMP buffer when no command active */
 	while (
 		!WizFi360->IPD.InIPD &&                                                             /*!< Not in IPD mode */
 		//!WizFi360->Flags.F.WaitForWrapper &&
 		WizFi360->ActiveCommand == WizFi360_COMMAND_IDLE &&                                  /*!< We are in IDLE mode */
-		(stringlength = BUFFER_ReadString(&TMP_Buffer, Received, sizeof(Received))) > 0 /*!< Something in TMP buffer */
+		BUFFER_Read(&WizFi360->TMP_Buffer, event, 2) == 2                                   /*!< Something in TMP buffer */
 	) {
-		/* Parse received string */
-		ParseReceived(WizFi360, Received, 0, stringlength);
+		/* Parse saved line */
+		ParseReceived(WizFi360, event[0], event[1], "", 0);
 	}
 	
 	/* If we are in IPD mode */
@@ -461,33 +607,51 @@ WizFi360_Result_t WizFi360_Update(WizFi360_t* WizFi360) {
 		BUFFER_t* buff;
 		/* Check for USART buffer */
 		if (WizFi360->IPD.USART_Buffer) {
-			buff = &USART_Buffer;
+			buff = WizFi360->USART_Buffer;
 		} else {
-			buff = &TMP_Buffer;
+			buff = &WizFi360->TMP_Buffer;
 		}
 		
-		/* If anything received */
-		while (
-			WizFi360->IPD.InPtr < WizFi360->Connection[WizFi360->IPD.ConnNumber].BytesReceived && /*!< Still not everything received */
-			BUFFER_GetFull(buff) > 0                                                    /*!< Data are available in buffer */
-		) {
-			/* Read from buffer */
-			BUFFER_Read(buff, (uint8_t *)&ch, 1);
+		/* Copy linear blocks from buffer until all announced data are received */
+		while (WizFi360->IPD.PtrTotal < WizFi360->Connection[WizFi360->IPD.ConnNumber].BytesReceived) {
+			/* Get data available in buffer */
+			count = BUFFER_PeekRead(buff, &data);
+			if (count == 0) {
+				break;
+			}
+			
+			/* Limit to remaining data of packet and to free memory in connection buffer */
+			if (count > (WizFi360->Connection[WizFi360->IPD.ConnNumber].BytesReceived - WizFi360->IPD.PtrTotal)) {
+				count = WizFi360->Connection[WizFi360->IPD.ConnNumber].BytesReceived - WizFi360->IPD.PtrTotal;
+			}
+			if (count > (WizFi360_CONNECTION_BUFFER_SIZE - WizFi360->IPD.InPtr)) {
+				count = WizFi360_CONNECTION_BUFFER_SIZE - WizFi360->IPD.InPtr;
+			}
 			
-			/* Add from USART buffer */
-			WizFi360->Connection[WizFi360->IPD.ConnNumber].Data[WizFi360->IPD.InPtr] = ch;
+			/* Copy to connection buffer and remove from buffer */
+			memcpy(&WizFi360->Connection[WizFi360->IPD.ConnNumber].Data[WizFi360->IPD.InPtr], data, count);
+			BUFFER_CommitRead(buff, count);
 			
 			/* Increase pointers */
-			WizFi360->IPD.InPtr++;
-			WizFi360->IPD.PtrTotal++;
+			WizFi360->IPD.InPtr += count;
+			WizFi360->IPD.PtrTotal += count;
+			
+			/* Update high watermark */
+			if (WizFi360->IPD.InPtr > WizFi360->Stats.Connection.Peak) {
+				WizFi360->Stats.Connection.Peak = WizFi360->IPD.InPtr;
+			}
 			
 #if WizFi360_CONNECTION_BUFFER_SIZE < ESP8255_MAX_BUFF_SIZE
 			/* Check for pointer */
-			if (WizFi360->IPD.InPtr >= WizFi360_CONNECTION_BUFFER_SIZE && WizFi360->IPD.InPtr != WizFi360->Connection[WizFi360->IPD.ConnNumber].BytesReceived) {
+			if (WizFi360->IPD.InPtr >= WizFi360_CONNECTION_BUFFER_SIZE && WizFi360->IPD.PtrTotal != WizFi360->Connection[WizFi360->IPD.ConnNumber].BytesReceived) {
+				/* Data in connection buffer are overwritten by next part */
+				WizFi360->Stats.Connection.Dropped += WizFi360->IPD.InPtr;
+				WizFi360->Stats.Connection.FullCount++;
+				
 				/* Set connection buffer size */
 				WizFi360->Connection[WizFi360->IPD.ConnNumber].DataSize = WizFi360->IPD.InPtr;
 				WizFi360->Connection[WizFi360->IPD.ConnNumber].LastPart = 0;
-				printf(" receive data : %s\r\n", WizFi360->Connection[WizFi360->IPD.ConnNumber].Data);
+				
 				/* Buffer is full, call user function */
 //				if (WizFi360->Connection[WizFi360->IPD.ConnNumber].Client) {
 //					WizFi360_Callback_ClientConnectionDataReceived(WizFi360, &WizFi360->Connection[WizFi360->IPD.ConnNumber], WizFi360->Connection[WizFi360->IPD.ConnNumber].Data);
@@ -495,7 +659,6 @@ WizFi360_Result_t WizFi360_Update(WizFi360_t* WizFi360) {
 //					WizFi360_Callback_ServerConnectionDataReceived(WizFi360, &WizFi360->Connection[WizFi360->IPD.ConnNumber], WizFi360->Connection[WizFi360->IPD.ConnNumber].Data);
 //				}
 				
-				
 				/* Reset input pointer */
 				WizFi360->IPD.InPtr = 0;
 			}
@@ -513,10 +676,15 @@ WizFi360_Result_t WizFi360_Update(WizFi360_t* WizFi360) {
 			WizFi360->Connection[WizFi360->IPD.ConnNumber].DataSize = WizFi360->IPD.InPtr;
 			WizFi360->Connection[WizFi360->IPD.ConnNumber].LastPart = 1;
 			
+			/* Add zero at the end of string if there is memory */
+			if (WizFi360->IPD.InPtr < WizFi360_CONNECTION_BUFFER_SIZE) {
+				WizFi360->Connection[WizFi360->IPD.ConnNumber].Data[WizFi360->IPD.InPtr] = 0;
+			}
+			
 			/* We have data, lets see if Content-Length exists and save it */
 			if (
 				WizFi360->Connection[WizFi360->IPD.ConnNumber].FirstPacket &&
-				(ptr = strstr(WizFi360->Connection[WizFi360->IPD.ConnNumber].Data, "Content-Length: ")) != NULL
+				(ptr = (char *)mem_mem(WizFi360->Connection[WizFi360->IPD.ConnNumber].Data, WizFi360->IPD.InPtr, "Content-Length: ", 16)) != NULL
 			) {
 				/* Increase pointer and parse number */
 				ptr += 16;
@@ -533,6 +701,9 @@ WizFi360_Result_t WizFi360_Update(WizFi360_t* WizFi360) {
 	/* Call user functions on connections if needed */
 	CallConnectionCallbacks(WizFi360);
 	
+	/* Allow module to send again if buffer was emptied */
+	FlowControlUpdate(WizFi360);
+	
 	/* Return OK */
 	WizFi360_RETURNWITHSTATUS(WizFi360, ESP_OK);
 }
@@ -547,8 +718,11 @@ WizFi360_Result_t WizFi360_WaitReady(WizFi360_t* WizFi360) {
 	do {
 		/* Check for wrapper */
 		if (WizFi360->Flags.F.WaitForWrapper) {
+			/* Check for tokens */
+			ProcessTokens(WizFi360);
+			
 			/* We have found it, stop execution here */
-			if (BUFFER_Find(&USART_Buffer, (uint8_t *)"> ", 2) >= 0) {
+			if (WizFi360->Flags.F.WrapperReceived) {
 				WizFi360->Flags.F.WaitForWrapper = 0;
 				break;
 			}
@@ -570,16 +744,16 @@ WizFi360_Result_t WizFi360_IsReady(WizFi360_t* WizFi360) {
 }
 
 WizFi360_Result_t WizFi360_SetMode(WizFi360_t* WizFi360, WizFi360_Mode_t Mode) {
-	char command[30];
-	
-	/* Format command */
-	sprintf(command, "AT+CWMODE_CUR=%d\r\n", (uint8_t)Mode);
-	
-	/* Send command */
-	if (SendCommand(WizFi360, WizFi360_COMMAND_CWMODE, command, "AT+CWMODE") != ESP_OK) {
+	/* Start command */
+	if (StartCommand(WizFi360, WizFi360_COMMAND_CWMODE, "AT+CWMODE") != ESP_OK) {
 		return WizFi360->Result;
 	}
 	
+	/* Send command */
+	CommandAddString(WizFi360, "AT+CWMODE_CUR=");
+	CommandAddNumber(WizFi360, (uint8_t)Mode);
+	CommandEnd(WizFi360);
+	
 	/* Save mode we sent */
 	WizFi360->SentMode = Mode;
 
@@ -597,22 +771,24 @@ WizFi360_Result_t WizFi360_SetMode(WizFi360_t* WizFi360, WizFi360_Mode_t Mode) {
 }
 
 WizFi360_Result_t WizFi360_RequestSendData(WizFi360_t* WizFi360, WizFi360_Connection_t* Connection) {
-	char command[30];
-	
 	/* Check idle state */
 	WizFi360_CHECK_IDLE(WizFi360);
 	
-	/* Format command */
-	sprintf(command, "AT+CIPSENDEX=%d,2048\r\n", Connection->Number);
-
-	/* Send command */
-	if (SendCommand(WizFi360, WizFi360_COMMAND_SEND, command, "AT+CIPSENDEX") != ESP_OK) {
+	/* Start command */
+	if (StartCommand(WizFi360, WizFi360_COMMAND_SEND, "AT+CIPSENDEX") != ESP_OK) {
 		return WizFi360->Result;
 	}
 	
+	/* Send command */
+	CommandAddString(WizFi360, "AT+CIPSENDEX=");
+	CommandAddNumber(WizFi360, Connection->Number);
+	CommandAddString(WizFi360, ",2048");
+	CommandEnd(WizFi360);
+	
 	/* We are waiting for "> " response */
 	Connection->WaitForWrapper = 1;
 	WizFi360->Flags.F.WaitForWrapper = 1;
+	WizFi360->Flags.F.WrapperReceived = 0;
 	
 	/* Save connection pointer */
 	WizFi360->SendDataConnection = Connection;
@@ -623,13 +799,18 @@ WizFi360_Result_t WizFi360_RequestSendData(WizFi360_t* WizFi360, WizFi360_Connec
 
 
 WizFi360_Result_t WizFi360_CloseConnection(WizFi360_t* WizFi360, WizFi360_Connection_t* Connection) {
-	char tmp[30];
-	
-	/* Format connection */
-	sprintf(tmp, "AT+CIPCLOSE=%d\r\n", Connection->Number);
+	/* Start command */
+	if (StartCommand(WizFi360, WizFi360_COMMAND_CLOSE, "AT+CIPCLOSE") != ESP_OK) {
+		return WizFi360->Result;
+	}
 	
 	/* Send command */
-	return SendCommand(WizFi360, WizFi360_COMMAND_CLOSE, tmp, "AT+CIPCLOSE");
+	CommandAddString(WizFi360, "AT+CIPCLOSE=");
+	CommandAddNumber(WizFi360, Connection->Number);
+	CommandEnd(WizFi360);
+	
+	/* Return OK */
+	return WizFi360->Result;
 }
 
 WizFi360_Result_t WizFi360_CloseAllConnections(WizFi360_t* WizFi360) {
@@ -653,16 +834,16 @@ WizFi360_Result_t WizFi360_AllConectionsClosed(WizFi360_t* WizFi360) {
 }
 
 WizFi360_Result_t WizFi360_SetMux(WizFi360_t* WizFi360, uint8_t mux) {
-	char tmp[30];
-	
-	/* Format command */
-	sprintf(tmp, "AT+CIPMUX=%d\r\n", mux);
-	
-	/* Send command */
-	if (SendCommand(WizFi360, WizFi360_COMMAND_CIPMUX, tmp, "AT+CIPMUX") != ESP_OK) {
+	/* Start command */
+	if (StartCommand(WizFi360, WizFi360_COMMAND_CIPMUX, "AT+CIPMUX") != ESP_OK) {
 		return WizFi360->Result;
 	}
 	
+	/* Send command */
+	CommandAddString(WizFi360, "AT+CIPMUX=");
+	CommandAddNumber(WizFi360, mux);
+	CommandEnd(WizFi360);
+	
 	/* Wait till command end */
 	WizFi360_WaitReady(WizFi360);
 	
@@ -677,15 +858,15 @@ WizFi360_Result_t WizFi360_SetMux(WizFi360_t* WizFi360, uint8_t mux) {
 }
 
 WizFi360_Result_t WizFi360_Setdinfo(WizFi360_t* WizFi360, uint8_t info) {
-	char tmp[30];
-	
-	/* Format string */
-	sprintf(tmp, "AT+CIPDINFO=%d\r\n", info);
-
-	/* Send command and wait */
-	if (SendCommand(WizFi360, WizFi360_COMMAND_CIPDINFO, tmp, "AT+CIPDINFO") != ESP_OK) {
+	/* Start command */
+	if (StartCommand(WizFi360, WizFi360_COMMAND_CIPDINFO, "AT+CIPDINFO") != ESP_OK) {
 		return WizFi360->Result;
 	}
+	
+	/* Send command */
+	CommandAddString(WizFi360, "AT+CIPDINFO=");
+	CommandAddNumber(WizFi360, info);
+	CommandEnd(WizFi360);
 
 	/* Wait till command end */
 	WizFi360_WaitReady(WizFi360);
@@ -701,15 +882,15 @@ WizFi360_Result_t WizFi360_Setdinfo(WizFi360_t* WizFi360, uint8_t info) {
 }
 
 WizFi360_Result_t WizFi360_ServerEnable(WizFi360_t* WizFi360, uint16_t port) {
-	char tmp[30];
-	
-	/* Format string */
-	sprintf(tmp, "AT+CIPSERVER=1,%d\r\n", port);
-
-	/* Send command and wait */
-	if (SendCommand(WizFi360, WizFi360_COMMAND_CIPSERVER, tmp, "AT+CIPSERVER") != ESP_OK) {
+	/* Start command */
+	if (StartCommand(WizFi360, WizFi360_COMMAND_CIPSERVER, "AT+CIPSERVER") != ESP_OK) {
 		return WizFi360->Result;
 	}
+	
+	/* Send command */
+	CommandAddString(WizFi360, "AT+CIPSERVER=1,");
+	CommandAddNumber(WizFi360, port);
+	CommandEnd(WizFi360);
 
 	/* Wait till command end */
 	WizFi360_WaitReady(WizFi360);
@@ -744,15 +925,15 @@ WizFi360_Result_t WizFi360_ServerDisable(WizFi360_t* WizFi360) {
 }
 
 WizFi360_Result_t WizFi360_SetServerTimeout(WizFi360_t* WizFi360, uint16_t timeout) {
-	char tmp[20];
-	
-	/* Format string */
-	sprintf(tmp, "AT+CIPSTO=%d\r\n", timeout);
-
-	/* Send command and wait */
-	if (SendCommand(WizFi360, WizFi360_COMMAND_CIPSTO, tmp, NULL) != ESP_OK) {
+	/* Start command */
+	if (StartCommand(WizFi360, WizFi360_COMMAND_CIPSTO, NULL) != ESP_OK) {
 		return WizFi360->Result;
 	}
+	
+	/* Send command */
+	CommandAddString(WizFi360, "AT+CIPSTO=");
+	CommandAddNumber(WizFi360, timeout);
+	CommandEnd(WizFi360);
 
 	/* Wait till command end */
 	WizFi360_WaitReady(WizFi360);
@@ -773,33 +954,39 @@ WizFi360_Result_t WizFi360_WifiDisconnect(WizFi360_t* WizFi360) {
 }
 
 WizFi360_Result_t WizFi360_WifiConnect(WizFi360_t* WizFi360, char* ssid, char* pass) {
-	char tmp[100];
-	char s[50], p[50];
-	
-	/* Escape special characters for WizFi360 */
-	strcpy(s, EscapeString(ssid));
-	strcpy(p, EscapeString(pass));
+	/* Start command */
+	if (StartCommand(WizFi360, WizFi360_COMMAND_CWJAP, "+CWJAP:") != ESP_OK) {
+		return WizFi360->Result;
+	}
 	
-	/* Format command */
-	sprintf(tmp, "AT+CWJAP_CUR=\"%s\",\"%s\"\r\n", s, p);
+	/* Send command, escape special characters for WizFi360 */
+	CommandAddString(WizFi360, "AT+CWJAP_CUR=\"");
+	CommandAddEscaped(WizFi360, ssid);
+	CommandAddString(WizFi360, "\",\"");
+	CommandAddEscaped(WizFi360, pass);
+	CommandAddString(WizFi360, "\"");
+	CommandEnd(WizFi360);
 	
-	/* Send command */
-	return SendCommand(WizFi360, WizFi360_COMMAND_CWJAP, tmp, "+CWJAP:");
+	/* Return OK */
+	return WizFi360->Result;
 }
 
 WizFi360_Result_t WizFi360_WifiConnectDefault(WizFi360_t* WizFi360, char* ssid, char* pass) {
-	char tmp[100];
-	char s[50], p[50];
-	
-	/* Escape special characters for WizFi360 */
-	strcpy(s, EscapeString(ssid));
-	strcpy(p, EscapeString(pass));
+	/* Start command */
+	if (StartCommand(WizFi360, WizFi360_COMMAND_CWJAP, "+CWJAP:") != ESP_OK) {
+		return WizFi360->Result;
+	}
 	
-	/* Format command */
-	sprintf(tmp, "AT+CWJAP_DEF=\"%s\",\"%s\"\r\n", s, p);
+	/* Send command, escape special characters for WizFi360 */
+	CommandAddString(WizFi360, "AT+CWJAP_DEF=\"");
+	CommandAddEscaped(WizFi360, ssid);
+	CommandAddString(WizFi360, "\",\"");
+	CommandAddEscaped(WizFi360, pass);
+	CommandAddString(WizFi360, "\"");
+	CommandEnd(WizFi360);
 	
-	/* Send command */
-	return SendCommand(WizFi360, WizFi360_COMMAND_CWJAP, tmp, "+CWJAP:");
+	/* Return OK */
+	return WizFi360->Result;
 }
 
 WizFi360_Result_t WizFi360_WifiGetConnected(WizFi360_t* WizFi360) {	
@@ -919,7 +1106,7 @@ WizFi360_Result_t WizFi360_SetAPMACDefault(WizFi360_t* WizFi360, uint8_t* addr)
 #if WizFi360_USE_APSEARCH
 WizFi360_Result_t WizFi360_ListWifiStations(WizFi360_t* WizFi360) {
 	/* Reset pointer */
-	WizFi360_APs.Count = 0;
+	WizFi360->APs.Count = 0;
 	
 	/* Send list command */
 	return SendCommand(WizFi360, WizFi360_COMMAND_CWLAP, "AT+CWLAP\r\n", "+CWLAP");	
@@ -937,9 +1124,6 @@ WizFi360_Result_t WizFi360_GetAP(WizFi360_t* WizFi360) {
 }
 
 WizFi360_Result_t WizFi360_SetAP(WizFi360_t* WizFi360, WizFi360_APConfig_t* WizFi360_Config) {
-	char tmp[120];
-	char pass[65], ssid[65];
-	
 	/* Check input values */
 	if (
 		strlen(WizFi360_Config->SSID) > 64 ||
@@ -952,30 +1136,31 @@ WizFi360_Result_t WizFi360_SetAP(WizFi360_t* WizFi360, WizFi360_APConfig_t* WizF
 		WizFi360_RETURNWITHSTATUS(WizFi360, ESP_ERROR);
 	}
 	
-	/* Escape characters */
-	strcpy(ssid, EscapeString(WizFi360_Config->SSID));
-	strcpy(pass, EscapeString(WizFi360_Config->Pass));
-	
-	/* Format command */
-	sprintf(tmp, "AT+CWSAP_CUR=\"%s\",\"%s\",%d,%d,%d,%d\r\n",
-		ssid, pass,
-		WizFi360_Config->Channel,
-		(uint8_t)WizFi360_Config->Ecn,
-		WizFi360_Config->MaxConnections,
-		WizFi360_Config->Hidden
-	);
+	/* Start command */
+	if (StartCommand(WizFi360, WizFi360_COMMAND_CWSAP, "AT+CWSAP") != ESP_OK) {
+		return WizFi360->Result;
+	}
 	
-	/* Send command */
-	SendCommand(WizFi360, WizFi360_COMMAND_CWSAP, tmp, "AT+CWSAP");
+	/* Send command, escape special characters for WizFi360 */
+	CommandAddString(WizFi360, "AT+CWSAP_CUR=\"");
+	CommandAddEscaped(WizFi360, WizFi360_Config->SSID);
+	CommandAddString(WizFi360, "\",\"");
+	CommandAddEscaped(WizFi360, WizFi360_Config->Pass);
+	CommandAddString(WizFi360, "\",");
+	CommandAddNumber(WizFi360, WizFi360_Config->Channel);
+	CommandAddString(WizFi360, ",");
+	CommandAddNumber(WizFi360, (uint8_t)WizFi360_Config->Ecn);
+	CommandAddString(WizFi360, ",");
+	CommandAddNumber(WizFi360, WizFi360_Config->MaxConnections);
+	CommandAddString(WizFi360, ",");
+	CommandAddNumber(WizFi360, WizFi360_Config->Hidden);
+	CommandEnd(WizFi360);
 	
 	/* Return status */
 	return WizFi360_Update(WizFi360);
 }
 
 WizFi360_Result_t WizFi360_SetAPDefault(WizFi360_t* WizFi360, WizFi360_APConfig_t* WizFi360_Config) {
-	char tmp[120];
-	char pass[65], ssid[65];
-	
 	/* Check input values */
 	if (
 		strlen(WizFi360_Config->SSID) > 64 ||
@@ -988,21 +1173,25 @@ WizFi360_Result_t WizFi360_SetAPDefault(WizFi360_t* WizFi360, WizFi360_APConfig_
 		WizFi360_RETURNWITHSTATUS(WizFi360, ESP_ERROR);
 	}
 	
-	/* Escape characters */
-	strcpy(ssid, EscapeString(WizFi360_Config->SSID));
-	strcpy(pass, EscapeString(WizFi360_Config->Pass));
-	
-	/* Format command */
-	sprintf(tmp, "AT+CWSAP_DEF=\"%s\",\"%s\",%d,%d,%d,%d\r\n",
-		ssid, pass,
-		WizFi360_Config->Channel,
-		(uint8_t)WizFi360_Config->Ecn,
-		WizFi360_Config->MaxConnections,
-		WizFi360_Config->Hidden
-	);
+	/* Start command */
+	if (StartCommand(WizFi360, WizFi360_COMMAND_CWSAP, "AT+CWSAP") != ESP_OK) {
+		return WizFi360->Result;
+	}
 	
-	/* Send command */
-	SendCommand(WizFi360, WizFi360_COMMAND_CWSAP, tmp, "AT+CWSAP");
+	/* Send command, escape special characters for WizFi360 */
+	CommandAddString(WizFi360, "AT+CWSAP_DEF=\"");
+	CommandAddEscaped(WizFi360, WizFi360_Config->SSID);
+	CommandAddString(WizFi360, "\",\"");
+	CommandAddEscaped(WizFi360, WizFi360_Config->Pass);
+	CommandAddString(WizFi360, "\",");
+	CommandAddNumber(WizFi360, WizFi360_Config->Channel);
+	CommandAddString(WizFi360, ",");
+	CommandAddNumber(WizFi360, (uint8_t)WizFi360_Config->Ecn);
+	CommandAddString(WizFi360, ",");
+	CommandAddNumber(WizFi360, WizFi360_Config->MaxConnections);
+	CommandAddString(WizFi360, ",");
+	CommandAddNumber(WizFi360, WizFi360_Config->Hidden);
+	CommandEnd(WizFi360);
 	
 	/* Wait till command end */
 	return WizFi360_WaitReady(WizFi360);
@@ -1051,22 +1240,27 @@ WizFi360_Result_t WizFi360_StartClientConnection(WizFi360_t* WizFi360, char* nam
 	
 	/* Try it */
 	if (conn != -1) {
-		char tmp[100];
-		/* Format command */
-		sprintf(tmp, "AT+CIPSTART=%d,\"TCP\",\"%s\",%d\r\n", conn, location, port);
-		
-		/* Send command */
-		if (SendCommand(WizFi360, WizFi360_COMMAND_CIPSTART, tmp, NULL) != ESP_OK) {
+		/* Start command */
+		if (StartCommand(WizFi360, WizFi360_COMMAND_CIPSTART, NULL) != ESP_OK) {
 			return WizFi360->Result;
 		}
 		
+		/* Send command */
+		CommandAddString(WizFi360, "AT+CIPSTART=");
+		CommandAddNumber(WizFi360, conn);
+		CommandAddString(WizFi360, ",\"TCP\",\"");
+		CommandAdd(WizFi360, location, strlen(location), 0);
+		CommandAddString(WizFi360, "\",");
+		CommandAddNumber(WizFi360, port);
+		CommandEnd(WizFi360);
+		
 		/* We are active now as client */
 		WizFi360->Connection[i].Active = 1;
 		WizFi360->Connection[i].Client = 1;
 		WizFi360->Connection[i].TotalBytesReceived = 0;
 		WizFi360->Connection[i].Number = conn;
 #if WizFi360_USE_SINGLE_CONNECTION_BUFFER == 1
-		WizFi360->Connection[i].Data = ConnectionData;
+		WizFi360->Connection[i].Data = WizFi360->ConnectionData;
 #endif
 		WizFi360->StartConnectionSent = i;
 		
@@ -1108,22 +1302,27 @@ WizFi360_Result_t WizFi360_StartUDPConnection(WizFi360_t* WizFi360, char* name,
 	
 	/* Try it */
 	if (conn != -1) {
-		char tmp[100];
-		/* Format command */
-		sprintf(tmp, "AT+CIPSTART=%d,\"UDP\",\"%s\",%d\r\n", conn, location, port);
-		
-		/* Send command */
-		if (SendCommand(WizFi360, WizFi360_COMMAND_CIPSTART, tmp, NULL) != ESP_OK) {
+		/* Start command */
+		if (StartCommand(WizFi360, WizFi360_COMMAND_CIPSTART, NULL) != ESP_OK) {
 			return WizFi360->Result;
 		}
 		
+		/* Send command */
+		CommandAddString(WizFi360, "AT+CIPSTART=");
+		CommandAddNumber(WizFi360, conn);
+		CommandAddString(WizFi360, ",\"UDP\",\"");
+		CommandAdd(WizFi360, location, strlen(location), 0);
+		CommandAddString(WizFi360, "\",");
+		CommandAddNumber(WizFi360, port);
+		CommandEnd(WizFi360);
+		
 		/* We are active now as client */
 		WizFi360->Connection[i].Active = 1;
 		WizFi360->Connection[i].Client = 1;
 		WizFi360->Connection[i].TotalBytesReceived = 0;
 		WizFi360->Connection[i].Number = conn;
 #if WizFi360_USE_SINGLE_CONNECTION_BUFFER == 1
-		WizFi360->Connection[i].Data = ConnectionData;
+		WizFi360->Connection[i].Data = WizFi360->ConnectionData;
 #endif
 		WizFi360->StartConnectionSent = i;
 		
@@ -1145,8 +1344,6 @@ WizFi360_Result_t WizFi360_StartUDPConnection(WizFi360_t* WizFi360, char* name,
 /******************************************/
 #if WizFi360_USE_PING
 WizFi360_Result_t WizFi360_Ping(WizFi360_t* WizFi360, char* addr) {
-	char tmp[100];
-	
 	/* Check idle */
 	WizFi360_CHECK_IDLE(WizFi360);
 	
@@ -1156,14 +1353,17 @@ WizFi360_Result_t WizFi360_Ping(WizFi360_t* WizFi360, char* addr) {
 	/* Save ping address information */
 	strcpy(WizFi360->PING.Address, addr);
 	
-	/* Format command for pinging */
-	sprintf(tmp, "AT+PING=\"%s\"\r\n", addr);
-	
 	/* Reset flag */
 	WizFi360->PING.Success = 0;
 	
 	/* Send command */
-	if (SendCommand(WizFi360, WizFi360_COMMAND_PING, tmp, "+") == ESP_OK) {
+	if (StartCommand(WizFi360, WizFi360_COMMAND_PING, "+") == ESP_OK) {
+		/* Format command for pinging */
+		CommandAddString(WizFi360, "AT+PING=\"");
+		CommandAdd(WizFi360, addr, strlen(addr), 0);
+		CommandAddString(WizFi360, "\"");
+		CommandEnd(WizFi360);
+		
 		/* Call user function */
 		WizFi360_Callback_PingStarted(WizFi360, addr);
 	}
@@ -1173,9 +1373,81 @@ WizFi360_Result_t WizFi360_Ping(WizFi360_t* WizFi360, char* addr) {
 }
 #endif
 
-uint16_t WizFi360_DataReceived(uint8_t* ch, uint16_t count) {
+WizFi360_Result_t WizFi360_GetBufferStats(WizFi360_t* WizFi360, WizFi360_Stats_t* Stats) {
+	/* Get statistics from buffers */
+	GetBufferStats(WizFi360->USART_Buffer, &WizFi360->Stats.USART);
+	GetBufferStats(&WizFi360->TMP_Buffer, &WizFi360->Stats.TMP);
+	WizFi360->Stats.Connection.Size = WizFi360_CONNECTION_BUFFER_SIZE;
+	
+	/* Copy statistics */
+	memcpy(Stats, &WizFi360->Stats, sizeof(WizFi360_Stats_t));
+	
+	/* Return OK */
+	WizFi360_RETURNWITHSTATUS(WizFi360, ESP_OK);
+}
+
+WizFi360_Result_t WizFi360_ResetBufferStats(WizFi360_t* WizFi360) {
+	/* Reset buffer statistics */
+	BUFFER_ResetStats(WizFi360->USART_Buffer);
+	BUFFER_ResetStats(&WizFi360->TMP_Buffer);
+	
+	/* Reset stack statistics */
+	memset(&WizFi360->Stats, 0, sizeof(WizFi360_Stats_t));
+	WizFi360->Stats.LastUpdateTime = WizFi360->Time;
+	
+	/* Return OK */
+	WizFi360_RETURNWITHSTATUS(WizFi360, ESP_OK);
+}
+
+WizFi360_Result_t WizFi360_GetBufferSizeAdvice(WizFi360_t* WizFi360, uint32_t* USARTBufferSize, uint32_t* TMPBufferSize) {
+	WizFi360_Stats_t Stats;
+	uint32_t required, bps;
+	
+	/* Get current statistics */
+	WizFi360_GetBufferStats(WizFi360, &Stats);
+	
+	/* Bytes received at current baudrate during longest update interval, 10 bits per byte */
+	bps = WizFi360->Baudrate / 10;
+	if (bps && Stats.MaxUpdateInterval / 1000 > BUFFER_MAX_SIZE / bps) {
+		/* Interval is so long that no buffer can hold data, product would overflow */
+		required = BUFFER_MAX_SIZE;
+	} else {
+		/* Whole seconds and rest of interval separately, so product fits in 32 bits */
+		required = bps * (Stats.MaxUpdateInterval / 1000) + bps * (Stats.MaxUpdateInterval % 1000) / 1000;
+	}
+	
+	/* Calculate sizes */
+	*USARTBufferSize = AdviseBufferSize(required, &Stats.USART, 256);
+	*TMPBufferSize = AdviseBufferSize(0, &Stats.TMP, 128);
+	
+	/* Return OK */
+	WizFi360_RETURNWITHSTATUS(WizFi360, ESP_OK);
+}
+
+uint16_t WizFi360_DataReceived(WizFi360_t* WizFi360, uint8_t* ch, uint16_t count) {
 	/* Writes data to USART buffer */
-	return BUFFER_Write(&USART_Buffer, ch, count);
+	count = BUFFER_Write(WizFi360->USART_Buffer, ch, count);
+	
+	/* Stop module if buffer is filled above high watermark */
+	FlowControlUpdate(WizFi360);
+	
+	/* Return number of written bytes */
+	return count;
+}
+
+void WizFi360_DataReceivedIdle(WizFi360_t* WizFi360) {
+	/* Complete burst is in USART buffer, notify user */
+	WizFi360_Callback_DataReceivedIdle(WizFi360);
+}
+
+void WizFi360_DataSent(WizFi360_t* WizFi360, uint8_t error) {
+	/* Count failed transmission */
+	if (error) {
+		WizFi360->Stats.TransmitErrors++;
+	}
+	
+	/* Background transmission is done, notify user */
+	WizFi360_Callback_DataSent(WizFi360, error);
 }
 
 /******************************************/
@@ -1394,12 +1666,26 @@ __weak void WizFi360_Callback_ConnectedStationsDetected(WizFi360_t* WizFi360, Wi
 	*/
 }
 
-/******************************************/
-/*           PRIVATE FUNCTIONS            */
-/******************************************/
-static void ParseCWSAP(WizFi360_t* WizFi360, char* Buffer) {
-	char* ptr;
-	uint8_t i, cnt;
+/* Called from interrupt when burst of data was received */
+__weak void WizFi360_Callback_DataReceivedIdle(WizFi360_t* WizFi360) {
+	/* NOTE: This function Should not be modified, when the callback is needed,
+           the WizFi360_Callback_DataReceivedIdle could be implemented in the user file
+	*/
+}
+
+/* Called from interrupt when queued data were sent */
+__weak void WizFi360_Callback_DataSent(WizFi360_t* WizFi360, uint8_t error) {
+	/* NOTE: This function Should not be modified, when the callback is needed,
+           the WizFi360_Callback_DataSent could be implemented in the user file
+	*/
+}
+
+/******************************************/
+/*           PRIVATE FUNCTIONS            */
+/******************************************/
+static void ParseCWSAP(WizFi360_t* WizFi360, char* Buffer) {
+	char* ptr;
+	uint8_t i, cnt;
 	
 	/* Find : in string */
 	ptr = Buffer;
@@ -1471,67 +1757,78 @@ static void ParseCWSAP(WizFi360_t* WizFi360, char* Buffer) {
 
 #if WizFi360_USE_APSEARCH
 static void ParseCWLAP(WizFi360_t* WizFi360, char* Buffer) {
-	uint8_t pos = 7, num = 0;
-	char* ptr;
+	WizFi360_AP_t* AP;
+	uint8_t num = 0, i, cnt;
+	char* ptr = &Buffer[7];
 	
 	/* Check if we have memory available first */
-	if (WizFi360_APs.Count >= WizFi360_MAX_CONNECTIONS) {
+	if (WizFi360->APs.Count >= WizFi360_MAX_DETECTED_AP) {
 		return;
 	}
+	AP = &WizFi360->APs.AP[WizFi360->APs.Count];
 	
 	/* Get start pointer */
-	if (Buffer[pos] == '(') {
-		pos++;
+	if (*ptr == '(') {
+		ptr++;
 	}
 	
-	/* Get token */
-	ptr = strtok(&Buffer[pos], ",");
-	
-	/* Do it until token != NULL */
-	while (ptr != NULL) {
-		/* Send debug */
-		
+	/* Parse fields in one pass, input string is not modified */
+	while (ptr != NULL && num < 7) {
 		/* Get positions */
 		switch (num++) {
 			case 0: 
-				WizFi360_APs.AP[WizFi360_APs.Count].Ecn = ParseNumber(ptr, NULL);
+				AP->Ecn = ParseNumber(ptr, &cnt);
+				ptr += cnt;
 				break;
 			case 1:
-				/* Ignore first and last " */
-				ptr++;
-				ptr[strlen(ptr) - 1] = 0;
-				strcpy(WizFi360_APs.AP[WizFi360_APs.Count].SSID, ptr);
+				/* Ignore first ", SSID ends with " before comma and can include commas */
+				if (*ptr == '"') {
+					ptr++;
+				}
+				i = 0;
+				while (*ptr && (*ptr != '"' || (*(ptr + 1) != ',' && *(ptr + 1) != ')'))) {
+					if (i < (sizeof(AP->SSID) - 1)) {
+						AP->SSID[i++] = *ptr;
+					}
+					ptr++;
+				}
+				AP->SSID[i] = 0;
 				break;
 			case 2: 
-				WizFi360_APs.AP[WizFi360_APs.Count].RSSI = ParseNumber(ptr, NULL);
+				AP->RSSI = ParseNumber(ptr, &cnt);
+				ptr += cnt;
 				break;
 			case 3:
-				/* Ignore first and last " */
-				ptr++;
-				ptr[strlen(ptr) - 1] = 0;
-			
-				/* Parse MAC address */
-				ParseMAC(ptr, WizFi360_APs.AP[WizFi360_APs.Count].MAC, NULL);
-			
+				/* Ignore first " and parse MAC address */
+				if (*ptr == '"') {
+					ptr++;
+				}
+				ParseMAC(ptr, AP->MAC, &cnt);
+				ptr += cnt;
 				break;
 			case 4: 
-				WizFi360_APs.AP[WizFi360_APs.Count].Channel = ParseNumber(ptr, NULL);
+				AP->Channel = ParseNumber(ptr, &cnt);
+				ptr += cnt;
 				break;
 			case 5: 
-				WizFi360_APs.AP[WizFi360_APs.Count].Offset = ParseNumber(ptr, NULL);
+				AP->Offset = ParseNumber(ptr, &cnt);
+				ptr += cnt;
 				break;
 			case 6: 
-				WizFi360_APs.AP[WizFi360_APs.Count].Calibration = ParseNumber(ptr, NULL);
+				AP->Calibration = ParseNumber(ptr, &cnt);
+				ptr += cnt;
 				break;
 			default: break;
 		}
 		
-		/* Get new token */
-		ptr = strtok(NULL, ",");
+		/* Go to next field */
+		if ((ptr = strchr(ptr, ',')) != NULL) {
+			ptr++;
+		}
 	}
 	
 	/* Increase count */
-	WizFi360_APs.Count++;
+	WizFi360->APs.Count++;
 }
 #endif
 
@@ -1761,37 +2058,21 @@ static uint32_t ParseHexNumber(char* ptr, uint8_t* cnt) {
 }
 
 static void ParseIP(char* ip_str, uint8_t* arr, uint8_t* cnt) {
-	char* token;
-	uint8_t i = 0;
-	uint8_t x = 0;
-	uint8_t c;
-	char Data[16];
-	
-	/* Make a string copy first */
-	memcpy(Data, ip_str, sizeof(Data) - 1);
-	Data[sizeof(Data) - 1] = 0;
+	uint8_t i = 0, x, c;
 	
-	/* Parse numbers, skip :" */
-	token = strtok(Data, ".");
-	
-	/* We expect 4 loops */
-	while (token != NULL) {
+	/* Parse 4 numbers separated with dots in one pass, input string is not modified */
+	for (x = 0; x < 4; x++) {
 		/* Parse number */
-		arr[x++] = ParseNumber(token, &c);
-		
-		/* Save number of characters used for IP string */
+		arr[x] = ParseNumber(&ip_str[i], &c);
 		i += c;
 		
-		/* Max 4 loops */
-		if (x >= 4) {
+		/* Stop at last number or when dot is missing */
+		if (x == 3 || ip_str[i] != '.') {
 			break;
 		}
 		
 		/* Increase number of characters, used for "." (DOT) */
 		i++;
-		
-		/* Get new token */
-		token = strtok(NULL, ".");
 	}
 	
 	/* Save number of characters */
@@ -1801,312 +2082,195 @@ static void ParseIP(char* ip_str, uint8_t* arr, uint8_t* cnt) {
 }
 
 static void ParseMAC(char* ptr, uint8_t* arr, uint8_t* cnt) {
-	char* hexptr;
-	uint8_t hexnum = 0;
-	uint8_t tmpcnt = 0, sum = 0;
+	uint8_t i = 0, x, c;
 	
-	/* Get token */
-	hexptr = strtok(ptr, ":");
-
-	/* Do it till NULL */
-	while (hexptr != NULL) {
+	/* Parse 6 hex numbers separated with colons in one pass, input string is not modified */
+	for (x = 0; x < 6; x++) {
 		/* Parse hex */
-		arr[hexnum++] = ParseHexNumber(hexptr, &tmpcnt);
-		
-		/* Add to sum value */
-		sum += tmpcnt;
+		arr[x] = ParseHexNumber(&ptr[i], &c);
+		i += c;
 		
-		/* We have 6 characters */
-		if (hexnum >= 6) {
+		/* Stop at last number or when colon is missing */
+		if (x == 5 || ptr[i] != ':') {
 			break;
 		}
 		
 		/* Increase for ":" */
-		sum++;
-		
-		/* Get new token */
-		hexptr = strtok(NULL, ":");
+		i++;
 	}
 	
-	/* Save value */
-	if (cnt) {
-		*cnt = sum;
+	/* Save number of characters */
+	if (cnt != NULL) {
+		*cnt = i;
 	}
 }
 
-static void ParseReceived(WizFi360_t* WizFi360, char* Received, uint8_t from_usart_buffer, uint16_t bufflen) {
-	char* ch_ptr;
-	uint8_t bytes_cnt;
-	uint32_t ipd_ptr = 0;
+static void ParseReceived(WizFi360_t* WizFi360, uint8_t line, uint8_t link, char* Received, uint8_t from_usart_buffer) {
 	WizFi360_Connection_t* Conn;
+	uint8_t cnt, event[2];
 	
 	/* Update last activity */
 	WizFi360->LastReceivedTime = WizFi360->Time;
 	
-	/* Check for empty new line */
-	if (bufflen == 2 && Received[0] == '\r' && Received[1] == '\n') {
-		return;
-	}
-	
 	/* First check, if any command is active */
 	if (WizFi360->ActiveCommand != WizFi360_COMMAND_IDLE && from_usart_buffer == 1) {
-		/* Check if string does not belong to this command */
+		/* Check if line does not belong to this command */
 		if (
-			strcmp(Received, "OK\r\n") != 0 &&
-			strcmp(Received, "SEND OK\r\n") != 0 &&
-			strcmp(Received, "ERROR\r\n") != 0 &&
-			strcmp(Received, "ready\r\n") != 0 &&
-			strcmp(Received, "busy p...\r\n") != 0 &&
-			strncmp(Received, "+IPD", 4) != 0 &&
+			!WizFi360_LINE_ISRESPONSE(line) &&
 			strncmp(Received, WizFi360->ActiveCommandResponse[0], strlen(WizFi360->ActiveCommandResponse[0])) != 0
 		) {
-			/* Save string to temporary buffer, because we received a string which does not belong to this command */
-			BUFFER_WriteString(&TMP_Buffer, Received);
+			/* Save known line to temporary buffer as line type and link ID, it is processed when command is finished */
+			/* Responses to other commands have no use later and are dropped */
+			if (line != WizFi360_LINE_OTHER) {
+				event[0] = line;
+				event[1] = link;
+				BUFFER_Write(&WizFi360->TMP_Buffer, event, 2);
+			}
 			
 			/* Return from function */
 			return;
 		}
 	}
 	
-	/* Device is ready */
-	if (strcmp(Received, "ready\r\n") == 0) {
-		WizFi360_Callback_DeviceReady(WizFi360);
-	}
-	
-	/* Device WDT reset */
-	if (strcmp(Received, "wdt reset\r\n") == 0) {
-		WizFi360_Callback_WatchdogReset(WizFi360);
-	}
-	
 	/* Call user callback functions if not already */
 	CallConnectionCallbacks(WizFi360);
 	
-	/* We are connected to Wi-Fi */
-	if (strcmp(Received, "WIFI CONNECTED\r\n") == 0) {
-		/* Set flag */
-		WizFi360->Flags.F.WifiConnected = 1;
-		
-		/* Call user callback function */
-		WizFi360_Callback_WifiConnected(WizFi360);
-	} else if (strcmp(Received, "WIFI DISCONNECT\r\n") == 0) {
-		/* Clear flags */
-		WizFi360->Flags.F.WifiConnected = 0;
-		WizFi360->Flags.F.WifiGotIP = 0;
-		
-		/* Reset connected wifi structure */
-		memset((uint8_t *)&WizFi360->ConnectedWifi, 0, sizeof(WizFi360->ConnectedWifi));
-		
-		/* Reset all connections */
-		WizFi360_RESET_CONNECTIONS(WizFi360);
-		
-		/* Call user callback function */
-		WizFi360_Callback_WifiDisconnected(WizFi360);
-	} else if (strcmp(Received, "WIFI GOT IP\r\n") == 0) {
-		/* Wifi got IP address */
-		WizFi360->Flags.F.WifiGotIP = 1;
-		
-		/* Call user callback function */
-		WizFi360_Callback_WifiGotIP(WizFi360);
-	}
+	/* Send line to its handler */
+	switch (line) {
+		case WizFi360_LINE_READY:
+			/* Device is ready */
+			WizFi360_Callback_DeviceReady(WizFi360);
+			break;
+		case WizFi360_LINE_WDTRESET:
+			/* Device WDT reset */
+			WizFi360_Callback_WatchdogReset(WizFi360);
+			break;
+		case WizFi360_LINE_WIFICONNECTED:
+			/* We are connected to Wi-Fi, set flag */
+			WizFi360->Flags.F.WifiConnected = 1;
 			
-	/* In case data were send */
-	if (strstr(Received, "SEND OK\r\n") != NULL) {
-		uint8_t cnt;
-		
-		/* Reset active command so user will be able to call new command in callback function */
-		WizFi360->ActiveCommand = WizFi360_COMMAND_IDLE;
-		
-		for (cnt = 0; cnt < WizFi360_MAX_CONNECTIONS; cnt++) {
-			/* Check for data sent */
-			if (WizFi360->Connection[cnt].WaitingSentRespond) {
-				/* Reset flag */
-				WizFi360->Connection[cnt].WaitingSentRespond = 0;
-				
-				/* Call user function according to connection type */
-				if (WizFi360->Connection[cnt].Client) {
-					/* Client mode */
-					WizFi360_Callback_ClientConnectionDataSent(WizFi360, &WizFi360->Connection[cnt]);
-				} else {
-					/* Server mode */
-					WizFi360_Callback_ServerConnectionDataSent(WizFi360, &WizFi360->Connection[cnt]);
+			/* Call user callback function */
+			WizFi360_Callback_WifiConnected(WizFi360);
+			break;
+		case WizFi360_LINE_WIFIDISCONNECT:
+			/* Clear flags */
+			WizFi360->Flags.F.WifiConnected = 0;
+			WizFi360->Flags.F.WifiGotIP = 0;
+			
+			/* Reset connected wifi structure */
+			memset((uint8_t *)&WizFi360->ConnectedWifi, 0, sizeof(WizFi360->ConnectedWifi));
+			
+			/* Reset all connections */
+			WizFi360_RESET_CONNECTIONS(WizFi360);
+			
+			/* Call user callback function */
+			WizFi360_Callback_WifiDisconnected(WizFi360);
+			break;
+		case WizFi360_LINE_WIFIGOTIP:
+			/* Wifi got IP address */
+			WizFi360->Flags.F.WifiGotIP = 1;
+			
+			/* Call user callback function */
+			WizFi360_Callback_WifiGotIP(WizFi360);
+			break;
+		case WizFi360_LINE_SENDOK:
+			/* Force IDLE when we are in SEND mode and SEND OK is returned. Do not wait for "> " wrapper */
+			WizFi360->Flags.F.WaitForWrapper = 0;
+			
+			/* Reset active command so user will be able to call new command in callback function */
+			WizFi360->ActiveCommand = WizFi360_COMMAND_IDLE;
+			
+			for (cnt = 0; cnt < WizFi360_MAX_CONNECTIONS; cnt++) {
+				/* Check for data sent */
+				if (WizFi360->Connection[cnt].WaitingSentRespond) {
+					/* Reset flag */
+					WizFi360->Connection[cnt].WaitingSentRespond = 0;
+					
+					/* Call user function according to connection type */
+					if (WizFi360->Connection[cnt].Client) {
+						/* Client mode */
+						WizFi360_Callback_ClientConnectionDataSent(WizFi360, &WizFi360->Connection[cnt]);
+					} else {
+						/* Server mode */
+						WizFi360_Callback_ServerConnectionDataSent(WizFi360, &WizFi360->Connection[cnt]);
+					}
 				}
 			}
-		}
-	}
-	/* Check if +IPD was received with incoming data */
-	if (strncmp(Received, "+IPD", 4) == 0) {		
-		/* If we are not in IPD mode already */
-		/* Go to IPD mode */
-		WizFi360->IPD.InIPD = 1;
-		WizFi360->IPD.USART_Buffer = from_usart_buffer;
-		
-		/* Reset pointer */
-		ipd_ptr = 5;
-		
-		/* Get connection number from IPD statement */
-		WizFi360->IPD.ConnNumber = CHAR2NUM(Received[ipd_ptr]);
-		
-		/* Set working buffer for this connection */
+			break;
+		case WizFi360_LINE_IPD:
+			/* Go to IPD mode, header was already parsed by stream parser */
+			WizFi360->IPD.InIPD = 1;
+			WizFi360->IPD.USART_Buffer = from_usart_buffer;
+			WizFi360->IPD.ConnNumber = link;
+			Conn = &WizFi360->Connection[link];
+			
+			/* Set working buffer for this connection */
 #if WizFi360_USE_SINGLE_CONNECTION_BUFFER == 1
-		WizFi360->Connection[WizFi360->IPD.ConnNumber].Data = ConnectionData;
+			Conn->Data = WizFi360->ConnectionData;
 #endif
-		
-		/* Save connection number */
-		WizFi360->Connection[WizFi360->IPD.ConnNumber].Number = WizFi360->IPD.ConnNumber;
-		
-		/* Increase pointer by 2 */
-		ipd_ptr += 2;
-		
-		/* Save number of received bytes */
-		WizFi360->Connection[WizFi360->IPD.ConnNumber].BytesReceived = ParseNumber(&Received[ipd_ptr], &bytes_cnt);
-		
-		/* First time */
-		if (WizFi360->Connection[WizFi360->IPD.ConnNumber].TotalBytesReceived == 0) {
-			/* Reset flag */
-			WizFi360->Connection[WizFi360->IPD.ConnNumber].HeadersDone = 0;
 			
-			/* This is first packet of data */
-			WizFi360->Connection[WizFi360->IPD.ConnNumber].FirstPacket = 1;
-		} else {
-			/* This is not first packet */
-			WizFi360->Connection[WizFi360->IPD.ConnNumber].FirstPacket = 0;
-		}
-		
-		/* Save total number of bytes */
-		WizFi360->Connection[WizFi360->IPD.ConnNumber].TotalBytesReceived += WizFi360->Connection[WizFi360->IPD.ConnNumber].BytesReceived;
-		
-		/* Increase global number of bytes received from WizFi360 module to stack */
-		WizFi360->TotalBytesReceived += WizFi360->Connection[WizFi360->IPD.ConnNumber].BytesReceived;
-		
-		/* Increase pointer for number of characters for number and for comma */
-		ipd_ptr += bytes_cnt + 1;
-		
-		/* Save IP */
-		ParseIP(&Received[ipd_ptr], WizFi360->Connection[WizFi360->IPD.ConnNumber].RemoteIP, &bytes_cnt);
-		
-		/* Increase pointer for number of characters for IP string and for comma */
-		ipd_ptr += bytes_cnt + 1;
-		
-		/* Save PORT */
-		WizFi360->Connection[WizFi360->IPD.ConnNumber].RemotePort = ParseNumber(&Received[ipd_ptr], &bytes_cnt);
-		
-		/* Increase pointer */
-		ipd_ptr += bytes_cnt + 1;
-		
-		/* Find : element where real data starts */
-		ipd_ptr = 0;
-		while (Received[ipd_ptr] != ':') {
-			ipd_ptr++;
-		}
-		ipd_ptr++;
-		
-		/* Copy content to beginning of buffer */
-		memcpy((uint8_t *)WizFi360->Connection[WizFi360->IPD.ConnNumber].Data, (uint8_t *)&Received[ipd_ptr], bufflen - ipd_ptr);
-		/* Check for length */
-		if ((bufflen - ipd_ptr) > WizFi360->Connection[WizFi360->IPD.ConnNumber].BytesReceived) {
-			/* Add zero at the end of string */
-			WizFi360->Connection[WizFi360->IPD.ConnNumber].Data[WizFi360->Connection[WizFi360->IPD.ConnNumber].BytesReceived] = 0;
-		}
-		
-		/* Calculate remaining bytes */
-		WizFi360->IPD.InPtr = WizFi360->IPD.PtrTotal = bufflen - ipd_ptr;
-		
-		/* Check remaining data */
-		if (ipd_ptr >= WizFi360->Connection[WizFi360->IPD.ConnNumber].BytesReceived) {
-			/* Not in IPD anymore */
-			WizFi360->IPD.InIPD = 0;
+			/* Save connection number and number of received bytes */
+			Conn->Number = link;
+			Conn->BytesReceived = WizFi360->Parser.DataLength;
 			
-			/* Set package data size */
-			WizFi360->Connection[WizFi360->IPD.ConnNumber].DataSize = ipd_ptr;
-			WizFi360->Connection[WizFi360->IPD.ConnNumber].LastPart = 1;
-			
-			/* Enable flag to call received data callback */
-			WizFi360->Connection[WizFi360->IPD.ConnNumber].CallDataReceived = 1;
-		}
-	}
-	
-	/* Check if we have a new connection */
-	if ((ch_ptr = (char *)mem_mem(Received, bufflen, ",CONNECT\r\n", 10)) != NULL) {
-		/* New connection has been made */
-		Conn = &WizFi360->Connection[CHAR2NUM(*(ch_ptr - 1))];
-		Conn->Active = 1;
-		Conn->Number = CHAR2NUM(*(ch_ptr - 1));
-		
-		/* Call user function according to connection type (client, server) */
-		if (Conn->Client) {			
-			/* Reset current connection */
-			if (WizFi360->ActiveCommand == WizFi360_COMMAND_CIPSTART) {
-				WizFi360->ActiveCommand = WizFi360_COMMAND_IDLE;
+			/* First time */
+			if (Conn->TotalBytesReceived == 0) {
+				/* Reset flag */
+				Conn->HeadersDone = 0;
+				
+				/* This is first packet of data */
+				Conn->FirstPacket = 1;
+			} else {
+				/* This is not first packet */
+				Conn->FirstPacket = 0;
 			}
 			
-			/* Connection started as client */
-			WizFi360_Callback_ClientConnectionConnected(WizFi360, Conn);
-		} else {
-			/* Connection started as server */
-			WizFi360_Callback_ServerConnectionActive(WizFi360, Conn);
-		}
-	}
-	
-	/* Check if already connected */
-	if (strstr(Received, "ALREADY CONNECTED\r\n") != NULL) {
-		printf("Connection %d already connected!\r\n", WizFi360->StartConnectionSent);
-	}
-	
-	/* Check if we have a closed connection */
-	if ((ch_ptr = (char *)mem_mem(Received, bufflen, ",CLOSED\r\n", 9)) != NULL && Received != ch_ptr) {
-		uint8_t client, active;
-		
-		/* Check if CLOSED statement is on beginning, if not, write it to temporary buffer and leave here */
-		/* If not on beginning of string, probably ,CLOSED was returned after +IPD statement */
-		/* Make string standalone */
-		if (ch_ptr == (Received + 1)) {
-			/* Save values */
-			client = WizFi360->Connection[CHAR2NUM(*(ch_ptr - 1))].Client;
-			active = WizFi360->Connection[CHAR2NUM(*(ch_ptr - 1))].Active;
+			/* Save total number of bytes */
+			Conn->TotalBytesReceived += Conn->BytesReceived;
 			
-			/* Connection closed, reset flags now */
-			WizFi360_RESETCONNECTION(WizFi360, &WizFi360->Connection[CHAR2NUM(*(ch_ptr - 1))]);
+			/* Increase global number of bytes received from WizFi360 module to stack */
+			WizFi360->TotalBytesReceived += Conn->BytesReceived;
 			
-			/* Call user function */
-			if (active) {
-				if (client) {
-					/* Client connection closed */
-					WizFi360_Callback_ClientConnectionClosed(WizFi360, &WizFi360->Connection[CHAR2NUM(*(ch_ptr - 1))]);
-				} else {
-					/* Server connection closed */
-					WizFi360_Callback_ServerConnectionClosed(WizFi360, &WizFi360->Connection[CHAR2NUM(*(ch_ptr - 1))]);
-				}
-			}
-		} else {
-			/* Write to temporary buffer */
-			BUFFER_Write(&TMP_Buffer, (uint8_t *)(ch_ptr - 1), 10);
-		}
-	}
-	
-	/* Check if we have a new connection */
-	if ((ch_ptr = strstr(Received, ",CONNECT FAIL\r\n")) != NULL) {
-		/* New connection has been made */
-		Conn = &WizFi360->Connection[CHAR2NUM(*(ch_ptr - 1))];
-		WizFi360_RESETCONNECTION(WizFi360, Conn);
-		Conn->Number = CHAR2NUM(*(ch_ptr - 1));
-		
-		/* Call user function according to connection type (client, server) */
-		if (Conn->Client) {
-			/* Reset current connection */
-			if (WizFi360->ActiveCommand == WizFi360_COMMAND_CIPSTART) {
-				WizFi360->ActiveCommand = WizFi360_COMMAND_IDLE;
+			/* Remote IP and port are only sent when enabled with AT+CIPDINFO */
+			if (WizFi360->Parser.Field == WizFi360_IPD_FIELD_PORT) {
+				memcpy(Conn->RemoteIP, WizFi360->Parser.IP, 4);
+				Conn->RemotePort = WizFi360->Parser.Port;
 			}
 			
-			/* Connection failed */
-			WizFi360_Callback_ClientConnectionError(WizFi360, Conn);
-		}
+			/* Header ends with colon, data follow in USART buffer and are read in update function */
+			WizFi360->IPD.InPtr = WizFi360->IPD.PtrTotal = 0;
+			
+			/* Check for empty packet */
+			if (Conn->BytesReceived == 0) {
+				/* Not in IPD anymore */
+				WizFi360->IPD.InIPD = 0;
+				
+				/* Set package data size */
+				Conn->DataSize = 0;
+				Conn->LastPart = 1;
+				
+				/* Enable flag to call received data callback */
+				Conn->CallDataReceived = 1;
+			}
+			break;
+		case WizFi360_LINE_CONNECT:
+		case WizFi360_LINE_CLOSED:
+		case WizFi360_LINE_CONNECTFAIL:
+			/* Check connection status */
+			ParseConnectionStatus(WizFi360, line, link);
+			break;
+		case WizFi360_LINE_ALREADYCONNECTED:
+			printf("Connection %d already connected!\r\n", WizFi360->StartConnectionSent);
+			break;
+		default:
+			break;
 	}
 	
 	/* Check commands we have sent */
 	switch (WizFi360->ActiveCommand) {
 		/* Check wifi disconnect response */
 		case WizFi360_COMMAND_CWQAP:
-			if (strcmp(Received, "OK\r\n") == 0) {
+			if (line == WizFi360_LINE_OK) {
 				/* Reset active command */
 				WizFi360->ActiveCommand = WizFi360_COMMAND_IDLE;
 			}
@@ -2121,12 +2285,12 @@ static void ParseReceived(WizFi360_t* WizFi360, char* Received, uint8_t from_usa
 				WizFi360->WifiConnectError = (WizFi360_WifiConnectError_t)CHAR2NUM(Received[7]);
 			}
 			
-			if (strcmp(Received, "OK\r\n") == 0) {
+			if (line == WizFi360_LINE_OK) {
 				/* Reset active command */
 				WizFi360->ActiveCommand = WizFi360_COMMAND_IDLE;
 			}
 			
-			if (strcmp(Received, "FAIL\r\n") == 0) {
+			if (line == WizFi360_LINE_FAIL) {
 				/* Reset active command */
 				WizFi360->ActiveCommand = WizFi360_COMMAND_IDLE;
 				
@@ -2140,7 +2304,7 @@ static void ParseReceived(WizFi360_t* WizFi360, char* Received, uint8_t from_usa
 				/* Parse string */
 				ParseCWJAP(WizFi360, Received);
 			}
-			if (strcmp(Received, "OK\r\n") == 0) {
+			if (line == WizFi360_LINE_OK) {
 				/* Reset active command */
 				WizFi360->ActiveCommand = WizFi360_COMMAND_IDLE;
 			}
@@ -2152,12 +2316,12 @@ static void ParseReceived(WizFi360_t* WizFi360, char* Received, uint8_t from_usa
 				/* Parse CWLAP */
 				ParseCWLAP(WizFi360, Received);
 			}
-			if (strcmp(Received, "OK\r\n") == 0) {
+			if (line == WizFi360_LINE_OK) {
 				/* Reset active command */
 				WizFi360->ActiveCommand = WizFi360_COMMAND_IDLE;
 				
 				/* Call user function */
-				WizFi360_Callback_WifiDetected(WizFi360, &WizFi360_APs);
+				WizFi360_Callback_WifiDetected(WizFi360, &WizFi360->APs);
 			}
 			break;
 #endif
@@ -2167,7 +2331,7 @@ static void ParseReceived(WizFi360_t* WizFi360, char* Received, uint8_t from_usa
 				/* Parse CWLAP */
 				ParseCWSAP(WizFi360, Received);
 			}
-			if (strcmp(Received, "OK\r\n") == 0) {
+			if (line == WizFi360_LINE_OK) {
 				/* Reset active command */
 				WizFi360->ActiveCommand = WizFi360_COMMAND_IDLE;
 			}
@@ -2179,7 +2343,7 @@ static void ParseReceived(WizFi360_t* WizFi360, char* Received, uint8_t from_usa
 				ParseCIPSTA(WizFi360, Received);
 			}
 		
-			if (strcmp(Received, "OK\r\n") == 0) {
+			if (line == WizFi360_LINE_OK) {
 				/* Reset active command */
 				WizFi360->ActiveCommand = WizFi360_COMMAND_IDLE;
 				
@@ -2194,13 +2358,13 @@ static void ParseReceived(WizFi360_t* WizFi360, char* Received, uint8_t from_usa
 				ParseCIPSTA(WizFi360, Received);
 			}
 		
-			if (strcmp(Received, "OK\r\n") == 0) {
+			if (line == WizFi360_LINE_OK) {
 				/* Reset active command */
 				WizFi360->ActiveCommand = WizFi360_COMMAND_IDLE;
 			}
 			break;
 		case WizFi360_COMMAND_CWMODE:
-			if (strcmp(Received, "OK\r\n") == 0) {
+			if (line == WizFi360_LINE_OK) {
 				/* Reset active command */
 				WizFi360->ActiveCommand = WizFi360_COMMAND_IDLE;
 				
@@ -2209,13 +2373,13 @@ static void ParseReceived(WizFi360_t* WizFi360, char* Received, uint8_t from_usa
 			}
 			break;
 		case WizFi360_COMMAND_CIPSERVER:
-			if (strcmp(Received, "OK\r\n") == 0) {
+			if (line == WizFi360_LINE_OK) {
 				/* Reset active command */
 				WizFi360->ActiveCommand = WizFi360_COMMAND_IDLE;
 			}
 			break;
 		case WizFi360_COMMAND_SEND:
-			if (strcmp(Received, "OK\r\n") == 0) {
+			if (line == WizFi360_LINE_OK) {
 				/* Reset active command */
 				WizFi360->ActiveCommand = WizFi360_COMMAND_SENDDATA;
 				
@@ -2229,11 +2393,11 @@ static void ParseReceived(WizFi360_t* WizFi360, char* Received, uint8_t from_usa
 		case WizFi360_COMMAND_SENDDATA:
 			break;
 		case WizFi360_COMMAND_CIPSTART:
-			if (strcmp(Received, "OK\r\n") == 0) {
+			if (line == WizFi360_LINE_OK) {
 				/* Reset active command */
 				WizFi360->ActiveCommand = WizFi360_COMMAND_IDLE;
 			}
-			if (strcmp(Received, "ERROR\r\n") == 0) {
+			if (line == WizFi360_LINE_ERROR) {
 				/* Reset active command */
 				WizFi360->ActiveCommand = WizFi360_COMMAND_IDLE;
 				
@@ -2253,13 +2417,13 @@ static void ParseReceived(WizFi360_t* WizFi360, char* Received, uint8_t from_usa
 		case WizFi360_COMMAND_GSLP:
 		case WizFi360_COMMAND_CIPSTO:
 		case WizFi360_COMMAND_RESTORE:
-			if (strcmp(Received, "OK\r\n") == 0) {
+			if (line == WizFi360_LINE_OK) {
 				/* Reset active command */
 				WizFi360->ActiveCommand = WizFi360_COMMAND_IDLE;
 			}
 			break;
 		case WizFi360_COMMAND_RST:
-			if (strcmp(Received, "ready\r\n") == 0) {
+			if (line == WizFi360_LINE_READY) {
 				/* Reset active command */
 				WizFi360->ActiveCommand = WizFi360_COMMAND_IDLE;
 				
@@ -2274,7 +2438,7 @@ static void ParseReceived(WizFi360_t* WizFi360, char* Received, uint8_t from_usa
 				/* Parse number for pinging */
 				WizFi360->PING.Time = ParseNumber(&Received[1], NULL);
 			}
-			if (strcmp(Received, "OK\r\n") == 0) {
+			if (line == WizFi360_LINE_OK) {
 				/* Reset active command */
 				WizFi360->ActiveCommand = WizFi360_COMMAND_IDLE;
 				
@@ -2283,7 +2447,7 @@ static void ParseReceived(WizFi360_t* WizFi360, char* Received, uint8_t from_usa
 				
 				/* Error callback */
 				WizFi360_Callback_PingFinished(WizFi360, &WizFi360->PING);
-			} else if (strcmp(Received, "ERROR\r\n") == 0) {
+			} else if (line == WizFi360_LINE_ERROR) {
 				/* Reset active command */
 				WizFi360->ActiveCommand = WizFi360_COMMAND_IDLE;
 				
@@ -2302,7 +2466,7 @@ static void ParseReceived(WizFi360_t* WizFi360, char* Received, uint8_t from_usa
 				ParseMAC(&Received[12], WizFi360->STAMAC, NULL);
 			}
 		
-			if (strcmp(Received, "OK\r\n") == 0) {
+			if (line == WizFi360_LINE_OK) {
 				/* Reset active command */
 				WizFi360->ActiveCommand = WizFi360_COMMAND_IDLE;
 			}
@@ -2314,7 +2478,7 @@ static void ParseReceived(WizFi360_t* WizFi360, char* Received, uint8_t from_usa
 				ParseMAC(&Received[11], WizFi360->APMAC, NULL);
 			}
 		
-			if (strcmp(Received, "OK\r\n") == 0) {
+			if (line == WizFi360_LINE_OK) {
 				/* Reset active command */
 				WizFi360->ActiveCommand = WizFi360_COMMAND_IDLE;
 			}
@@ -2336,7 +2500,7 @@ static void ParseReceived(WizFi360_t* WizFi360, char* Received, uint8_t from_usa
 				WizFi360_Callback_FirmwareUpdateStatus(WizFi360, (WizFi360_FirmwareUpdate_t)num);
 			}
 		
-			if (strcmp(Received, "OK\r\n") == 0 || strcmp(Received, "ready\r\n") == 0) {
+			if (line == WizFi360_LINE_OK || line == WizFi360_LINE_READY) {
 				/* Reset active command */
 				WizFi360->ActiveCommand = WizFi360_COMMAND_IDLE;
 				
@@ -2347,7 +2511,7 @@ static void ParseReceived(WizFi360_t* WizFi360, char* Received, uint8_t from_usa
 				WizFi360_Callback_FirmwareUpdateSuccess(WizFi360);
 			}
 			
-			if (strcmp(Received, "ERROR\r\n") == 0) {
+			if (line == WizFi360_LINE_ERROR) {
 				/* Reset active command */
 				WizFi360->ActiveCommand = WizFi360_COMMAND_IDLE;
 				
@@ -2366,7 +2530,7 @@ static void ParseReceived(WizFi360_t* WizFi360, char* Received, uint8_t from_usa
 				ParseCWLIF(WizFi360, Received);
 			}
 		
-			if (strcmp(Received, "OK\r\n") == 0) {
+			if (line == WizFi360_LINE_OK) {
 				/* Reset active command */
 				WizFi360->ActiveCommand = WizFi360_COMMAND_IDLE;
 				
@@ -2380,7 +2544,7 @@ static void ParseReceived(WizFi360_t* WizFi360, char* Received, uint8_t from_usa
 	}
 	
 	/* Set flag for last operation status */
-	if (strcmp(Received, "OK\r\n") == 0) {
+	if (line == WizFi360_LINE_OK) {
 		WizFi360->Flags.F.LastOperationStatus = 1;
 		
 		/* Reset active command */
@@ -2390,107 +2554,575 @@ static void ParseReceived(WizFi360_t* WizFi360, char* Received, uint8_t from_usa
 			WizFi360->ActiveCommand = WizFi360_COMMAND_IDLE;
 		}
 	}
-	if (strcmp(Received, "ERROR\r\n") == 0 || strcmp(Received, "busy p...\r\n") == 0) {
+	if (line == WizFi360_LINE_ERROR || line == WizFi360_LINE_BUSY) {
 		WizFi360->Flags.F.LastOperationStatus = 0;
 		
 		/* Reset active command */
 		/* TODO: Check if ERROR here */
 		WizFi360->ActiveCommand = WizFi360_COMMAND_IDLE;
 	}
-	if (strcmp(Received, "SEND OK\r\n") == 0) {
-		/* Force IDLE when we are in SEND mode and SEND OK is returned. Do not wait for "> " wrapper */
-		WizFi360->ActiveCommand = WizFi360_COMMAND_IDLE;
+}
+
+static uint8_t FindLine(uint8_t line, uint8_t length, uint8_t ch) {
+	const char* Str = WizFi360_Lines[line].Str;
+	uint8_t i;
+	
+	/* Find known line with the same start as already matched characters, followed by new character */
+	for (i = 0; i < WizFi360_LINES_COUNT; i++) {
+		if (
+			WizFi360_Lines[i].Length > length &&
+			WizFi360_LINE_CHAR(WizFi360_Lines[i].Str[length], ch) &&
+			strncmp(WizFi360_Lines[i].Str, Str, length) == 0
+		) {
+			return i;
+		}
+	}
+	
+	/* Unknown line */
+	return WizFi360_LINES_COUNT;
+}
+
+static void ParseConnectionStatus(WizFi360_t* WizFi360, uint8_t line, uint8_t link) {
+	WizFi360_Connection_t* Conn = &WizFi360->Connection[link];
+	uint8_t client, active;
+	
+	/* Check if we have a new connection */
+	if (line == WizFi360_LINE_CONNECT) {
+		/* New connection has been made */
+		Conn->Active = 1;
+		Conn->Number = link;
 		
-		/* Clear flag */
-		WizFi360->Flags.F.WaitForWrapper = 0;
+		/* Call user function according to connection type (client, server) */
+		if (Conn->Client) {			
+			/* Reset current connection */
+			if (WizFi360->ActiveCommand == WizFi360_COMMAND_CIPSTART) {
+				WizFi360->ActiveCommand = WizFi360_COMMAND_IDLE;
+			}
+			
+			/* Connection started as client */
+			WizFi360_Callback_ClientConnectionConnected(WizFi360, Conn);
+		} else {
+			/* Connection started as server */
+			WizFi360_Callback_ServerConnectionActive(WizFi360, Conn);
+		}
+	}
+	
+	/* Check if we have a closed connection */
+	if (line == WizFi360_LINE_CLOSED) {
+		/* Save values */
+		client = Conn->Client;
+		active = Conn->Active;
+		
+		/* Connection closed, reset flags now */
+		WizFi360_RESETCONNECTION(WizFi360, Conn);
+		
+		/* Call user function */
+		if (active) {
+			if (client) {
+				/* Client connection closed */
+				WizFi360_Callback_ClientConnectionClosed(WizFi360, Conn);
+			} else {
+				/* Server connection closed */
+				WizFi360_Callback_ServerConnectionClosed(WizFi360, Conn);
+			}
+		}
+	}
+	
+	/* Check if connection failed */
+	if (line == WizFi360_LINE_CONNECTFAIL) {
+		/* Connection was not made */
+		WizFi360_RESETCONNECTION(WizFi360, Conn);
+		Conn->Number = link;
+		
+		/* Call user function according to connection type (client, server) */
+		if (Conn->Client) {
+			/* Reset current connection */
+			if (WizFi360->ActiveCommand == WizFi360_COMMAND_CIPSTART) {
+				WizFi360->ActiveCommand = WizFi360_COMMAND_IDLE;
+			}
+			
+			/* Connection failed */
+			WizFi360_Callback_ClientConnectionError(WizFi360, Conn);
+		}
 	}
 }
 
+static void ParseStream(WizFi360_t* WizFi360) {
+	WizFi360_Parser_t* Parser = &WizFi360->Parser;
+	const WizFi360_Line_t* Line;
+	BUFFER_Size_t count, i;
+	BUFFER_Pos_t checked;
+	char* Received;
+	uint8_t* data;
+	uint8_t ch, c, line, next, state, length;
+	
+	/* Parse characters until module sends +IPD data, they are read by IPD part */
+	while (!WizFi360->IPD.InIPD) {
+		/* Only characters already checked by token matcher can be removed, wrapper must be found first */
+		checked = (BUFFER_Pos_t)(WizFi360->USART_Matcher.Pos - WizFi360->USART_Buffer->Out);
+		if (checked <= 0) {
+			break;
+		}
+		
+		/* Command response is read from buffer when complete line is received */
+		if (Parser->State == WizFi360_PARSER_RESPONSE) {
+			if (!ParseResponse(WizFi360, checked)) {
+				break;
+			}
+			continue;
+		}
+		
+		/* Get linear block of characters directly from USART buffer */
+		count = BUFFER_PeekRead(WizFi360->USART_Buffer, &data);
+		if (count == 0) {
+			break;
+		}
+		if (count > (BUFFER_Size_t)checked) {
+			count = (BUFFER_Size_t)checked;
+		}
+		
+		/* Keep state in local variables, characters in block may alias parser structure */
+		state = Parser->State;
+		length = Parser->Length;
+		Line = &WizFi360_Lines[Parser->Line];
+		
+		/* Go through block until known line is finished, characters are not copied and state is kept between calls */
+		line = WizFi360_LINE_OTHER;
+		Received = NULL;
+		i = 0;
+		while (i < count && line == WizFi360_LINE_OTHER && state != WizFi360_PARSER_RESPONSE) {
+			ch = data[i];
+			switch (state) {
+				case WizFi360_PARSER_START:
+					/* Compare new line with known lines from the first one */
+					state = WizFi360_PARSER_LINE;
+					Line = &WizFi360_Lines[0];
+					length = 0;
+					
+					/* Fall through */
+				case WizFi360_PARSER_LINE:
+					/* On mismatch, find other known line with the same start */
+					c = (uint8_t)Line->Str[length];
+					if (!WizFi360_LINE_CHAR(c, ch)) {
+						next = FindLine((uint8_t)(Line - WizFi360_Lines), length, ch);
+						if (next == WizFi360_LINES_COUNT) {
+							/* Line starting with "+" or link ID may be response to active command, leave it in buffer */
+							if (WizFi360->ActiveCommand != WizFi360_COMMAND_IDLE && (Line->Str[0] == '+' || Line->Str[0] == '#')) {
+								state = WizFi360_PARSER_RESPONSE;
+								continue;
+							}
+							
+							/* Skip unknown line, check current character again */
+							state = WizFi360_PARSER_SKIP;
+							length = 0;
+							continue;
+						}
+						Line = &WizFi360_Lines[next];
+						c = (uint8_t)Line->Str[length];
+					}
+					
+					/* Save link ID digit */
+					if (c == '#') {
+						Parser->Link = CHAR2NUM(ch);
+					}
+					
+					/* Compare following characters of known line in place */
+					while (++length < Line->Length && (i + 1) < count && (uint8_t)Line->Str[length] == data[i + 1]) {
+						i++;
+					}
+					
+					/* Check if known line is complete */
+					if (length == Line->Length) {
+						if (Line->Line == WizFi360_LINE_IPD) {
+							/* Parse numbers of +IPD header */
+							state = WizFi360_PARSER_IPD;
+							Parser->Field = WizFi360_IPD_FIELD_LINK;
+							Parser->DataLength = 0;
+							Parser->Port = 0;
+							memset(Parser->IP, 0, sizeof(Parser->IP));
+						} else {
+							/* Empty line and wrapper are finished without handler */
+							line = Line->Line;
+							Received = (char *)Line->Str;
+							state = WizFi360_PARSER_START;
+						}
+					}
+					break;
+				case WizFi360_PARSER_IPD:
+					if (CHARISNUM(ch)) {
+						/* Add digit to current field, link ID is moved from length when comma follows */
+						if (Parser->Field <= WizFi360_IPD_FIELD_LENGTH) {
+							Parser->DataLength = 10 * Parser->DataLength + CHAR2NUM(ch);
+						} else if (Parser->Field < WizFi360_IPD_FIELD_PORT) {
+							Parser->IP[Parser->Field - WizFi360_IPD_FIELD_IP] = 10 * Parser->IP[Parser->Field - WizFi360_IPD_FIELD_IP] + CHAR2NUM(ch);
+						} else {
+							Parser->Port = 10 * Parser->Port + CHAR2NUM(ch);
+						}
+					} else if (ch == ',' && Parser->Field == WizFi360_IPD_FIELD_LINK) {
+						/* First number was link ID */
+						Parser->Link = Parser->DataLength < WizFi360_MAX_CONNECTIONS ? Parser->DataLength : WizFi360_MAX_CONNECTIONS;
+						Parser->DataLength = 0;
+						Parser->Field++;
+					} else if (
+						(ch == ',' && (Parser->Field == WizFi360_IPD_FIELD_LENGTH || Parser->Field == WizFi360_IPD_FIELD_PORT - 1)) ||
+						(ch == '.' && Parser->Field >= WizFi360_IPD_FIELD_IP && Parser->Field < WizFi360_IPD_FIELD_PORT - 1)
+					) {
+						/* Remote IP and port are only sent when enabled with AT+CIPDINFO */
+						Parser->Field++;
+					} else if (ch == ':') {
+						/* Header ends with colon, without link ID in single connection mode */
+						if (Parser->Field == WizFi360_IPD_FIELD_LINK) {
+							Parser->Link = 0;
+						}
+						line = WizFi360_LINE_IPD;
+						Received = "";
+						state = WizFi360_PARSER_START;
+					} else {
+						/* Not valid header, skip line and check current character again */
+						state = WizFi360_PARSER_SKIP;
+						length = 0;
+						continue;
+					}
+					break;
+				case WizFi360_PARSER_SKIP:
+					/* Unknown line is skipped to its end, only data sent confirmation is checked at the end */
+					while (ch != '\n') {
+						if (ch == (uint8_t)WizFi360_SENDOK_SUFFIX[length]) {
+							length++;
+						} else {
+							length = ch == 'S';
+						}
+						if (++i == count) {
+							break;
+						}
+						ch = data[i];
+					}
+					
+					/* Wait for next block if line is not finished */
+					if (ch != '\n') {
+						continue;
+					}
+					if (length == (sizeof(WizFi360_SENDOK_SUFFIX) - 2)) {
+						line = WizFi360_LINE_SENDOK;
+						Received = WizFi360_SENDOK_SUFFIX;
+					}
+					state = WizFi360_PARSER_START;
+					break;
+				default:
+					break;
+			}
+			i++;
+		}
+		
+		/* Save state for next block */
+		Parser->State = state;
+		Parser->Length = length;
+		Parser->Line = (uint8_t)(Line - WizFi360_Lines);
+		
+		/* Remove parsed characters from buffer */
+		BUFFER_CommitRead(WizFi360->USART_Buffer, i);
+		
+		/* Send finished line to its handler, lines with invalid link ID are ignored */
+		if (line != WizFi360_LINE_OTHER && (!WizFi360_LINE_HASLINK(line) || Parser->Link < WizFi360_MAX_CONNECTIONS)) {
+			ParseReceived(WizFi360, line, Parser->Link, Received, 1);
+		}
+	}
+}
+
+static uint8_t ParseResponse(WizFi360_t* WizFi360, BUFFER_Pos_t checked) {
+	WizFi360_Parser_t* Parser = &WizFi360->Parser;
+	const char* Str = WizFi360_Lines[Parser->Line].Str;
+	char Received[WizFi360_LINE_SIZE];
+	BUFFER_Pos_t pos;
+	uint8_t i;
+	
+	/* Find end of line in characters checked by token matcher */
+	pos = BUFFER_FindElement(WizFi360->USART_Buffer, '\n');
+	if (pos < 0 || pos >= checked) {
+		/* Wait for more characters if line can still be stored */
+		if ((Parser->Length + checked) < (WizFi360_LINE_SIZE - 1)) {
+			return 0;
+		}
+		pos = checked;
+	}
+	
+	/* Line is too long to be stored, skip it */
+	if ((Parser->Length + pos + 1) > (WizFi360_LINE_SIZE - 1)) {
+		Parser->State = WizFi360_PARSER_SKIP;
+		Parser->Length = 0;
+		return 1;
+	}
+	
+	/* Start of line is already removed from buffer, it is the same as known line it was compared with */
+	for (i = 0; i < Parser->Length; i++) {
+		Received[i] = Str[i] == '#' ? (char)('0' + Parser->Link) : Str[i];
+	}
+	
+	/* Read rest of line with one copy, response handlers need string */
+	BUFFER_Read(WizFi360->USART_Buffer, (uint8_t *)&Received[i], (BUFFER_Size_t)(pos + 1));
+	Received[i + pos + 1] = 0;
+	
+	/* Start new line before parsing, parser can reset buffer */
+	Parser->State = WizFi360_PARSER_START;
+	
+	/* Parse response */
+	ParseReceived(WizFi360, WizFi360_LINE_OTHER, 0, Received, 1);
+	return 1;
+}
+
+static void ResetUSARTBuffer(WizFi360_t* WizFi360) {
+	/* Discard received characters */
+	BUFFER_Reset(WizFi360->USART_Buffer);
+	
+	/* Discard current line */
+	WizFi360->Parser.State = WizFi360_PARSER_START;
+}
+
 static WizFi360_Result_t SendCommand(WizFi360_t* WizFi360, uint8_t Command, char* CommandStr, char* StartRespond) {
+	/* Start command */
+	if (StartCommand(WizFi360, Command, StartRespond) != ESP_OK) {
+		return WizFi360->Result;
+	}
+	
+	/* Send constant command string */
+	CommandAddString(WizFi360, CommandStr);
+	CommandFlush(WizFi360);
+	
+	/* Return OK */
+	WizFi360_RETURNWITHSTATUS(WizFi360, ESP_OK);
+}
+
+static WizFi360_Result_t StartCommand(WizFi360_t* WizFi360, uint8_t Command, char* StartRespond) {
 	/* Check idle mode */
 	WizFi360_CHECK_IDLE(WizFi360);
 	
 	/* Clear buffer */
 	if (Command == WizFi360_COMMAND_UART) {
 		/* Reset USART buffer */
-		BUFFER_Reset(&USART_Buffer);
+		ResetUSARTBuffer(WizFi360);
 	}
 	
-	/* Clear buffer and send command */
-	WizFi360_LL_USARTSend((uint8_t *)CommandStr, strlen(CommandStr));
-	
 	/* Save current active command */
 	WizFi360->ActiveCommand = Command;
 	WizFi360->ActiveCommandResponse[0][0] = 0;
-	strcpy(WizFi360->ActiveCommandResponse[0], StartRespond);
+	if (StartRespond) {
+		strcpy(WizFi360->ActiveCommandResponse[0], StartRespond);
+	}
 	
-	/* Set command start time */
+	/* Set command start time, time may not be updated since last call to update function */
+	if (WizFi360->Transport->Now) {
+		WizFi360->Time = WizFi360->Transport->Now(WizFi360->Transport->Arg);
+	}
 	WizFi360->StartTime = WizFi360->Time;
 	
 	/* Return OK */
 	WizFi360_RETURNWITHSTATUS(WizFi360, ESP_OK);
 }
 
-static char* EscapeString(char* str) {
-	static char buff[100];
-	char* str_ptr = buff;
+static void CommandAdd(WizFi360_t* WizFi360, const void* data, uint16_t length, uint8_t persistent) {
+	/* Ignore empty blocks */
+	if (!length) {
+		return;
+	}
+	
+	/* Send blocks collected so far if list is full */
+	if (WizFi360->Command_Count == WizFi360_COMMAND_BLOCKS) {
+		CommandFlush(WizFi360);
+	}
+	
+	/* Add block */
+	WizFi360->Command_Blocks[WizFi360->Command_Count].Data = data;
+	WizFi360->Command_Blocks[WizFi360->Command_Count].Length = length;
+	WizFi360->Command_Blocks[WizFi360->Command_Count].Persistent = persistent;
+	WizFi360->Command_Count++;
+}
+
+static void CommandAddString(WizFi360_t* WizFi360, const char* str) {
+	/* Constant strings stay valid until they are sent */
+	CommandAdd(WizFi360, str, strlen(str), 1);
+}
+
+static void CommandAddEscaped(WizFi360_t* WizFi360, const char* str) {
+	const char* start = str;
 	
 	/* Go through string */
-	while (*str) {
+	for (; *str; str++) {
 		/* Check for special character */
 		if (*str == ',' || *str == '"' || *str == '\\') {
-			*str_ptr++ = '/';
+			/* Add characters before it and escape character, special character starts next block */
+			CommandAdd(WizFi360, start, str - start, 0);
+			CommandAdd(WizFi360, "/", 1, 1);
+			start = str;
 		}
-		/* Copy and increase pointers */
-		*str_ptr++ = *str++;
 	}
 	
-	/* Add zero to the end */
-	*str_ptr = 0;
+	/* Add the rest of string */
+	CommandAdd(WizFi360, start, str - start, 0);
+}
+
+static char* CommandAlloc(WizFi360_t* WizFi360, uint8_t length) {
+	char* ptr;
+	
+	/* Formatted value must stay in memory until it is sent */
+	if (WizFi360->Command_NumbersLen + length > WizFi360_COMMAND_NUMBERS_SIZE || WizFi360->Command_Count == WizFi360_COMMAND_BLOCKS) {
+		CommandFlush(WizFi360);
+	}
+	
+	/* Add block for value */
+	ptr = &WizFi360->Command_Numbers[WizFi360->Command_NumbersLen];
+	CommandAdd(WizFi360, ptr, length, 0);
+	WizFi360->Command_NumbersLen += length;
 	
-	/* Return buffer */
-	return buff;
+	/* Return pointer to write value to */
+	return ptr;
 }
 
-char* ReverseEscapeString(char* str) {
-	static char buff[100];
-	char* str_ptr = buff;
+static void CommandAddNumber(WizFi360_t* WizFi360, uint32_t num) {
+	uint32_t tmp = num;
+	uint8_t length = 0;
+	char* ptr;
 	
-	/* Go through string */
-	while (*str) {
-		/* Check for special character */
-		if (*str == '/') {
-			/* Check for next string after '/' */
-			if (*(str + 1) == ',' || *(str + 1) == '"' || *(str + 1) == '\\') {
-				/* Ignore '/' */
-				str++;
+	/* Count digits */
+	do {
+		length++;
+		tmp /= 10;
+	} while (tmp);
+	
+	/* Write digits from the end */
+	ptr = CommandAlloc(WizFi360, length) + length;
+	do {
+		*--ptr = '0' + num % 10;
+		num /= 10;
+	} while (num);
+}
+
+static void CommandAddHex(WizFi360_t* WizFi360, uint8_t num) {
+	static const char hex[] = "0123456789abcdef";
+	char* ptr = CommandAlloc(WizFi360, 2);
+	
+	/* Write 2 lowercase hex digits */
+	ptr[0] = hex[num >> 4];
+	ptr[1] = hex[num & 0x0F];
+}
+
+static void CommandEnd(WizFi360_t* WizFi360) {
+	/* Add CRLF trailer and send command */
+	CommandAdd(WizFi360, "\r\n", 2, 1);
+	CommandFlush(WizFi360);
+}
+
+static void CommandFlush(WizFi360_t* WizFi360) {
+	/* Send collected blocks back to back */
+	TransmitBlocks(WizFi360, WizFi360->Command_Blocks, WizFi360->Command_Count);
+	
+	/* Reset list and numbers memory */
+	WizFi360->Command_Count = 0;
+	WizFi360->Command_NumbersLen = 0;
+}
+
+static void DetectBaudrateReset(WizFi360_t* WizFi360) {
+	uint8_t i;
+	
+	/* Init USART */
+	WizFi360->Transport->SetBaudrate(WizFi360->Transport->Arg, WizFi360->Baudrate);
+	
+	/* Set allowed timeout */
+	WizFi360->Timeout = 1000;
+	
+	/* Reset device */
+	SendCommand(WizFi360, WizFi360_COMMAND_RST, "AT+RST\r\n", "ready\r\n");
+	
+	/* Wait till idle */
+	WizFi360_WaitReady(WizFi360);
+
+	/* Check status */
+	if (!WizFi360->Flags.F.LastOperationStatus) {
+		/* Check for baudrate, try with predefined baudrates */
+		for (i = 0; i < sizeof(WizFi360_Baudrate) / sizeof(WizFi360_Baudrate[0]); i++) {
+			/* Init USART */
+			WizFi360->Transport->SetBaudrate(WizFi360->Transport->Arg, WizFi360_Baudrate[i]);
+			
+			/* Set allowed timeout */
+			WizFi360->Timeout = 1000;
+			
+			/* Reset device */
+			SendCommand(WizFi360, WizFi360_COMMAND_RST, "AT+RST\r\n", "ready\r\n");
+			
+			/* Wait till idle */
+			WizFi360_WaitReady(WizFi360);
+		
+			/* Check status */
+			if (WizFi360->Flags.F.LastOperationStatus) {
+				/* Save current baudrate */
+				WizFi360->Baudrate = WizFi360_Baudrate[i];
+				
+				break;
 			}
 		}
-		
-		/* Copy and increase pointers */
-		*str_ptr++ = *str++;
 	}
+}
+
+#if WizFi360_USE_BAUDRATE_PROBE
+static void DetectBaudrateProbe(WizFi360_t* WizFi360) {
+	uint32_t baudrate;
+	uint8_t i, retry;
 	
-	/* Add zero to the end */
-	*str_ptr = 0;
+	/* Module responds to AT command immediately */
+	WizFi360->Timeout = WizFi360_PROBE_TIMEOUT;
 	
-	/* Return buffer */
-	return buff;
+	/* Try with init baudrate first, then with predefined baudrates */
+	for (i = 0; i <= sizeof(WizFi360_Baudrate) / sizeof(WizFi360_Baudrate[0]); i++) {
+		baudrate = i ? WizFi360_Baudrate[i - 1] : WizFi360->Baudrate;
+		
+		/* Init baudrate was already tried */
+		if (i && baudrate == WizFi360->Baudrate) {
+			continue;
+		}
+		
+		/* Init USART and delete data received on previous baudrate */
+		WizFi360->Transport->SetBaudrate(WizFi360->Transport->Arg, baudrate);
+		ResetUSARTBuffer(WizFi360);
+		
+		/* First command may be merged with data module sent before */
+		for (retry = 0; retry < 2; retry++) {
+			/* Test device */
+			SendCommand(WizFi360, WizFi360_COMMAND_AT, "AT\r\n", "OK\r\n");
+			
+			/* Wait till idle */
+			WizFi360_WaitReady(WizFi360);
+			
+			/* Check status */
+			if (WizFi360->Flags.F.LastOperationStatus) {
+				/* Save current baudrate */
+				WizFi360->Baudrate = baudrate;
+				
+				return;
+			}
+		}
+	}
 }
+#endif
 
 static WizFi360_Result_t SendUARTCommand(WizFi360_t* WizFi360, uint32_t baudrate, char* cmd) {
-	char command[35];
-	
 	/* Check idle */
 	WizFi360_CHECK_IDLE(WizFi360);
 	
-	/* Format command */
-	sprintf(command, "%s=%d,8,1,0,0\r\n", cmd, baudrate);
+	/* Start command */
+	if (StartCommand(WizFi360, WizFi360_COMMAND_UART, "AT+UART") != ESP_OK) {
+		return WizFi360->Result;
+	}
 	
 	/* Send command */
-	if (SendCommand(WizFi360, WizFi360_COMMAND_UART, command, "AT+UART") != ESP_OK) {
-		return WizFi360->Result;
+	CommandAddString(WizFi360, cmd);
+	CommandAddString(WizFi360, "=");
+	CommandAddNumber(WizFi360, baudrate);
+	if (WizFi360_FLOWCONTROL_AVAILABLE(WizFi360)) {
+		/* Enable RTS and CTS flow control on module */
+		CommandAddString(WizFi360, ",8,1,0,3");
+	} else {
+		CommandAddString(WizFi360, ",8,1,0,0");
 	}
+	CommandEnd(WizFi360);
 	
 	/* Wait till command end */
 	WizFi360_WaitReady(WizFi360);
@@ -2500,39 +3132,148 @@ static WizFi360_Result_t SendUARTCommand(WizFi360_t* WizFi360, uint32_t baudrate
 		WizFi360_RETURNWITHSTATUS(WizFi360, ESP_ERROR);
 	}
 	
+	/* Set USART to new baudrate */
+	SetUSARTBaudrate(WizFi360, baudrate);
+	
+	/* Reset command */
+	WizFi360->ActiveCommand = WizFi360_COMMAND_IDLE;
+	
+	/* Return OK */
+	WizFi360_RETURNWITHSTATUS(WizFi360, ESP_OK);
+}
+
+static void SetUSARTBaudrate(WizFi360_t* WizFi360, uint32_t baudrate) {
 	/* Save baudrate */
 	WizFi360->Baudrate = baudrate;
 	
 	/* Delay a little, wait for all bytes from ESP are received before we delete them from buffer */
-	WizFi360_DELAYMS(5);
+	WizFi360_DELAYMS(WizFi360, 5);
+	
+	/* Module uses flow control from now on */
+	if (WizFi360_FLOWCONTROL_AVAILABLE(WizFi360)) {
+		WizFi360->Transport->FlowControl(WizFi360->Transport->Arg, 1);
+	}
 	
 	/* Set new UART baudrate */
-	WizFi360_LL_USARTInit(WizFi360->Baudrate);
+	WizFi360->Transport->SetBaudrate(WizFi360->Transport->Arg, WizFi360->Baudrate);
 	
 	/* Clear buffer */
-	BUFFER_Reset(&USART_Buffer);
+	ResetUSARTBuffer(WizFi360);
 	
 	/* Delay a little */
-	WizFi360_DELAYMS(5);
+	WizFi360_DELAYMS(WizFi360, 5);
+}
+
+#if WizFi360_USE_BAUDRATE_ESCALATION
+static void EscalateBaudrate(WizFi360_t* WizFi360) {
+	uint32_t good, baudrate;
+	uint8_t i, retry;
 	
-	/* Reset command */
-	WizFi360->ActiveCommand = WizFi360_COMMAND_IDLE;
+	/* Module responds immediately to all commands used here */
+	WizFi360->Timeout = WizFi360_ESCALATION_TIMEOUT;
 	
-	/* Return OK */
-	WizFi360_RETURNWITHSTATUS(WizFi360, ESP_OK);
+	/* Go through all baudrates, starting with lowest */
+	for (i = 0; i < sizeof(WizFi360_EscalationBaudrate) / sizeof(WizFi360_EscalationBaudrate[0]); i++) {
+		baudrate = WizFi360_EscalationBaudrate[i];
+		
+		/* Skip baudrates which are not higher than current */
+		if (baudrate <= WizFi360->Baudrate) {
+			continue;
+		}
+		
+		/* Save last working baudrate */
+		good = WizFi360->Baudrate;
+		
+		/* Change baudrate on module and USART, module responds with error when baudrate is not supported */
+		if (SendUARTCommand(WizFi360, baudrate, "AT+UART_CUR") != ESP_OK) {
+			break;
+		}
+		
+		/* Check communication on new baudrate */
+		if (TestBaudrate(WizFi360)) {
+			continue;
+		}
+		
+		/* Communication is not reliable, go back to last working baudrate */
+		for (retry = 0; retry < 3; retry++) {
+			/* Response may be corrupted even if module changes baudrate */
+			SendUARTCommand(WizFi360, good, "AT+UART_CUR");
+			
+			/* Use last working baudrate on USART also when response was not received */
+			if (WizFi360->Baudrate != good) {
+				SetUSARTBaudrate(WizFi360, good);
+			}
+			
+			/* Check communication */
+			if (TestBaudrate(WizFi360)) {
+				break;
+			}
+			
+			/* Module did not receive command, try again on tested baudrate */
+			SetUSARTBaudrate(WizFi360, baudrate);
+		}
+		
+		/* Higher baudrates will not work either */
+		break;
+	}
+	
+	/* Set default timeout back */
+	WizFi360->Timeout = WizFi360_TIMEOUT;
 }
 
+static uint8_t TestBaudrate(WizFi360_t* WizFi360) {
+	uint8_t i;
+	
+	/* Reset error counter */
+	if (WizFi360->Transport->Errors) {
+		WizFi360->Transport->Errors(WizFi360->Transport->Arg);
+	}
+	
+	/* Send AT commands, with echo enabled each round-trip carries data in both directions */
+	for (i = 0; i < WizFi360_ESCALATION_TESTS; i++) {
+		SendCommand(WizFi360, WizFi360_COMMAND_AT, "AT\r\n", "OK\r\n");
+		
+		/* Wait till idle */
+		WizFi360_WaitReady(WizFi360);
+		
+		/* Check response */
+		if (!WizFi360->Flags.F.LastOperationStatus) {
+			return 0;
+		}
+	}
+	
+	/* Responses may be correct despite framing or overrun errors on other bytes */
+	if (WizFi360->Transport->Errors && WizFi360->Transport->Errors(WizFi360->Transport->Arg)) {
+		return 0;
+	}
+	
+	/* Baudrate works */
+	return 1;
+}
+#endif
+
 static WizFi360_Result_t SendMACCommand(WizFi360_t* WizFi360, uint8_t* addr, char* cmd, uint8_t command) {
-	char tmp[40];
+	uint8_t i;
 	
 	/* Check idle */
 	WizFi360_CHECK_IDLE(WizFi360);
 	
-	/* Format string */
-	sprintf(tmp, "%s=\"%02x:%02x:%02x:%02x:%02x:%02x\"", cmd, addr[0], addr[1], addr[2], addr[3], addr[4], addr[5]);
+	/* Start command */
+	if (StartCommand(WizFi360, command, NULL) != ESP_OK) {
+		return WizFi360->Result;
+	}
 	
-	/* Send command */
-	SendCommand(WizFi360, command, tmp, NULL);
+	/* Send command with MAC address in format xx:xx:xx:xx:xx:xx */
+	CommandAddString(WizFi360, cmd);
+	CommandAddString(WizFi360, "=\"");
+	for (i = 0; i < 6; i++) {
+		if (i) {
+			CommandAddString(WizFi360, ":");
+		}
+		CommandAddHex(WizFi360, addr[i]);
+	}
+	CommandAddString(WizFi360, "\"");
+	CommandEnd(WizFi360);
 	
 	/* Wait ready */
 	WizFi360_WaitReady(WizFi360);
@@ -2588,6 +3329,7 @@ static void ProcessSendData(WizFi360_t* WizFi360) {
 	WizFi360_Connection_t* Connection = WizFi360->SendDataConnection;
 	/* Wrapper was found */
 	WizFi360->Flags.F.WaitForWrapper = 0;
+	WizFi360->Flags.F.WrapperReceived = 0;
 	
 	/* Go to SENDDATA command as active */
 	WizFi360->ActiveCommand = WizFi360_COMMAND_SENDDATA;
@@ -2608,14 +3350,137 @@ static void ProcessSendData(WizFi360_t* WizFi360) {
 	
 	/* If data valid */
 	if (found > 0) {
-		/* Send data */
-		WizFi360_LL_USARTSend((uint8_t *)Connection->Data, found);
+		/* Copy data to transmit buffer, shared connection buffer can be overwritten by received data while sending */
+		CommandAdd(WizFi360, Connection->Data, found, 0);
 		
 		/* Increase number of bytes sent */
 		WizFi360->TotalBytesSent += found;
 	}
 	/* Send zero at the end even if data are not valid = stop sending data to module */
-	WizFi360_LL_USARTSend((uint8_t *)"\\0", 2);
+	CommandAddString(WizFi360, "\\0");
+	CommandFlush(WizFi360);
+}
+
+static void TransmitBlocks(WizFi360_t* WizFi360, const WizFi360_LL_Block_t* Blocks, uint8_t count) {
+#if WizFi360_TXBUFFER_SIZE
+	/* Queue blocks and send them in background, function does not wait for data to be sent */
+	if (WizFi360->Transport->SendAsync) {
+		if (count && WizFi360->Transport->SendAsync(WizFi360->Transport->Arg, &WizFi360->TX_Buffer, Blocks, count)) {
+			/* Transport could not queue blocks in time, command is incomplete and module responds with error */
+			WizFi360->Stats.TransmitErrors++;
+		}
+		return;
+	}
+#endif
+	
+	/* Send blocks one after another and wait until they are sent */
+	for (; count; count--, Blocks++) {
+		WizFi360->Transport->Send(WizFi360->Transport->Arg, (const uint8_t *)Blocks->Data, Blocks->Length);
+	}
+}
+
+static void FlowControlUpdate(WizFi360_t* WizFi360) {
+	BUFFER_Size_t full;
+	
+	/* Check if transport supports flow control */
+	if (WizFi360->Transport == NULL || !WizFi360->Transport->SetRTS) {
+		return;
+	}
+	
+	/* Get number of bytes in buffer */
+	full = BUFFER_GetFull(WizFi360->USART_Buffer);
+	
+	/* Called from interrupt and from update. Update may release RTS after interrupt has set it,
+	   so RTS is set on every call above high watermark and not only when state changes */
+	if (full >= WizFi360->FlowControl_High) {
+		/* Stop module, remaining free memory must hold data module sends before it reacts */
+		WizFi360->FlowControl_Stopped = 1;
+		WizFi360->Transport->SetRTS(WizFi360->Transport->Arg, 1);
+	} else if (full <= WizFi360->FlowControl_Low && WizFi360->FlowControl_Stopped) {
+		/* Buffer was emptied, allow module to send */
+		WizFi360->FlowControl_Stopped = 0;
+		WizFi360->Transport->SetRTS(WizFi360->Transport->Arg, 0);
+	}
+}
+
+static void GetBufferStats(BUFFER_t* Buffer, WizFi360_BufferStats_t* Stats) {
+	/* Copy statistics from buffer */
+	Stats->Size = Buffer->Size;
+	Stats->Peak = Buffer->Peak;
+	Stats->Dropped = Buffer->Dropped;
+	Stats->FullCount = Buffer->FullCount;
+}
+
+static uint32_t AdviseBufferSize(uint32_t required, WizFi360_BufferStats_t* Stats, uint32_t min) {
+	uint32_t size = min;
+	
+	/* Buffer must hold at least its high watermark */
+	if (Stats->Peak > required) {
+		required = Stats->Peak;
+	}
+	
+	/* Data were lost, real demand is unknown but bigger than buffer */
+	if (Stats->Dropped && (Stats->Size * 2) > required) {
+		required = Stats->Size * 2;
+	}
+	
+	/* Add 50% headroom */
+	required += required / 2;
+	
+	/* Round up to power of 2 */
+	while (size < required && size < BUFFER_MAX_SIZE) {
+		size <<= 1;
+	}
+	
+	/* Return recommended size */
+	return size;
+}
+
+static void ProcessTokens(WizFi360_t* WizFi360) {
+	/* Get new data from transport */
+	if (WizFi360->Transport->RxUpdate) {
+		WizFi360->Transport->RxUpdate(WizFi360->Transport->Arg);
+	}
+	
+	/* Process all new characters in USART buffer */
+	BUFFER_MatcherProcess(WizFi360->USART_Buffer, &WizFi360->USART_Matcher, TokenReceived, WizFi360);
+}
+
+static void TokenReceived(void* arg, uint8_t token, BUFFER_Pos_t pos) {
+	WizFi360_t* WizFi360 = (WizFi360_t *)arg;
+	
+	/* Check token */
+	switch (token) {
+		case WizFi360_TOKEN_WRAPPER:
+			/* Wrapper is only valid when we wait for it */
+			if (WizFi360->Flags.F.WaitForWrapper) {
+				/* Remove wrapper from buffer if it is first in buffer */
+				/* When stream parser has already removed start of wrapper, it removes the rest as known line */
+				if (pos == 0) {
+					BUFFER_CommitRead(WizFi360->USART_Buffer, 2);
+				}
+				WizFi360->Flags.F.WrapperReceived = 1;
+			}
+			break;
+		case WizFi360_TOKEN_OK:
+			/* If AT+UART command was used, only check for "OK" */
+			if (
+				WizFi360->ActiveCommand == WizFi360_COMMAND_UART && /*!< Active command is UART change */
+				!WizFi360->IPD.InIPD                               /*!< We are not in IPD mode */
+			) {
+				/* Clear buffer */
+				ResetUSARTBuffer(WizFi360);
+				
+				/* We are OK here */
+				WizFi360->ActiveCommand = WizFi360_COMMAND_IDLE;
+				
+				/* Last command is OK */
+				WizFi360->Flags.F.LastOperationStatus = 1;
+			}
+			break;
+		default:
+			break;
+	}
 }
 
 /* Check if needle exists in haystack memory */
@@ -2624,8 +3489,8 @@ void* mem_mem(void* haystack, size_t haystacksize, void* needle, size_t needlesi
 	unsigned char* nptr = (unsigned char *)needle;
 	unsigned int i;
 
-	/* Go through entire memory */
-	for (i = 0; i < haystacksize; i++) {
+	/* Go through memory, needle must fit to the end of haystack */
+	for (i = 0; i + needlesize <= haystacksize; i++) {
 		if (memcmp(&hptr[i], nptr, needlesize) == 0) {
 			return &hptr[i];
 		}
@@ -135,7 +135,15 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
  *
  * Library itself is platform independent, however, USART and GPIO things must be implemented by user.
  * 
- * Please follow instructions provided in @ref WizFi360_LL page.
+ * Platform is passed to @ref WizFi360_Init as @ref WizFi360_Transport_t structure with pointers to functions,
+ * so the same library can run on microcontroller USART, on host with serial port or with simulated module.
+ * Low-level driver described in @ref WizFi360_LL page fills one for your platform.
+ *
+ * \par Multiple modules
+ *
+ * All buffers and parser state are part of @ref WizFi360_t structure, so more modules can be used at the same time,
+ * each with its own structure and transport. Transport gets structure in its Open function and passes received data to it.
+ * Structure is big (buffers are included), so declare it as global or static variable and not on small stack.
  *
  * \par Dependencies
  *
@@ -144,7 +152,6 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
  - stdio.h
  - stdint.h
  - buffer.h
- - WizFi360_ll.h
  - WizFi360_conf.h
 \endverbatim
  */
@@ -154,9 +161,6 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "stdio.h"
 #include "stdint.h"
 
-/* Low level based implementation */
-#include "WizFi360_ll.h"
-
 /* Include configuration */
 #include "WizFi360_conf.h"
 
@@ -269,6 +273,21 @@ typedef struct {
 	uint8_t USART_Buffer; /*!< Set to 1 when data are read from USART buffer or 0 if from temporary buffer */
 } WizFi360_IPD_t;
 
+/**
+ * @brief  Streaming parser state for data received from module
+ * @note   Characters are not stored, only fields parsed from known lines
+ */
+typedef struct {
+	uint8_t State;       /*!< Parser state of current line */
+	uint8_t Line;        /*!< Known line which is compared with current line */
+	uint8_t Length;      /*!< Number of characters matched to known line */
+	uint8_t Field;       /*!< Currently parsed field of +IPD header */
+	uint8_t Link;        /*!< Link ID from connection status line or +IPD header */
+	uint8_t IP[4];       /*!< Remote IP from +IPD header */
+	uint16_t Port;       /*!< Remote port from +IPD header */
+	uint32_t DataLength; /*!< Number of data bytes announced by +IPD header */
+} WizFi360_Parser_t;
+
 /**
  * @brief  Connection structure
  */
@@ -372,9 +391,77 @@ typedef struct {
 } WizFi360_Ping_t;
 
 /**
- * @brief  Main WizFi360 working structure
+ * @brief  Usage statistics for one buffer
  */
 typedef struct {
+	uint32_t Size;      /*!< Buffer size in units of bytes */
+	uint32_t Peak;      /*!< Maximal number of bytes stored in buffer at the same time */
+	uint32_t Dropped;   /*!< Number of bytes lost because buffer was full */
+	uint32_t FullCount; /*!< Number of times buffer was full when new data arrived */
+} WizFi360_BufferStats_t;
+
+/**
+ * @brief  Buffer usage statistics
+ */
+typedef struct {
+	WizFi360_BufferStats_t USART;      /*!< USART receive buffer statistics */
+	WizFi360_BufferStats_t TMP;        /*!< Temporary buffer statistics */
+	WizFi360_BufferStats_t Connection; /*!< Connection data buffer statistics. FullCount is number of +IPD packets split because buffer was full */
+	uint32_t MaxUpdateInterval;        /*!< Maximal time in milliseconds between two @ref WizFi360_Update calls */
+	uint32_t LastUpdateTime;           /*!< Time of last @ref WizFi360_Update call */
+	uint32_t TransmitErrors;           /*!< Number of background transmissions which failed, reported with @ref WizFi360_DataSent */
+} WizFi360_Stats_t;
+
+/**
+ * @brief  Block of data for transmission, command is sent to transport as list of blocks
+ */
+typedef struct {
+	const void* Data;   /*!< Pointer to block data */
+	uint16_t Length;    /*!< Block length in units of bytes */
+	uint8_t Persistent; /*!< Set to 1 when data stay valid until they are sent (constant strings, connection data).
+	                         Otherwise block must be sent or copied before transmit function returns */
+} WizFi360_LL_Block_t;
+
+/* Main working structure, declared below */
+struct _WizFi360_t;
+
+/**
+ * @brief  Transport between ESP stack and WizFi360 module, passed to @ref WizFi360_Init
+ * @note   Optional members are set to NULL when transport does not support them.
+ *         Each function gets Arg member as first parameter
+ */
+typedef struct {
+	uint8_t (*Open)(void* Arg, struct _WizFi360_t* WizFi360, uint32_t baudrate); /*!< Opens transport with baudrate, called once from @ref WizFi360_Init.
+	                                                                  Received data must be passed to WizFi360 instance from parameter. Returns 0 on success */
+	uint8_t (*Send)(void* Arg, const uint8_t* data, uint16_t count); /*!< Sends data to module and waits until they are sent. Returns 0 on success */
+	uint8_t (*SendAsync)(void* Arg, BUFFER_t* Buffer, const WizFi360_LL_Block_t* Blocks, uint8_t count); /*!< Optional, queues list of blocks and returns before they are sent.
+	                                                                  Blocks which are not persistent must be copied to Buffer first.
+	                                                                  Transport calls @ref WizFi360_DataSent when all queued data were sent. Returns 0 on success */
+	uint8_t (*SetBaudrate)(void* Arg, uint32_t baudrate);          /*!< Changes baudrate, queued data must be sent before. Returns 0 on success */
+	void (*Reset)(void* Arg, uint8_t state);                       /*!< Optional, sets reset pin. Module is in reset when state is 0 */
+	void (*Delay)(void* Arg, uint32_t ms);                         /*!< Waits for number of milliseconds */
+	uint32_t (*Now)(void* Arg);                                    /*!< Optional, returns current time in milliseconds.
+	                                                                  When NULL, time must be updated with @ref WizFi360_TimeUpdate */
+	void (*FlowControl)(void* Arg, uint8_t enable);                /*!< Optional, enables CTS flow control on next SetBaudrate call.
+	                                                                  RTS/CTS flow control on module is used when set together with SetRTS */
+	void (*SetRTS)(void* Arg, uint8_t stop);                       /*!< Optional, sets RTS line, module stops sending when stop is 1. Called also from @ref WizFi360_DataReceived */
+	uint32_t (*Errors)(void* Arg);                                 /*!< Optional, returns number of receive errors (framing, noise, overrun) since last call */
+	BUFFER_t* RxBuffer;                                           /*!< Optional buffer filled directly by transport. When NULL, received data are passed with @ref WizFi360_DataReceived */
+	void (*RxUpdate)(void* Arg);                                   /*!< Optional, updates RxBuffer before ESP stack reads from it */
+	void* Arg;                                                    /*!< User argument passed to all functions */
+} WizFi360_Transport_t;
+
+/**
+ * @brief  Command is built as list of blocks and sent without formatting to temporary string
+ */
+#define WizFi360_COMMAND_BLOCKS         12
+#define WizFi360_COMMAND_NUMBERS_SIZE   24
+
+/**
+ * @brief  Main WizFi360 working structure
+ * @note   Each instance holds its own buffers, so one MCU can drive more modules, each with its own transport
+ */
+typedef struct _WizFi360_t {
 	uint32_t Baudrate;                                        /*!< Currently used baudrate for ESP module */
 	uint32_t ActiveCommand;                                   /*!< Currently active AT command for module */
 	char ActiveCommandResponse[5][64];                        /*!< List of responses we expect with AT command */
@@ -405,6 +492,7 @@ typedef struct {
 	uint32_t TotalBytesReceived;                              /*!< Total number of bytes WizFi360 module has received from network and sent to our stack */
 	uint32_t TotalBytesSent;                                  /*!< Total number of network data bytes we have sent to WizFi360 module for transmission */
 	WizFi360_Connection_t* SendDataConnection;                 /*!< Pointer to currently active connection to sent data */
+	WizFi360_Stats_t Stats;                                    /*!< Buffer usage statistics. Use @ref WizFi360_GetBufferStats to read them */
 	union {
 		struct {
 			uint8_t STAIPIsSet:1;                             /*!< IP is set */
@@ -416,6 +504,7 @@ typedef struct {
 			uint8_t APGatewayIsSet:1;                         /*!< Gateway address is set */
 			uint8_t APMACIsSet:1;                             /*!< MAC address is set */
 			uint8_t WaitForWrapper:1;                         /*!< We are waiting for wrapper */
+			uint8_t WrapperReceived:1;                        /*!< Wrapper has been received while we were waiting for it */
 			uint8_t LastOperationStatus:1;                    /*!< Last operations status was OK */
 			uint8_t WifiConnected:1;                          /*!< Wifi is connected to network */
 			uint8_t WifiGotIP:1;                              /*!< Wifi got IP address from network */
@@ -423,6 +512,35 @@ typedef struct {
 		uint32_t Value;
 	} Flags;
 	WizFi360_Result_t Result;                                  /*!< Result status as returned from last function call. This parameter can be a value of @ref WizFi360_Result_t enumeration */
+	
+	/* Private members, used internally by stack */
+	const WizFi360_Transport_t* Transport;                     /*!< Transport to module, set on init */
+	BUFFER_t* USART_Buffer;                                   /*!< USART buffer in use, transport can fill its own buffer directly */
+#if WizFi360_USE_USARTBUFFER
+	BUFFER_t USART_BufferData;                                /*!< USART buffer when transport does not have its own */
+	uint8_t USARTBuffer[WizFi360_USARTBUFFER_SIZE];            /*!< USART buffer memory */
+#endif
+	BUFFER_t TMP_Buffer;                                      /*!< Temporary buffer */
+	uint8_t TMPBuffer[WizFi360_TMPBUFFER_SIZE];                /*!< Temporary buffer memory */
+#if WizFi360_TXBUFFER_SIZE
+	BUFFER_t TX_Buffer;                                       /*!< Transmit buffer, sent in background by transport if it supports it */
+	uint8_t TXBuffer[WizFi360_TXBUFFER_SIZE];                  /*!< Transmit buffer memory */
+#endif
+	BUFFER_Size_t FlowControl_High;                           /*!< RTS flow control high watermark in bytes */
+	BUFFER_Size_t FlowControl_Low;                            /*!< RTS flow control low watermark in bytes */
+	volatile uint8_t FlowControl_Stopped;                     /*!< Module is stopped with RTS line */
+	WizFi360_LL_Block_t Command_Blocks[WizFi360_COMMAND_BLOCKS]; /*!< Blocks of command being built */
+	uint8_t Command_Count;                                    /*!< Number of used command blocks */
+	char Command_Numbers[WizFi360_COMMAND_NUMBERS_SIZE];       /*!< Memory for numbers formatted in command */
+	uint8_t Command_NumbersLen;                               /*!< Used memory for numbers */
+	BUFFER_Matcher_t USART_Matcher;                           /*!< Token matcher for USART buffer */
+	WizFi360_Parser_t Parser;                                  /*!< Streaming parser for USART buffer */
+#if WizFi360_USE_APSEARCH
+	WizFi360_APs_t APs;                                        /*!< List of detected access points */
+#endif
+#if WizFi360_USE_SINGLE_CONNECTION_BUFFER == 1
+	char ConnectionData[WizFi360_CONNECTION_BUFFER_SIZE];      /*!< Data array shared between connections */
+#endif
 } WizFi360_t;
 
 /**
@@ -439,9 +557,11 @@ typedef struct {
  * @brief  Initializes WizFi360 module
  * @param  *WizFi360: Pointer to working @ref WizFi360_t structure
  * @param  baudrate: USART baudrate for WizFi360 module
+ * @param  *Transport: Pointer to @ref WizFi360_Transport_t structure used to communicate with module.
+ *            Structure must stay valid while stack is used, fill it with low-level driver
  * @return Member of @ref WizFi360_Result_t enumeration
  */
-WizFi360_Result_t WizFi360_Init(WizFi360_t* WizFi360, uint32_t baudrate);
+WizFi360_Result_t WizFi360_Init(WizFi360_t* WizFi360, uint32_t baudrate, const WizFi360_Transport_t* Transport);
 
 /**
  * @brief  Deinitializes WizFi360 module
@@ -475,6 +595,7 @@ WizFi360_Result_t WizFi360_Update(WizFi360_t* WizFi360);
 /**
  * @brief  Updates current time
  * @note   This function must be called periodically, best if from interrupt handler, like Systick or other timer based irq
+ * @note   Not needed when transport has Now function
  * @param  *WizFi360: Pointer to working @ref WizFi360_t structure
  * @param  time_increase: Number of milliseconds timer will be increased
  * @return None
@@ -776,11 +897,64 @@ WizFi360_Result_t WizFi360_GetConnectedStations(WizFi360_t* WizFi360);
 /**
  * @brief  Writes data from user defined USART RX interrupt handler to module stack
  * @note   This function should be called from USART RX interrupt handler to write new data
+ * @note   Not needed when transport has RxBuffer and writes data directly to it
+ * @param  *WizFi360: Pointer to working @ref WizFi360_t structure, which was passed to Open function of transport
  * @param  *ch: Pointer to data to be written to module buffer
  * @param  count: Number of data bytes to write to module buffer
  * @retval Number of bytes written to buffer
  */
-uint16_t WizFi360_DataReceived(uint8_t* ch, uint16_t count);
+uint16_t WizFi360_DataReceived(WizFi360_t* WizFi360, uint8_t* ch, uint16_t count);
+
+/**
+ * @brief  Notifies stack that USART line is idle after burst of data, written with @ref WizFi360_DataReceived
+ * @note   This function should be called from low-level interrupt handler, for example on USART idle line interrupt.
+ *         It calls @ref WizFi360_Callback_DataReceivedIdle
+ * @param  *WizFi360: Pointer to working @ref WizFi360_t structure, which was passed to Open function of transport
+ * @retval None
+ */
+void WizFi360_DataReceivedIdle(WizFi360_t* WizFi360);
+
+/**
+ * @brief  Notifies stack that all data queued with SendAsync function of transport were sent
+ * @note   This function should be called from low-level interrupt handler when transmission becomes idle.
+ *         It calls @ref WizFi360_Callback_DataSent
+ * @param  *WizFi360: Pointer to working @ref WizFi360_t structure, which was passed to Open function of transport
+ * @param  error: Set to 1 when some queued data were dropped because of transmission error, 0 otherwise
+ * @retval None
+ */
+void WizFi360_DataSent(WizFi360_t* WizFi360, uint8_t error);
+
+/**
+ * @brief  Gets buffer usage statistics for USART, temporary and connection buffers
+ * @param  *WizFi360: Pointer to working @ref WizFi360_t structure
+ * @param  *Stats: Pointer to @ref WizFi360_Stats_t structure to save statistics to
+ * @return Member of @ref WizFi360_Result_t enumeration
+ */
+WizFi360_Result_t WizFi360_GetBufferStats(WizFi360_t* WizFi360, WizFi360_Stats_t* Stats);
+
+/**
+ * @brief  Clears buffer usage statistics
+ * @note   Statistics are cleared at the end of @ref WizFi360_Init, so module startup is not included in them
+ * @param  *WizFi360: Pointer to working @ref WizFi360_t structure
+ * @return Member of @ref WizFi360_Result_t enumeration
+ */
+WizFi360_Result_t WizFi360_ResetBufferStats(WizFi360_t* WizFi360);
+
+/**
+ * @brief  Calculates recommended sizes for @ref WizFi360_USARTBUFFER_SIZE and @ref WizFi360_TMPBUFFER_SIZE
+ *
+ *         USART buffer must hold all bytes received at current baudrate during longest observed period between two 
+ *         @ref WizFi360_Update calls, and at least observed high watermark. Temporary buffer must hold its observed high watermark.
+ *         If any data were dropped, at least double of current size is recommended. 50% of headroom is added and value is 
+ *         rounded up to power of 2.
+ *
+ * @note   Run application under typical load for a while before calling this function
+ * @param  *WizFi360: Pointer to working @ref WizFi360_t structure
+ * @param  *USARTBufferSize: Pointer to save recommended USART buffer size to
+ * @param  *TMPBufferSize: Pointer to save recommended temporary buffer size to
+ * @return Member of @ref WizFi360_Result_t enumeration
+ */
+WizFi360_Result_t WizFi360_GetBufferSizeAdvice(WizFi360_t* WizFi360, uint32_t* USARTBufferSize, uint32_t* TMPBufferSize);
 
 /**
  * @}
@@ -1062,6 +1236,28 @@ void WizFi360_Callback_FirmwareUpdateError(WizFi360_t* WizFi360);
  */
 void WizFi360_Callback_ConnectedStationsDetected(WizFi360_t* WizFi360, WizFi360_ConnectedStations_t* Stations);
 
+/**
+ * @brief  Complete burst of data was received from WizFi360 module
+ * @note   This function is called from interrupt context by @ref WizFi360_DataReceivedIdle.
+ *         Use it to wake up thread which calls @ref WizFi360_Update, to process response without waiting for next poll.
+ *         Do not call any other stack function from it
+ * @param  *WizFi360: Pointer to working @ref WizFi360_t structure which received data
+ * @retval None
+ * @note   With weak parameter to prevent link errors if not defined by user
+ */
+void WizFi360_Callback_DataReceivedIdle(WizFi360_t* WizFi360);
+
+/**
+ * @brief  All data queued for background transmission have left USART
+ * @note   This function is called from interrupt context by @ref WizFi360_DataSent.
+ *         Do not call any other stack function from it
+ * @param  *WizFi360: Pointer to working @ref WizFi360_t structure which sent data
+ * @param  error: Set to 1 when some data were dropped because of transmission error
+ * @retval None
+ * @note   With weak parameter to prevent link errors if not defined by user
+ */
+void WizFi360_Callback_DataSent(WizFi360_t* WizFi360, uint8_t error);
+
 /**
  * @}
  */
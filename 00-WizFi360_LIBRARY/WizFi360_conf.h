@@ -42,22 +42,110 @@
  *          max ESP receive string size.
  *
  * @note    When possible, buffer should be at least 1024 bytes.
+ * @note    Size must be power of 2. Sizes above 32768 bytes need BUFFER_WIDE_INDEX = 1 in global compiler defines
+ * @note    Not used when transport provides its own buffer with RxBuffer member, see @ref WizFi360_USE_USARTBUFFER
  */
 #define WizFi360_USARTBUFFER_SIZE                 1024
 
+/**
+ * @brief   Enables (1) or disables (0) USART buffer in @ref WizFi360_t structure.
+ *
+ *          Set to 0 when all transports provide their own buffer with RxBuffer member
+ *          (for example STM32 driver with TM USART buffer or with WizFi360_USART_USE_DMA set to 1),
+ *          so each working structure is WizFi360_USARTBUFFER_SIZE bytes smaller.
+ *          @ref WizFi360_Init then fails when transport does not have RxBuffer.
+ *
+ * @note    Can be set in global compiler defines
+ */
+#ifndef WizFi360_USE_USARTBUFFER
+#define WizFi360_USE_USARTBUFFER                  1
+#endif
+
 /**
  * @brief   Temporary buffer size. 
  *
- *          When stack sends command, and it waits for "OK" or "ERROR" or something else and if there are data received,
- *          which are not part of this command, then all that data are stored in temporary buffer before they are processed.
+ *          When stack sends command, and it waits for "OK" or "ERROR" or something else and if there are lines received,
+ *          which are not part of this command, then their type and link ID (2 bytes per line) are stored in temporary buffer
+ *          and processed when command is finished.
  *
- *          Size of buffer depends on speed of calling @ref WizFi360_Update function, ESP baudrate and
- *          max ESP receive string size.
+ *          Size of buffer depends on speed of calling @ref WizFi360_Update function and number of
+ *          connection events during command.
  *
  * @note    When possible, buffer should be at least 512 bytes for safety reasons.
+ * @note    Size must be power of 2. Sizes above 32768 bytes need BUFFER_WIDE_INDEX = 1 in global compiler defines
  */
 #define WizFi360_TMPBUFFER_SIZE                   512
 
+/**
+ * @brief   Maximal length of command response line received from module, including string terminator.
+ *
+ *          Received data are parsed byte by byte directly from USART buffer. Known lines, connection status lines
+ *          and +IPD headers are not stored, response to active command is copied to stack once it is complete.
+ *          Longer responses are skipped. USART buffer should be at least 2 times bigger.
+ */
+#define WizFi360_LINE_SIZE                        256
+
+/**
+ * @brief   Transmit buffer size.
+ *
+ *          Formatted parts of commands are copied to this buffer and low-level driver sends them in background,
+ *          so stack does not wait for USART. Constant strings and connection data may be sent by driver directly from their memory.
+ *          When buffer is full, stack waits until there is enough free memory.
+ *
+ * @note    Used only when transport has SendAsync function. Set to 0 to save memory when it does not
+ * @note    Size must be power of 2. Sizes above 32768 bytes need BUFFER_WIDE_INDEX = 1 in global compiler defines
+ */
+#define WizFi360_TXBUFFER_SIZE                    2048
+
+/**
+ * @brief   Flow control watermarks in percent of USART buffer size.
+ *
+ *          When USART buffer is filled above high watermark, stack sets RTS line and module stops sending.
+ *          RTS line is released when buffer is emptied below low watermark.
+ *          Free memory above high watermark must hold all bytes module sends before it reacts to RTS.
+ *
+ * @note    Used only when transport has SetRTS function
+ */
+#define WizFi360_FLOWCONTROL_HIGH                 75
+#define WizFi360_FLOWCONTROL_LOW                  25
+
+/**
+ * @brief   Enables (1) or disables (0) baudrate probing in @ref WizFi360_Init.
+ *
+ *          Stack sends AT command on baudrate passed to @ref WizFi360_Init and then on predefined baudrates
+ *          and keeps first baudrate where module responds. Module is reset with AT+RST only when it does not respond on any baudrate.
+ *          When disabled, module is reset with AT+RST on each baudrate, which takes up to 1 second per baudrate.
+ */
+#define WizFi360_USE_BAUDRATE_PROBE               1
+
+/**
+ * @brief   Timeout for response on AT command when probing baudrate, in milliseconds
+ */
+#define WizFi360_PROBE_TIMEOUT                    50
+
+/**
+ * @brief   Enables (1) or disables (0) baudrate escalation at the end of @ref WizFi360_Init.
+ *
+ *          Stack steps up through @ref WizFi360_ESCALATION_BAUDRATES with AT+UART_CUR command and tests each baudrate
+ *          with @ref WizFi360_ESCALATION_TESTS AT command round-trips. When test fails or receive errors are detected,
+ *          module and USART go back to last working baudrate. Baudrate on module is not saved to flash.
+ *
+ * @note    Receive errors are checked only when transport has Errors function
+ */
+#define WizFi360_USE_BAUDRATE_ESCALATION          0
+
+/**
+ * @brief   Baudrates tried with escalation, in ascending order.
+ *          Baudrates which are not higher than baudrate passed to @ref WizFi360_Init are skipped
+ */
+#define WizFi360_ESCALATION_BAUDRATES             230400, 460800, 921600, 1500000, 2000000
+
+/**
+ * @brief   Number of AT command round-trips to test each baudrate and timeout for each response in milliseconds
+ */
+#define WizFi360_ESCALATION_TESTS                 16
+#define WizFi360_ESCALATION_TIMEOUT               100
+
 /**
  * @brief   This options allows you to specify if you will use single buffer which will be shared between
  *          all connections together. You can use this option on small embedded systems where you have limited RAM resource.
@@ -18,24 +18,797 @@
  */
 #include "WizFi360_ll.h"
 
-uint8_t WizFi360_LL_USARTInit(uint32_t baudrate) {
+#if WizFi360_USART_USE_DMA == 1
+/* DMA counter is 16-bit */
+#if WizFi360_USARTBUFFER_SIZE > 0x8000
+#error "WizFi360_USARTBUFFER_SIZE is too big for DMA reception!"
+#endif
+#endif
+
+#if WizFi360_USART_USE_DMA_TX
+#if !BUFFER_IS_POWER_OF_2(WizFi360_USART_DMA_TXBLOCKS) || WizFi360_USART_DMA_TXBLOCKS > 128
+#error "WizFi360_USART_DMA_TXBLOCKS must be power of 2 and not more than 128!"
+#endif
+#endif
+
+/* List of opened USARTs, interrupt callbacks get only USART peripheral */
+static WizFi360_LL_USART_t* WizFi360_LL_USARTs;
+
+/* Private functions */
+static WizFi360_LL_USART_t* WizFi360_LL_USARTFind(USART_TypeDef* USARTx);
+static uint8_t WizFi360_LL_USARTInit(WizFi360_LL_USART_t* USART, uint32_t baudrate);
+#if WizFi360_USART_USE_DMA || WizFi360_USART_USE_DMA_TX
+static void WizFi360_LL_DMAClockEnable(void);
+#endif
+#if WizFi360_USART_USE_DMA
+static void WizFi360_LL_USARTDMAInit(WizFi360_LL_USART_t* USART);
+#endif
+#if WizFi360_USART_USE_DMA == 1
+static void WizFi360_LL_USARTDMAUpdate(WizFi360_LL_USART_t* USART);
+static void WizFi360_LL_USARTDMAHalf(DMA_HandleTypeDef* hdma);
+#endif
+#if WizFi360_USART_USE_DMA == 2
+static void WizFi360_LL_USARTDMADeliver(WizFi360_LL_USART_t* USART);
+static void WizFi360_LL_USARTDMAEvent(DMA_HandleTypeDef* hdma);
+#endif
+#if WizFi360_USART_USE_DMA_TX
+static void WizFi360_LL_USARTDMATxInit(WizFi360_LL_USART_t* USART);
+static uint8_t WizFi360_LL_USARTDMATxFlush(WizFi360_LL_USART_t* USART);
+static uint8_t WizFi360_LL_USARTDMATxWait(WizFi360_LL_USART_t* USART);
+static void WizFi360_LL_USARTDMATxQueue(WizFi360_LL_USART_t* USART, const uint8_t* data, uint16_t length);
+static void WizFi360_LL_USARTDMATxNext(WizFi360_LL_USART_t* USART);
+static void WizFi360_LL_USARTDMATxComplete(DMA_HandleTypeDef* hdma);
+static void WizFi360_LL_USARTDMATxError(DMA_HandleTypeDef* hdma);
+#endif
+
+/* Transport functions */
+static uint8_t WizFi360_LL_TransportOpen(void* Arg, WizFi360_t* WizFi360, uint32_t baudrate);
+static uint8_t WizFi360_LL_TransportSend(void* Arg, const uint8_t* data, uint16_t count);
+#if WizFi360_USART_USE_DMA_TX
+static uint8_t WizFi360_LL_TransportSendAsync(void* Arg, BUFFER_t* Buffer, const WizFi360_LL_Block_t* Blocks, uint8_t count);
+#endif
+static uint8_t WizFi360_LL_TransportSetBaudrate(void* Arg, uint32_t baudrate);
+static void WizFi360_LL_TransportReset(void* Arg, uint8_t state);
+static void WizFi360_LL_TransportDelay(void* Arg, uint32_t ms);
+#if WizFi360_USART_USE_FLOWCONTROL
+static void WizFi360_LL_TransportFlowControl(void* Arg, uint8_t enable);
+static void WizFi360_LL_TransportSetRTS(void* Arg, uint8_t stop);
+#endif
+static uint32_t WizFi360_LL_TransportErrors(void* Arg);
+#if WizFi360_USART_USE_DMA == 1
+static void WizFi360_LL_TransportRxUpdate(void* Arg);
+#endif
+
+void WizFi360_LL_USARTDefaults(WizFi360_LL_USART_t* USART) {
+	/* Clear all members */
+	memset(USART, 0, sizeof(*USART));
+	
+	/* USART1 and pins from header */
+	USART->USART = WizFi360_USART;
+	USART->PinsPack = WizFi360_USART_PP;
+	USART->IRQ = WizFi360_USART_IRQ;
+	USART->ResetPort = WizFi360_RESET_PORT;
+	USART->ResetPin = WizFi360_RESET_PIN;
+#if WizFi360_USART_USE_DMA == 0 && !defined(TM_USART1_USE_CUSTOM_IRQ)
+	/* TM USART library stores received bytes into its own buffer which is used directly by ESP stack */
+	USART->RxBuffer = &TM_USART1;
+#endif
+#if WizFi360_USART_USE_FLOWCONTROL
+	USART->CTSPort = WizFi360_CTS_PORT;
+	USART->CTSPin = WizFi360_CTS_PIN;
+	USART->CTSAF = WizFi360_CTS_AF;
+	USART->RTSPort = WizFi360_RTS_PORT;
+	USART->RTSPin = WizFi360_RTS_PIN;
+#endif
+#if WizFi360_USART_USE_DMA
+	USART->DMA = WizFi360_USART_DMA;
+	USART->DMAIRQ = WizFi360_USART_DMA_IRQ;
+	USART->DMARequest = WizFi360_USART_DMA_REQUEST;
+#endif
+#if WizFi360_USART_USE_DMA_TX
+	USART->DMATx = WizFi360_USART_DMATX;
+	USART->DMATxIRQ = WizFi360_USART_DMATX_IRQ;
+	USART->DMATxRequest = WizFi360_USART_DMATX_REQUEST;
+#endif
+}
+
+void WizFi360_LL_TransportInit(WizFi360_LL_USART_t* USART, WizFi360_Transport_t* Transport) {
+	/* Fill transport, all functions get USART structure */
+	memset(Transport, 0, sizeof(*Transport));
+	Transport->Open = WizFi360_LL_TransportOpen;
+	Transport->Send = WizFi360_LL_TransportSend;
+#if WizFi360_USART_USE_DMA_TX
+	Transport->SendAsync = WizFi360_LL_TransportSendAsync;
+#endif
+	Transport->SetBaudrate = WizFi360_LL_TransportSetBaudrate;
+	Transport->Reset = WizFi360_LL_TransportReset;
+	Transport->Delay = WizFi360_LL_TransportDelay;
+#if WizFi360_USART_USE_FLOWCONTROL
+	Transport->FlowControl = WizFi360_LL_TransportFlowControl;
+	Transport->SetRTS = WizFi360_LL_TransportSetRTS;
+#endif
+	Transport->Errors = WizFi360_LL_TransportErrors;
+#if WizFi360_USART_USE_DMA == 1
+	/* DMA writes directly into buffer of ESP stack, buffer size is fixed */
+	BUFFER_Init(&USART->DMABuffer, WizFi360_USARTBUFFER_SIZE, USART->DMAMemory);
+	Transport->RxBuffer = &USART->DMABuffer;
+	Transport->RxUpdate = WizFi360_LL_TransportRxUpdate;
+#else
+	Transport->RxBuffer = USART->RxBuffer;
+#endif
+	Transport->Arg = USART;
+}
+
+void WizFi360_LL_USARTReceive(USART_TypeDef* USARTx, uint8_t ch) {
+	WizFi360_LL_USART_t* USART = WizFi360_LL_USARTFind(USARTx);
+	
+	/* Send received character to ESP stack */
+	if (USART) {
+		WizFi360_DataReceived(USART->WizFi360, &ch, 1);
+	}
+}
+
+/* USART receive error, called from TM USART interrupt handler */
+void TM_USART_ErrorCallback(USART_TypeDef* USARTx) {
+	WizFi360_LL_USART_t* USART = WizFi360_LL_USARTFind(USARTx);
+	
+	/* Count errors on ESP USARTs only */
+	if (USART) {
+		USART->Errors++;
+	}
+}
+
+#ifdef TM_USART1_USE_CUSTOM_IRQ
+/* USART1 receive interrupt handler */
+void TM_USART1_ReceiveHandler(uint8_t ch) {
+	/* Send received character to ESP stack */
+	WizFi360_LL_USARTReceive(USART1, ch);
+}
+#endif
+
+#if WizFi360_USART_USE_DMA || WizFi360_USART_USE_DMA_TX
+void WizFi360_LL_DMAIRQHandler(WizFi360_LL_DMA_TypeDef* DMAx) {
+	WizFi360_LL_USART_t* USART;
+	
+	/* Process DMA flags of all USARTs with this stream, calls transfer callbacks */
+	for (USART = WizFi360_LL_USARTs; USART; USART = USART->Next) {
+#if WizFi360_USART_USE_DMA
+		if (USART->DMA == DMAx) {
+			HAL_DMA_IRQHandler(&USART->DMAHandle);
+		}
+#endif
+#if WizFi360_USART_USE_DMA_TX
+		if (USART->DMATx == DMAx) {
+			HAL_DMA_IRQHandler(&USART->DMATxHandle);
+		}
+#endif
+	}
+}
+#endif
+
+#if WizFi360_USART_USE_DMA || (WizFi360_USART_USE_DMA_TX && WizFi360_USART_DMA_SHARED_IRQ)
+/* DMA interrupt handler of USART1 */
+void WizFi360_USART_DMA_IRQHandler(void) {
+#if WizFi360_USART_USE_DMA
+	WizFi360_LL_DMAIRQHandler(WizFi360_USART_DMA);
+#endif
+#if WizFi360_USART_USE_DMA_TX && WizFi360_USART_DMA_SHARED_IRQ
+	/* Transmit channel uses the same interrupt */
+	WizFi360_LL_DMAIRQHandler(WizFi360_USART_DMATX);
+#endif
+}
+#endif
+
+#if WizFi360_USART_USE_DMA_TX && !WizFi360_USART_DMA_SHARED_IRQ
+/* DMA transmit interrupt handler of USART1 */
+void WizFi360_USART_DMATX_IRQHandler(void) {
+	WizFi360_LL_DMAIRQHandler(WizFi360_USART_DMATX);
+}
+#endif
+
+#if WizFi360_USART_USE_DMA == 2
+/* USART idle line interrupt, called from TM USART interrupt handler */
+void TM_USART_IdleLineCallback(USART_TypeDef* USARTx) {
+	WizFi360_LL_USART_t* USART = WizFi360_LL_USARTFind(USARTx);
+	
+	/* Check USART */
+	if (!USART) {
+		return;
+	}
+	
+	/* Send received burst to ESP stack */
+	WizFi360_LL_USARTDMADeliver(USART);
+	
+	/* Notify stack that burst is complete */
+	WizFi360_DataReceivedIdle(USART->WizFi360);
+}
+#endif
+
+/******************************************/
+/*          TRANSPORT FOR ESP STACK       */
+/******************************************/
+static uint8_t WizFi360_LL_TransportOpen(void* Arg, WizFi360_t* WizFi360, uint32_t baudrate) {
+	WizFi360_LL_USART_t* USART = (WizFi360_LL_USART_t *)Arg;
+	
+	/* Save stack instance, USART is bound to it */
+	USART->WizFi360 = WizFi360;
+	
+	/* Add USART to list for interrupts, if not already there */
+	if (!WizFi360_LL_USARTFind(USART->USART)) {
+		USART->Next = WizFi360_LL_USARTs;
+		WizFi360_LL_USARTs = USART;
+	}
+	
+	/* Init reset pin */
+	if (USART->ResetPort) {
+		TM_GPIO_Init(USART->ResetPort, USART->ResetPin, TM_GPIO_Mode_OUT, TM_GPIO_OType_PP, TM_GPIO_PuPd_UP, TM_GPIO_Speed_Low);
+	}
+	
 	/* Init USART */
-	TM_USART_Init(WizFi360_USART, WizFi360_USART_PP, baudrate);
+	return WizFi360_LL_USARTInit(USART, baudrate);
+}
+
+static uint8_t WizFi360_LL_TransportSend(void* Arg, const uint8_t* data, uint16_t count) {
+	WizFi360_LL_USART_t* USART = (WizFi360_LL_USART_t *)Arg;
+	
+	/* Send data via USART */
+	TM_USART_Send(USART->USART, (uint8_t *)data, count);
 	
 	/* Return 0 = Successful */
 	return 0;
 }
 
-uint8_t WizFi360_LL_USARTSend(uint8_t* data, uint16_t count) {
-	/* Send data via USART */
-	TM_USART_Send(WizFi360_USART, data, count);
+#if WizFi360_USART_USE_DMA_TX
+static uint8_t WizFi360_LL_TransportSendAsync(void* Arg, BUFFER_t* Buffer, const WizFi360_LL_Block_t* Blocks, uint8_t count) {
+	WizFi360_LL_USART_t* USART = (WizFi360_LL_USART_t *)Arg;
+	const uint8_t* data;
+	uint16_t length, len;
+	uint32_t start;
+	
+	/* Save buffer */
+	USART->TxBuffer = Buffer;
+	
+	/* Go through all blocks */
+	for (; count; count--, Blocks++) {
+		data = (const uint8_t *)Blocks->Data;
+		length = Blocks->Length;
+	
+		/* Persistent block is sent directly from its memory */
+		if (Blocks->Persistent && length >= WizFi360_USART_DMA_TXMINREF) {
+			if (WizFi360_LL_USARTDMATxWait(USART)) {
+				return 1;
+			}
+			WizFi360_LL_USARTDMATxQueue(USART, data, length);
+			continue;
+		}
+		
+		/* Copy block to buffer, wait for free memory if block is larger */
+		start = HAL_GetTick();
+		while (length) {
+			/* Get free memory */
+			len = BUFFER_GetFree(Buffer);
+			if (len > length) {
+				len = length;
+			}
+			
+			/* Write data and queue them, queue entry is reserved first so data in buffer always belong to queued block */
+			if (len) {
+				if (WizFi360_LL_USARTDMATxWait(USART)) {
+					return 1;
+				}
+				BUFFER_Write(Buffer, (uint8_t *)data, len);
+				WizFi360_LL_USARTDMATxQueue(USART, NULL, len);
+				data += len;
+				length -= len;
+				start = HAL_GetTick();
+			} else if ((HAL_GetTick() - start) > WizFi360_USART_DMA_TXTIMEOUT) {
+				/* Transmission does not free memory, rest of command is not sent */
+				return 1;
+			}
+		}
+	}
 	
 	/* Return 0 = Successful */
 	return 0;
 }
+#endif
 
-/* USART receive interrupt handler */
-void TM_USART1_ReceiveHandler(uint8_t ch) {
-	/* Send received character to ESP stack */
-	WizFi360_DataReceived(&ch, 1);
+static uint8_t WizFi360_LL_TransportSetBaudrate(void* Arg, uint32_t baudrate) {
+	/* Reinit USART */
+	return WizFi360_LL_USARTInit((WizFi360_LL_USART_t *)Arg, baudrate);
+}
+
+static void WizFi360_LL_TransportReset(void* Arg, uint8_t state) {
+	WizFi360_LL_USART_t* USART = (WizFi360_LL_USART_t *)Arg;
+	
+	/* Set reset pin */
+	if (USART->ResetPort) {
+		TM_GPIO_SetPinValue(USART->ResetPort, USART->ResetPin, state);
+	}
+}
+
+static void WizFi360_LL_TransportDelay(void* Arg, uint32_t ms) {
+	/* Delay for amount of milliseconds */
+	WizFi360_DELAYMS(ms);
+}
+
+#if WizFi360_USART_USE_FLOWCONTROL
+static void WizFi360_LL_TransportFlowControl(void* Arg, uint8_t enable) {
+	/* Save setting, used on next USART init */
+	((WizFi360_LL_USART_t *)Arg)->FlowControl = enable;
+}
+
+static void WizFi360_LL_TransportSetRTS(void* Arg, uint8_t stop) {
+	WizFi360_LL_USART_t* USART = (WizFi360_LL_USART_t *)Arg;
+	
+	/* Set RTS line, module stops sending when pin is high */
+	TM_GPIO_SetPinValue(USART->RTSPort, USART->RTSPin, stop);
+}
+#endif
+
+static uint32_t WizFi360_LL_TransportErrors(void* Arg) {
+	WizFi360_LL_USART_t* USART = (WizFi360_LL_USART_t *)Arg;
+	uint32_t errors;
+	
+	/* Read and reset counter, USART interrupt must not change it at the same time */
+	NVIC_DisableIRQ(USART->IRQ);
+	errors = USART->Errors;
+	USART->Errors = 0;
+	NVIC_EnableIRQ(USART->IRQ);
+	
+	/* Return number of errors */
+	return errors;
+}
+
+#if WizFi360_USART_USE_DMA == 1
+static void WizFi360_LL_TransportRxUpdate(void* Arg) {
+	/* Update buffer before it is read */
+	WizFi360_LL_USARTDMAUpdate((WizFi360_LL_USART_t *)Arg);
+}
+#endif
+
+/******************************************/
+/*           PRIVATE FUNCTIONS            */
+/******************************************/
+static WizFi360_LL_USART_t* WizFi360_LL_USARTFind(USART_TypeDef* USARTx) {
+	WizFi360_LL_USART_t* USART;
+	
+	/* Find opened USART */
+	for (USART = WizFi360_LL_USARTs; USART; USART = USART->Next) {
+		if (USART->USART == USARTx) {
+			break;
+		}
+	}
+	
+	/* Return USART or NULL */
+	return USART;
+}
+
+static uint8_t WizFi360_LL_USARTInit(WizFi360_LL_USART_t* USART, uint32_t baudrate) {
+	uint8_t result = 0;
+	
+#if WizFi360_USART_USE_DMA_TX
+	/* Send queued data with current baudrate, USART is reinitialized even when they were dropped */
+	result = WizFi360_LL_USARTDMATxFlush(USART);
+#endif
+	
+#if WizFi360_USART_USE_FLOWCONTROL
+	/* RTS is normal output, low level allows module to send data */
+	TM_GPIO_Init(USART->RTSPort, USART->RTSPin, TM_GPIO_Mode_OUT, TM_GPIO_OType_PP, TM_GPIO_PuPd_NOPULL, TM_GPIO_Speed_Medium);
+	
+	/* Init USART with hardware CTS, USART does not send when module is not ready */
+	if (USART->FlowControl) {
+		TM_GPIO_InitAlternate(USART->CTSPort, USART->CTSPin, TM_GPIO_OType_PP, TM_GPIO_PuPd_UP, TM_GPIO_Speed_High, USART->CTSAF);
+		TM_USART_InitWithFlowControl(USART->USART, USART->PinsPack, baudrate, TM_USART_HardwareFlowControl_CTS);
+	} else {
+		TM_USART_Init(USART->USART, USART->PinsPack, baudrate);
+	}
+#else
+	/* Init USART */
+	TM_USART_Init(USART->USART, USART->PinsPack, baudrate);
+#endif
+	
+#if WizFi360_USART_USE_DMA
+	/* Start DMA reception, USART was reinitialized */
+	WizFi360_LL_USARTDMAInit(USART);
+#endif
+#if WizFi360_USART_USE_DMA_TX
+	/* Prepare DMA transmission */
+	WizFi360_LL_USARTDMATxInit(USART);
+#endif
+	
+	/* Return 0 = Successful, 1 when queued data were dropped */
+	return result;
+}
+
+#if WizFi360_USART_USE_DMA || WizFi360_USART_USE_DMA_TX
+static void WizFi360_LL_DMAClockEnable(void) {
+	/* USART can use any DMA controller */
+	__HAL_RCC_DMA1_CLK_ENABLE();
+#if defined(DMA2)
+	__HAL_RCC_DMA2_CLK_ENABLE();
+#endif
+}
+#endif
+
+#if WizFi360_USART_USE_DMA
+static void WizFi360_LL_USARTDMAInit(WizFi360_LL_USART_t* USART) {
+	uint8_t* Memory;
+	uint16_t Size;
+	
+	/* Stop previous transfer */
+	if (USART->DMAHandle.Instance) {
+		HAL_DMA_Abort(&USART->DMAHandle);
+		HAL_DMA_DeInit(&USART->DMAHandle);
+	}
+	
+	/* Received data are not processed by interrupt */
+	USART->USART->CR1 &= ~USART_CR1_RXNEIE;
+	
+#if WizFi360_USART_USE_DMA == 1
+	/* Empty buffer, indexes only move forward to beginning of memory where DMA starts */
+	USART->DMABuffer.In = (BUFFER_Size_t)(USART->DMABuffer.In + WizFi360_USARTBUFFER_SIZE - 1) & ~(BUFFER_Size_t)(WizFi360_USARTBUFFER_SIZE - 1);
+	USART->DMABuffer.Out = USART->DMABuffer.In;
+	USART->DMABuffer.Scan = USART->DMABuffer.In;
+	USART->DMAHalves = 0;
+	USART->DMAWritten = 0;
+	Memory = USART->DMAMemory;
+	Size = WizFi360_USARTBUFFER_SIZE;
+#else
+	/* Start delivery at the beginning of memory */
+	USART->DMAPos = 0;
+	Memory = USART->DMAMemory;
+	Size = WizFi360_USART_DMA_SIZE;
+#endif
+	
+	/* Enable DMA clock */
+	WizFi360_LL_DMAClockEnable();
+	
+#if defined(__HAL_DMA1_REMAP)
+	/* Select USART RX request on channel */
+	if (USART->DMARequest) {
+		__HAL_DMA1_REMAP(USART->DMARequest);
+	}
+#endif
+	
+	/* Set DMA settings, circular mode */
+	USART->DMAHandle.Instance = USART->DMA;
+#if !defined(STM32F0xx)
+	USART->DMAHandle.Init.Channel = USART->DMARequest;
+	USART->DMAHandle.Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+	USART->DMAHandle.Init.FIFOThreshold = DMA_FIFO_THRESHOLD_FULL;
+	USART->DMAHandle.Init.MemBurst = DMA_MBURST_SINGLE;
+	USART->DMAHandle.Init.PeriphBurst = DMA_PBURST_SINGLE;
+#endif
+	USART->DMAHandle.Init.Direction = DMA_PERIPH_TO_MEMORY;
+	USART->DMAHandle.Init.PeriphInc = DMA_PINC_DISABLE;
+	USART->DMAHandle.Init.MemInc = DMA_MINC_ENABLE;
+	USART->DMAHandle.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+	USART->DMAHandle.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+	USART->DMAHandle.Init.Mode = DMA_CIRCULAR;
+	USART->DMAHandle.Init.Priority = DMA_PRIORITY_HIGH;
+	HAL_DMA_Init(&USART->DMAHandle);
+	USART->DMAHandle.Parent = USART;
+	
+#if WizFi360_USART_USE_DMA == 1
+	/* Half and full transfer events only count written halves of memory, data are not touched in interrupt */
+	USART->DMAHandle.XferHalfCpltCallback = WizFi360_LL_USARTDMAHalf;
+	USART->DMAHandle.XferCpltCallback = WizFi360_LL_USARTDMAHalf;
+#else
+	/* Half and full transfer events deliver data when burst is longer than half of memory */
+	USART->DMAHandle.XferHalfCpltCallback = WizFi360_LL_USARTDMAEvent;
+	USART->DMAHandle.XferCpltCallback = WizFi360_LL_USARTDMAEvent;
+#endif
+	
+	/* DMA interrupt must not preempt USART interrupt and vice versa */
+	NVIC_SetPriority(USART->DMAIRQ, NVIC_GetPriority(USART->IRQ));
+	NVIC_EnableIRQ(USART->DMAIRQ);
+	
+	/* Start transfer from USART data register to DMA memory */
+	HAL_DMA_Start_IT(&USART->DMAHandle, (uint32_t)&USART->USART->WizFi360_USART_RX_REGISTER, (uint32_t)Memory, Size);
+	
+#if WizFi360_USART_USE_DMA == 2
+	/* Enable idle line interrupt, handled in TM USART interrupt handler */
+	USART->USART->CR1 |= USART_CR1_IDLEIE;
+#endif
+	
+	/* Enable DMA requests on USART RX, errors generate USART interrupt as there is no receive interrupt */
+	USART->USART->CR3 |= USART_CR3_DMAR | USART_CR3_EIE;
+}
+#endif
+
+#if WizFi360_USART_USE_DMA == 1
+static void WizFi360_LL_USARTDMAUpdate(WizFi360_LL_USART_t* USART) {
+	BUFFER_t* Buffer = &USART->DMABuffer;
+	BUFFER_Size_t in, pos, full, half;
+	uint32_t halves, written, count;
+	
+#if defined(USART_ICR_ORECF)
+	/* Overrun stops reception on this family, clear it */
+	if (USART->USART->ISR & USART_ISR_ORE) {
+		USART->USART->ICR = USART_ICR_ORECF;
+	}
+#endif
+	
+	/* Read number of written halves before position, event of half DMA has just finished may not be counted yet */
+	halves = USART->DMAHalves;
+	half = Buffer->Size / 2;
+	
+	/* Get position in memory where DMA will write next byte */
+	pos = (BUFFER_Size_t)(Buffer->Size - USART->DMA->WizFi360_USART_DMA_COUNTER) & (Buffer->Size - 1);
+	
+	/* After even number of halves DMA writes to first half of memory, otherwise event is still pending */
+	if ((halves ^ (pos >= half)) & 1) {
+		halves++;
+	}
+	
+	/* Get number of bytes DMA has written since last update, DMA position alone repeats after each lap */
+	written = halves * half + (pos & (half - 1));
+	count = written - USART->DMAWritten;
+	USART->DMAWritten = written;
+	
+	/* DMA does not know free space, bytes written over unread data are lost */
+	full = (BUFFER_Size_t)(Buffer->In - Buffer->Out);
+	if (count > (uint32_t)(Buffer->Size - full)) {
+		Buffer->Dropped += count - (Buffer->Size - full);
+		Buffer->FullCount++;
+	}
+	
+	/* Move free-running input index by written bytes */
+	in = (BUFFER_Size_t)(Buffer->In + count);
+	
+	/* Only last buffer size of bytes are in memory, skip overwritten data */
+	full = (BUFFER_Size_t)(in - Buffer->Out);
+	if (full > Buffer->Size) {
+		Buffer->Out = (BUFFER_Size_t)(in - Buffer->Size);
+		if ((BUFFER_Pos_t)(Buffer->Out - Buffer->Scan) > 0) {
+			Buffer->Scan = Buffer->Out;
+		}
+		full = Buffer->Size;
+	}
+	
+	/* Update high watermark */
+	if (full > Buffer->Peak) {
+		Buffer->Peak = full;
+	}
+	
+	/* DMA data must be visible before new index */
+	BUFFER_MEMORY_BARRIER();
+	Buffer->In = in;
+}
+
+static void WizFi360_LL_USARTDMAHalf(DMA_HandleTypeDef* hdma) {
+	/* DMA has written next half of memory */
+	((WizFi360_LL_USART_t *)hdma->Parent)->DMAHalves++;
+}
+#endif
+
+#if WizFi360_USART_USE_DMA == 2
+static void WizFi360_LL_USARTDMADeliver(WizFi360_LL_USART_t* USART) {
+	uint16_t pos;
+	
+	/* Get position in memory where DMA will write next byte */
+	pos = WizFi360_USART_DMA_SIZE - USART->DMA->WizFi360_USART_DMA_COUNTER;
+	if (pos >= WizFi360_USART_DMA_SIZE) {
+		pos = 0;
+	}
+	
+	/* Check for new data */
+	if (pos == USART->DMAPos) {
+		return;
+	}
+	
+	/* Send data to ESP stack in one or two linear blocks */
+	if (pos > USART->DMAPos) {
+		WizFi360_DataReceived(USART->WizFi360, &USART->DMAMemory[USART->DMAPos], pos - USART->DMAPos);
+	} else {
+		WizFi360_DataReceived(USART->WizFi360, &USART->DMAMemory[USART->DMAPos], WizFi360_USART_DMA_SIZE - USART->DMAPos);
+		if (pos) {
+			WizFi360_DataReceived(USART->WizFi360, &USART->DMAMemory[0], pos);
+		}
+	}
+	
+	/* Save new position */
+	USART->DMAPos = pos;
+}
+
+static void WizFi360_LL_USARTDMAEvent(DMA_HandleTypeDef* hdma) {
+	/* Send received data to ESP stack */
+	WizFi360_LL_USARTDMADeliver((WizFi360_LL_USART_t *)hdma->Parent);
+}
+#endif
+
+#if WizFi360_USART_USE_DMA_TX
+static void WizFi360_LL_USARTDMATxInit(WizFi360_LL_USART_t* USART) {
+	/* Stop previous transfer, all data were already sent */
+	if (USART->DMATxHandle.Instance) {
+		HAL_DMA_Abort(&USART->DMATxHandle);
+		HAL_DMA_DeInit(&USART->DMATxHandle);
+	}
+	
+	/* Enable DMA clock */
+	WizFi360_LL_DMAClockEnable();
+	
+#if defined(__HAL_DMA1_REMAP)
+	/* Select USART TX request on channel */
+	if (USART->DMATxRequest) {
+		__HAL_DMA1_REMAP(USART->DMATxRequest);
+	}
+#endif
+	
+	/* Set DMA settings, normal mode, one linear block of buffer at a time */
+	USART->DMATxHandle.Instance = USART->DMATx;
+#if !defined(STM32F0xx)
+	USART->DMATxHandle.Init.Channel = USART->DMATxRequest;
+	USART->DMATxHandle.Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+	USART->DMATxHandle.Init.FIFOThreshold = DMA_FIFO_THRESHOLD_FULL;
+	USART->DMATxHandle.Init.MemBurst = DMA_MBURST_SINGLE;
+	USART->DMATxHandle.Init.PeriphBurst = DMA_PBURST_SINGLE;
+#endif
+	USART->DMATxHandle.Init.Direction = DMA_MEMORY_TO_PERIPH;
+	USART->DMATxHandle.Init.PeriphInc = DMA_PINC_DISABLE;
+	USART->DMATxHandle.Init.MemInc = DMA_MINC_ENABLE;
+	USART->DMATxHandle.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+	USART->DMATxHandle.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+	USART->DMATxHandle.Init.Mode = DMA_NORMAL;
+	USART->DMATxHandle.Init.Priority = DMA_PRIORITY_MEDIUM;
+	HAL_DMA_Init(&USART->DMATxHandle);
+	USART->DMATxHandle.Parent = USART;
+	USART->DMATxHandle.XferCpltCallback = WizFi360_LL_USARTDMATxComplete;
+	USART->DMATxHandle.XferErrorCallback = WizFi360_LL_USARTDMATxError;
+	
+	/* DMA interrupt must not preempt USART interrupt and vice versa */
+	NVIC_SetPriority(USART->DMATxIRQ, NVIC_GetPriority(USART->IRQ));
+	NVIC_EnableIRQ(USART->DMATxIRQ);
+	
+	/* Enable DMA requests on USART TX */
+	USART->USART->CR3 |= USART_CR3_DMAT;
+}
+
+static uint8_t WizFi360_LL_USARTDMATxFlush(WizFi360_LL_USART_t* USART) {
+	uint32_t start = HAL_GetTick();
+	
+	/* Nothing was sent yet */
+	if (!USART->DMATxHandle.Instance) {
+		return 0;
+	}
+	
+	/* Wait until all queued data are sent and last byte left USART */
+	while (USART->TxCount || !(USART->USART->USART_STATUS_REG & USART_FLAG_TC)) {
+		if ((HAL_GetTick() - start) > WizFi360_USART_DMA_TXTIMEOUT) {
+			/* Transmission is stuck, drop queued data, DMA is stopped on init */
+			NVIC_DisableIRQ(USART->DMATxIRQ);
+			HAL_DMA_Abort(&USART->DMATxHandle);
+			USART->TxOut = USART->TxIn;
+			USART->TxCount = 0;
+			if (USART->TxBuffer) {
+				BUFFER_Reset(USART->TxBuffer);
+			}
+			NVIC_EnableIRQ(USART->DMATxIRQ);
+			
+			/* Report dropped data */
+			WizFi360_DataSent(USART->WizFi360, 1);
+			return 1;
+		}
+	}
+	
+	/* Return 0 = Successful */
+	return 0;
+}
+
+static uint8_t WizFi360_LL_USARTDMATxWait(WizFi360_LL_USART_t* USART) {
+	uint32_t start = HAL_GetTick();
+	
+	/* Wait for free entry in queue, only completion interrupt removes entries */
+	while ((uint8_t)(USART->TxIn - USART->TxOut) >= WizFi360_USART_DMA_TXBLOCKS) {
+		if ((HAL_GetTick() - start) > WizFi360_USART_DMA_TXTIMEOUT) {
+			return 1;
+		}
+	}
+	
+	/* Return 0 = Successful */
+	return 0;
+}
+
+static void WizFi360_LL_USARTDMATxQueue(WizFi360_LL_USART_t* USART, const uint8_t* data, uint16_t length) {
+	WizFi360_LL_TxBlock_t* last;
+	
+	/* Nothing to send */
+	if (!length) {
+		return;
+	}
+	
+	/* Completion interrupt must not change queue at the same time */
+	NVIC_DisableIRQ(USART->DMATxIRQ);
+	
+	/* Data in buffer are appended to last queued block if it is in buffer too */
+	last = &USART->TxBlocks[(uint8_t)(USART->TxIn - 1) & (WizFi360_USART_DMA_TXBLOCKS - 1)];
+	if (!data && USART->TxIn != USART->TxOut && !last->Data && last->Length <= (uint16_t)(0xFFFF - length)) {
+		last->Length += length;
+	} else {
+		USART->TxBlocks[USART->TxIn & (WizFi360_USART_DMA_TXBLOCKS - 1)].Data = data;
+		USART->TxBlocks[USART->TxIn & (WizFi360_USART_DMA_TXBLOCKS - 1)].Length = length;
+		USART->TxIn++;
+	}
+	
+	/* Start transfer if not running */
+	if (!USART->TxCount) {
+		WizFi360_LL_USARTDMATxNext(USART);
+	}
+	NVIC_EnableIRQ(USART->DMATxIRQ);
+}
+
+static void WizFi360_LL_USARTDMATxNext(WizFi360_LL_USART_t* USART) {
+	WizFi360_LL_TxBlock_t* block;
+	uint8_t* data;
+	uint8_t error;
+	
+	/* Check for queued blocks */
+	if (USART->TxIn == USART->TxOut) {
+		USART->TxCount = 0;
+		
+		/* All queued data were sent, notify stack */
+		error = USART->TxError;
+		USART->TxError = 0;
+		WizFi360_DataSent(USART->WizFi360, error);
+		return;
+	}
+	block = &USART->TxBlocks[USART->TxOut & (WizFi360_USART_DMA_TXBLOCKS - 1)];
+	
+	/* Get linear memory to send */
+	if (block->Data) {
+		data = (uint8_t *)block->Data;
+		USART->TxCount = block->Length;
+	} else {
+		USART->TxCount = BUFFER_PeekRead(USART->TxBuffer, &data);
+		if (USART->TxCount > block->Length) {
+			USART->TxCount = block->Length;
+		}
+	}
+	
+	/* Start transfer directly from block memory */
+	HAL_DMA_Start_IT(&USART->DMATxHandle, (uint32_t)data, (uint32_t)&USART->USART->WizFi360_USART_TX_REGISTER, USART->TxCount);
+}
+
+static void WizFi360_LL_USARTDMATxComplete(DMA_HandleTypeDef* hdma) {
+	WizFi360_LL_USART_t* USART = (WizFi360_LL_USART_t *)hdma->Parent;
+	WizFi360_LL_TxBlock_t* block = &USART->TxBlocks[USART->TxOut & (WizFi360_USART_DMA_TXBLOCKS - 1)];
+	
+	/* Data were sent, remove them from block */
+	if (block->Data) {
+		block->Data += USART->TxCount;
+	} else {
+		BUFFER_CommitRead(USART->TxBuffer, USART->TxCount);
+	}
+	block->Length -= USART->TxCount;
+	
+	/* Go to next block when this one is done */
+	if (!block->Length) {
+		USART->TxOut++;
+	}
+	
+	/* Continue with next data */
+	WizFi360_LL_USARTDMATxNext(USART);
+}
+
+static void WizFi360_LL_USARTDMATxError(DMA_HandleTypeDef* hdma) {
+	WizFi360_LL_USART_t* USART = (WizFi360_LL_USART_t *)hdma->Parent;
+	WizFi360_LL_TxBlock_t* block = &USART->TxBlocks[USART->TxOut & (WizFi360_USART_DMA_TXBLOCKS - 1)];
+	
+	/* Only transfer error stops DMA, transfer continues after other errors */
+	if (!(hdma->ErrorCode & HAL_DMA_ERROR_TE)) {
+		return;
+	}
+	
+	/* Drop block, also its data in buffer, it is not known how much of it was sent */
+	if (!block->Data) {
+		BUFFER_CommitRead(USART->TxBuffer, block->Length);
+	}
+	block->Length = 0;
+	USART->TxOut++;
+	USART->TxError = 1;
+	
+	/* Continue with next data */
+	WizFi360_LL_USARTDMATxNext(USART);
 }
+#endif
@@ -28,7 +28,7 @@
 \endverbatim
  */
 #ifndef WizFi360_LL_H
-#define WizFi360_LL_H 100
+#define WizFi360_LL_H 210
 
 /* C++ detection */
 #ifdef __cplusplus
@@ -44,26 +44,102 @@ extern "C" {
  *
  * It provides communication between ESP module and platform. There are some function, which needs to be implemented by user and with care.
  *
+ * \par Transport
+ *
+ * ESP stack does not call low-level functions directly. They are collected in structure
+ * of type @ref WizFi360_Transport_t, which is passed to @ref WizFi360_Init.
+ * State of each USART (peripheral, pins, DMA streams, buffers) is stored in @ref WizFi360_LL_USART_t structure,
+ * which is passed to transport functions as their argument, so one transport is filled per USART:
+ *
+\verbatim
+WizFi360_LL_USART_t WizFi360_USART1;
+WizFi360_Transport_t WizFi360_Transport;
+
+WizFi360_LL_USARTDefaults(&WizFi360_USART1);
+WizFi360_LL_TransportInit(&WizFi360_USART1, &WizFi360_Transport);
+WizFi360_Init(&WizFi360, 115200, &WizFi360_Transport);
+\endverbatim
+ *
+ * @ref WizFi360_LL_USARTDefaults sets USART1 configuration from this file. For another module, change
+ * configuration members of second structure (USART, pins pack, reset pin, DMA streams) before transport is filled.
+ * Other platforms (serial port on host, simulated module) can pass their own transport structure to the same ESP stack.
+ *
  * \par U(S)ART configuration
  *
- * WizFi360 module works with U(S)ART communication with device. For this purpose, library supposes 2, USART based, functions, which are called from ESP module stack when needed:
+ * WizFi360 module works with U(S)ART communication with device. For this purpose, transport has 2, USART based, functions, which are called from ESP module stack when needed:
  *
- * - \ref WizFi360_LL_USARTInit: Function, which is called when USART should be initialized
- * - \ref WizFi360_LL_USARTSend: Function, which is called when data should be sent to WizFi360 device
+ * - Open and SetBaudrate: Functions, which are called when USART should be initialized
+ * - Send: Function, which is called when data should be sent to WizFi360 device
  *
  * ESP stack module does not check for any incoming data from WizFi360 module to USART of your device.
  *
  * Most microcontrollers have USART RX capability, so when USART RX interrupt happens,
  * you should send this received byte to WizFi360 module using @ref WizFi360_DataReceived function to notify new incoming data.
  * Use interrupt handler routing to notify new data using previous mentioned function.
+ * On STM32 with TM_USART1_USE_CUSTOM_IRQ defined, call @ref WizFi360_LL_USARTReceive from TM_USARTx_ReceiveHandler
+ * of each other USART used for module (USART1 handler is implemented in driver).
+ *
+ * When U(S)ART driver already stores received bytes into @ref BUFFER_t structure, set RxBuffer member of transport
+ * (RxBuffer member of @ref WizFi360_LL_USART_t on STM32) to point to it. ESP stack then parses data directly from driver's buffer and there is no second buffer and no extra function call per byte.
+ * When all modules use such transport (default STM32 settings or WizFi360_USART_USE_DMA set to 1),
+ * define WizFi360_USE_USARTBUFFER to 0 in global compiler defines to remove unused USART buffer from @ref WizFi360_t.
+ *
+ * \par DMA reception
+ *
+ * For high baudrates (2-3 Mbaud) set WizFi360_USART_USE_DMA to 1 in defines.h file.
+ * USART RX interrupt is then disabled and DMA writes received data in circular mode directly into ESP stack buffer.
+ * There is no interrupt in data path, input index of buffer is calculated from DMA counter each time ESP stack reads data.
+ * DMA half and full transfer interrupts only count written halves of memory, so complete laps of DMA are not missed.
+ *
+ * With WizFi360_USART_USE_DMA set to 2, DMA writes data into small circular memory of WizFi360_USART_DMA_SIZE bytes.
+ * Data are delivered to ESP stack with @ref WizFi360_DataReceived when USART line becomes idle after burst of data
+ * and on DMA half and full transfer events, so response like "OK\r\n" costs one notification instead of one per byte.
+ * @ref WizFi360_DataReceivedIdle is then called to notify application that complete burst was received.
+ *
+ * @note  DMA has no information about free space in buffer. @ref WizFi360_Update must be called often enough
+ *        to process data before DMA writes WizFi360_USARTBUFFER_SIZE new bytes, otherwise old data are overwritten.
+ *        Overwritten bytes are skipped and counted in Dropped and FullCount statistics of USART buffer,
+ *        use @ref WizFi360_GetBufferSizeAdvice to check it
+ * @note  On STM32F7xx with data cache enabled, DMA memory must be placed in non-cacheable region (configure MPU)
  * 
+ * \par Asynchronous transmission
+ *
+ * ESP stack does not format commands into temporary strings. Each command is a list of @ref WizFi360_LL_Block_t blocks
+ * (command prefix, escaped arguments, numbers, connection data and CRLF trailer) which are sent back to back.
+ *
+ * By default, Send function of transport is called for each block and returns when block is sent.
+ * When transport has SendAsync function, ESP stack passes complete list of blocks to driver
+ * together with its transmit buffer (WizFi360_TXBUFFER_SIZE). Driver copies blocks which are not persistent to buffer,
+ * references persistent blocks (constant strings, connection data) directly and sends everything in background
+ * (with DMA or TX interrupt), so sending commands does not block.
+ *
+ * Set WizFi360_USART_USE_DMA_TX to 1 in defines.h file to use DMA transmission on STM32.
+ * DMA sends blocks from queue of WizFi360_USART_DMA_TXBLOCKS entries, one transfer per linear block of memory.
+ * When queue becomes empty, @ref WizFi360_DataSent is called from DMA interrupt.
+ * Block is dropped on DMA transfer error. Waits for free queue entry, transmit buffer memory and end of transmission
+ * are limited to WizFi360_USART_DMA_TXTIMEOUT milliseconds. Errors are reported with @ref WizFi360_DataSent.
+ *
+ * Driver implements DMA interrupt handlers of USART1 streams. When other USART uses DMA reception
+ * or transmission, call @ref WizFi360_LL_DMAIRQHandler from interrupt handlers of its streams.
+ *
+ * \par Hardware flow control
+ *
+ * When transport has FlowControl and SetRTS functions,
+ * ESP stack enables RTS/CTS flow control on WizFi360 module during @ref WizFi360_Init and on every baudrate change.
+ * Module stops sending when RTS line is set high. ESP stack sets it when USART buffer is filled above
+ * WizFi360_FLOWCONTROL_HIGH percent and releases it when buffer is emptied below WizFi360_FLOWCONTROL_LOW percent,
+ * so bytes are not lost under bursty load even at maximal baudrate. CTS line is handled by USART hardware.
+ *
+ * Set WizFi360_USART_USE_FLOWCONTROL to 1 in defines.h file to use flow control on STM32 (CTS on PA11, RTS on PA12).
+ * Buffer is checked each time data are delivered with @ref WizFi360_DataReceived, so define TM_USART1_USE_CUSTOM_IRQ
+ * or set WizFi360_USART_USE_DMA to 2.
+ *
  * \par Reset configuration
  *
  * WizFi360 module can be reset using AT commands. However, it may happen that ESP module ignores AT commands for some reasons.
  *
- * You need to implement 3 macros or functions for GPIO capability for reset purpose.
- *
- * Take a look for \ref WizFi360_RESET_INIT, \ref WizFi360_RESET_LOW and \ref WizFi360_RESET_HIGH functions.
+ * Reset function of transport sets reset pin of module. On STM32, pin is set with ResetPort and ResetPin members
+ * of @ref WizFi360_LL_USART_t, set ResetPort to NULL when module has no reset pin.
  *
  * \par Time configuration
  *
@@ -78,6 +154,39 @@ extern "C" {
 \verbatim
  Version 1.0
   - First release
+  
+ Version 1.1
+  - Received data are parsed directly from TM USART buffer, unless TM_USART1_USE_CUSTOM_IRQ is defined
+  
+ Version 1.2
+  - Added circular DMA reception with WizFi360_USART_USE_DMA
+  
+ Version 1.3
+  - Added DMA reception with idle line detection, WizFi360_USART_USE_DMA = 2
+  
+ Version 1.4
+  - Added asynchronous DMA transmission, WizFi360_USART_USE_DMA_TX
+  
+ Version 1.5
+  - Asynchronous transmission accepts list of blocks, persistent blocks are sent by DMA without copying
+  
+ Version 1.6
+  - Added RTS/CTS hardware flow control, WizFi360_USART_USE_FLOWCONTROL
+  
+ Version 1.7
+  - Receive errors are counted for baudrate escalation, WizFi360_LL_USARTERRORS
+  
+ Version 1.8
+  - Low-level functions are passed to ESP stack in WizFi360_LL_Transport structure
+  
+ Version 1.9
+  - Received data are delivered to WizFi360 instance which opened transport, one instance per USART
+  
+ Version 2.0
+  - State of each USART is stored in WizFi360_LL_USART_t, one transport per USART is filled with WizFi360_LL_TransportInit
+  
+ Version 2.1
+  - Data overwritten by circular DMA reception are skipped and counted in USART buffer statistics
 \endverbatim
  *
  * \par Dependencies
@@ -105,6 +214,106 @@ extern "C" {
 #define WizFi360_RESET_PORT    GPIOA
 #define WizFi360_RESET_PIN     GPIO_PIN_0 
 
+/* Flow control pins, CTS is USART1 alternate function, RTS is controlled by ESP stack as GPIO */
+#define WizFi360_CTS_PORT      GPIOA
+#define WizFi360_CTS_PIN       GPIO_PIN_11
+#define WizFi360_RTS_PORT      GPIOA
+#define WizFi360_RTS_PIN       GPIO_PIN_12
+#if defined(STM32F0xx)
+#define WizFi360_CTS_AF        GPIO_AF1_USART1
+#else
+#define WizFi360_CTS_AF        GPIO_AF7_USART1
+#endif
+
+/* Enable (1) or disable (0) RTS/CTS hardware flow control on WizFi360 USART, can be set in defines.h */
+#ifndef WizFi360_USART_USE_FLOWCONTROL
+#define WizFi360_USART_USE_FLOWCONTROL 0
+#endif
+
+/* DMA reception on WizFi360 USART, can be set in defines.h:
+ *  - 0: Disabled, received bytes are stored by USART RX interrupt
+ *  - 1: Circular DMA directly into ESP stack buffer, no interrupts
+ *  - 2: Circular DMA with idle line, half and full transfer interrupts, bursts are delivered with WizFi360_DataReceived
+ */
+#ifndef WizFi360_USART_USE_DMA
+#define WizFi360_USART_USE_DMA 0
+#endif
+
+/* Enable (1) or disable (0) asynchronous DMA transmission on WizFi360 USART, can be set in defines.h */
+#ifndef WizFi360_USART_USE_DMA_TX
+#define WizFi360_USART_USE_DMA_TX      0
+#endif
+
+/* Number of blocks in DMA transmit queue, must be power of 2 */
+#ifndef WizFi360_USART_DMA_TXBLOCKS
+#define WizFi360_USART_DMA_TXBLOCKS    16
+#endif
+
+/* Persistent blocks shorter than this are copied to transmit buffer, copy is cheaper than separate DMA transfer */
+#ifndef WizFi360_USART_DMA_TXMINREF
+#define WizFi360_USART_DMA_TXMINREF    16
+#endif
+
+/* Maximal time in milliseconds to wait for progress of DMA transmission, then queued data are dropped and error is returned */
+#ifndef WizFi360_USART_DMA_TXTIMEOUT
+#define WizFi360_USART_DMA_TXTIMEOUT   1000
+#endif
+
+/* DMA memory size for mode 2, each half must be able to hold data received during worst interrupt latency */
+#ifndef WizFi360_USART_DMA_SIZE
+#define WizFi360_USART_DMA_SIZE        256
+#endif
+
+/* DMA settings for USART1 RX and TX, used by WizFi360_LL_USARTDefaults */
+#define WizFi360_USART_IRQ             USART1_IRQn
+#if defined(STM32F0xx)
+#define WizFi360_USART_DMA             DMA1_Channel3
+#define WizFi360_USART_DMA_IRQ         DMA1_Channel2_3_IRQn
+#if defined(DMA2)
+#define WizFi360_USART_DMA_IRQHandler  DMA1_Ch2_3_DMA2_Ch1_2_IRQHandler
+#else
+#define WizFi360_USART_DMA_IRQHandler  DMA1_Channel2_3_IRQHandler
+#endif
+#define WizFi360_USART_DMATX           DMA1_Channel2
+#define WizFi360_USART_DMATX_IRQ       DMA1_Channel2_3_IRQn
+#define WizFi360_USART_DMA_SHARED_IRQ  1
+#if defined(__HAL_DMA1_REMAP) && defined(HAL_DMA1_CH3_USART1_RX)
+#define WizFi360_USART_DMA_REQUEST     HAL_DMA1_CH3_USART1_RX
+#define WizFi360_USART_DMATX_REQUEST   HAL_DMA1_CH2_USART1_TX
+#else
+#define WizFi360_USART_DMA_REQUEST     0
+#define WizFi360_USART_DMATX_REQUEST   0
+#endif
+#define WizFi360_USART_DMA_COUNTER     CNDTR
+#define WizFi360_USART_RX_REGISTER     RDR
+#define WizFi360_USART_TX_REGISTER     TDR
+#else
+#define WizFi360_USART_DMA             DMA2_Stream2
+#define WizFi360_USART_DMA_IRQ         DMA2_Stream2_IRQn
+#define WizFi360_USART_DMA_IRQHandler  DMA2_Stream2_IRQHandler
+#define WizFi360_USART_DMATX           DMA2_Stream7
+#define WizFi360_USART_DMATX_IRQ       DMA2_Stream7_IRQn
+#define WizFi360_USART_DMATX_IRQHandler DMA2_Stream7_IRQHandler
+#define WizFi360_USART_DMA_SHARED_IRQ  0
+#define WizFi360_USART_DMA_REQUEST     DMA_CHANNEL_4
+#define WizFi360_USART_DMATX_REQUEST   DMA_CHANNEL_4
+#define WizFi360_USART_DMA_COUNTER     NDTR
+#if defined(STM32F4xx)
+#define WizFi360_USART_RX_REGISTER     DR
+#define WizFi360_USART_TX_REGISTER     DR
+#else
+#define WizFi360_USART_RX_REGISTER     RDR
+#define WizFi360_USART_TX_REGISTER     TDR
+#endif
+#endif
+
+/* DMA stream (channel on STM32F0xx) type for reception and transmission */
+#if defined(STM32F0xx)
+typedef DMA_Channel_TypeDef WizFi360_LL_DMA_TypeDef;
+#else
+typedef DMA_Stream_TypeDef WizFi360_LL_DMA_TypeDef;
+#endif
+
 /**
  * @brief   Provides delay for amount of milliseconds
  * @param   x: Number of milliseconds for delay
@@ -112,47 +321,120 @@ extern "C" {
  */
 #define WizFi360_DELAYMS(x)         Delayms(x)
 
+#if WizFi360_USART_USE_FLOWCONTROL
+#if WizFi360_USART_USE_DMA == 1 || (WizFi360_USART_USE_DMA == 0 && !defined(TM_USART1_USE_CUSTOM_IRQ))
+#error "Flow control needs received data delivered with WizFi360_DataReceived, define TM_USART1_USE_CUSTOM_IRQ or set WizFi360_USART_USE_DMA to 2"
+#endif
+#endif
+#endif /*!< DOXYGEN_SHOULD_SKIP_THIS */
+
+#if WizFi360_USART_USE_DMA_TX
 /**
- * @brief  Initializes U(S)ART peripheral for WizFi360 communication
- * @note   This function is called from ESP stack
- * @param  baudrate: baudrate for USART you have to use when initializing USART peripheral
- * @retval Initialization status:
- *           - 0: Initialization OK
- *           - > 0: Initialization failed
+ * @brief  Block in DMA transmit queue
  */
-uint8_t WizFi360_LL_USARTInit(uint32_t baudrate);
+typedef struct {
+	const uint8_t* Data; /*!< Pointer to block data or NULL when block data are in transmit buffer */
+	uint16_t Length;     /*!< Number of bytes of block which are not sent yet */
+} WizFi360_LL_TxBlock_t;
+#endif
+
+/**
+ * @brief  USART connected to one WizFi360 module, one structure per USART
+ * @note   Configuration members are set with @ref WizFi360_LL_USARTDefaults (USART1 settings from this file)
+ *         or by user before @ref WizFi360_LL_TransportInit is called. Other members are used by driver only
+ */
+typedef struct _WizFi360_LL_USART_t {
+	USART_TypeDef* USART;                           /*!< USART peripheral */
+	TM_USART_PinsPack_t PinsPack;                   /*!< USART pins pack */
+	IRQn_Type IRQ;                                  /*!< USART interrupt */
+	GPIO_TypeDef* ResetPort;                        /*!< Reset pin port, NULL when module has no reset pin */
+	uint16_t ResetPin;                              /*!< Reset pin */
+	BUFFER_t* RxBuffer;                             /*!< TM USART buffer used directly by ESP stack (eg. &TM_USART2) or NULL when
+	                                                     TM_USARTx_USE_CUSTOM_IRQ is defined for this USART. Not used with DMA reception */
+#if WizFi360_USART_USE_FLOWCONTROL
+	GPIO_TypeDef* CTSPort;                          /*!< CTS pin port, USART alternate function */
+	uint16_t CTSPin;                                /*!< CTS pin */
+	uint8_t CTSAF;                                  /*!< CTS pin alternate function */
+	GPIO_TypeDef* RTSPort;                          /*!< RTS pin port, controlled by ESP stack as GPIO */
+	uint16_t RTSPin;                                /*!< RTS pin */
+#endif
+#if WizFi360_USART_USE_DMA
+	WizFi360_LL_DMA_TypeDef* DMA;                   /*!< DMA stream (channel on STM32F0xx) for reception */
+	IRQn_Type DMAIRQ;                               /*!< Interrupt of reception DMA */
+	uint32_t DMARequest;                            /*!< DMA channel on STM32F4xx/F7xx, DMA1 remap value or 0 on STM32F0xx */
+#endif
+#if WizFi360_USART_USE_DMA_TX
+	WizFi360_LL_DMA_TypeDef* DMATx;                 /*!< DMA stream (channel on STM32F0xx) for transmission */
+	IRQn_Type DMATxIRQ;                             /*!< Interrupt of transmission DMA */
+	uint32_t DMATxRequest;                          /*!< DMA channel on STM32F4xx/F7xx, DMA1 remap value or 0 on STM32F0xx */
+#endif
+	
+	WizFi360_t* WizFi360;                           /*!< Stack instance which receives data, set when transport is opened */
+	struct _WizFi360_LL_USART_t* Next;              /*!< Next opened USART, interrupt callbacks find USART in this list */
+	volatile uint32_t Errors;                       /*!< Receive errors, counted in interrupt */
+#if WizFi360_USART_USE_FLOWCONTROL
+	uint8_t FlowControl;                            /*!< CTS flow control is enabled when module has flow control enabled */
+#endif
+#if WizFi360_USART_USE_DMA
+	DMA_HandleTypeDef DMAHandle;                    /*!< Reception DMA handle */
+#endif
+#if WizFi360_USART_USE_DMA == 1
+	BUFFER_t DMABuffer;                             /*!< Buffer filled by DMA in circular mode, used directly by ESP stack */
+	uint8_t DMAMemory[WizFi360_USARTBUFFER_SIZE];   /*!< DMA memory of buffer */
+	volatile uint32_t DMAHalves;                    /*!< Number of halves of memory written by DMA, counted in half and full transfer interrupts */
+	uint32_t DMAWritten;                            /*!< Number of bytes written by DMA at last buffer update */
+#elif WizFi360_USART_USE_DMA == 2
+	uint8_t DMAMemory[WizFi360_USART_DMA_SIZE];     /*!< DMA memory, data are delivered to ESP stack from interrupts */
+	uint16_t DMAPos;                                /*!< Position of first byte not delivered to ESP stack */
+#endif
+#if WizFi360_USART_USE_DMA_TX
+	DMA_HandleTypeDef DMATxHandle;                  /*!< Transmission DMA handle */
+	WizFi360_LL_TxBlock_t TxBlocks[WizFi360_USART_DMA_TXBLOCKS]; /*!< Transmit queue */
+	volatile uint8_t TxIn;                          /*!< Queue input index, changed by ESP stack */
+	volatile uint8_t TxOut;                         /*!< Queue output index, changed by DMA interrupt */
+	BUFFER_t* TxBuffer;                             /*!< Transmit buffer of ESP stack for copies of blocks */
+	volatile uint16_t TxCount;                      /*!< Number of bytes in running DMA transfer, 0 when idle */
+	volatile uint8_t TxError;                       /*!< Set when block was dropped after DMA error, reported when transmission becomes idle */
+#endif
+} WizFi360_LL_USART_t;
 
 /**
- * @brief  Sends data from ESP stack to WizFi360 module using USART
- * @param  *data: Pointer to data array which should be sent
- * @param  count: Number of data bytes to sent to module
- * @retval Sent status:
- *           - 0: Sent OK
- *           - > 0: Sent error
+ * @brief  Sets configuration of USART1 and pins from this file to USART structure
+ * @note   Other members are cleared
+ * @param  *USART: Pointer to @ref WizFi360_LL_USART_t structure
+ * @retval None
  */
-uint8_t WizFi360_LL_USARTSend(uint8_t* data, uint16_t count);
+void WizFi360_LL_USARTDefaults(WizFi360_LL_USART_t* USART);
 
 /**
- * @brief  Initializes reset pin on platform
- * @note   Function is called from ESP stack module when needed
- * @note   Declared as macro 
+ * @brief  Fills transport for ESP stack, which uses USART from structure
+ * @note   Each USART needs its own transport, pass it to @ref WizFi360_Init.
+ *         USART is initialized when ESP stack opens transport
+ * @param  *USART: Pointer to configured @ref WizFi360_LL_USART_t structure
+ * @param  *Transport: Pointer to @ref WizFi360_Transport_t structure to fill
+ * @retval None
  */
-#define WizFi360_RESET_INIT    TM_GPIO_Init(WizFi360_RESET_PORT, WizFi360_RESET_PIN, TM_GPIO_Mode_OUT, TM_GPIO_OType_PP, TM_GPIO_PuPd_UP, TM_GPIO_Speed_Low)
-	
+void WizFi360_LL_TransportInit(WizFi360_LL_USART_t* USART, WizFi360_Transport_t* Transport);
+
 /**
- * @brief  Sets reset pin LOW
- * @note   Function is called from ESP stack module when needed
- * @note   Declared as macro 
+ * @brief  Delivers received character to ESP stack which uses USART
+ * @note   Call it from TM_USARTx_ReceiveHandler when TM_USARTx_USE_CUSTOM_IRQ is defined.
+ *         Handler for USART1 is already implemented in driver
+ * @param  *USARTx: USART peripheral character was received on
+ * @param  ch: Received character
+ * @retval None
  */
-#define WizFi360_RESET_LOW     TM_GPIO_SetPinLow(WizFi360_RESET_PORT, WizFi360_RESET_PIN)
+void WizFi360_LL_USARTReceive(USART_TypeDef* USARTx, uint8_t ch);
 
+#if WizFi360_USART_USE_DMA || WizFi360_USART_USE_DMA_TX
 /**
- * @brief  Sets reset pin HIGH
- * @note   Function is called from ESP stack module when needed
- * @note   Declared as macro 
+ * @brief  Processes DMA interrupt of all USARTs which use DMA stream (channel on STM32F0xx)
+ * @note   Call it from DMA interrupt handler of stream. Handlers for streams of USART1 from this file are already implemented in driver
+ * @param  *DMAx: DMA stream (channel) which generated interrupt
+ * @retval None
  */
-#define WizFi360_RESET_HIGH    TM_GPIO_SetPinHigh(WizFi360_RESET_PORT, WizFi360_RESET_PIN)
-#endif /*!< DOXYGEN_SHOULD_SKIP_THIS */
+void WizFi360_LL_DMAIRQHandler(WizFi360_LL_DMA_TypeDef* DMAx);
+#endif
 
 /**
  * @}
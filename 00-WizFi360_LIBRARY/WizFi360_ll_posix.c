@@ -0,0 +1,301 @@
+/**
+ * |----------------------------------------------------------------------
+ * | Copyright (C) Tilen Majerle, 2016
+ * |
+ * | This program is free software: you can redistribute it and/or modify
+ * | it under the terms of the GNU General Public License as published by
+ * | the Free Software Foundation, either version 3 of the License, or
+ * | any later version.
+ * |
+ * | This program is distributed in the hope that it will be useful,
+ * | but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * | MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * | GNU General Public License for more details.
+ * |
+ * | You should have received a copy of the GNU General Public License
+ * | along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * |----------------------------------------------------------------------
+ */
+#define _GNU_SOURCE
+#include "WizFi360_ll_posix.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <linux/serial.h>
+
+/* Supported baudrates */
+static const struct {
+	uint32_t Baudrate;
+	speed_t Speed;
+} WizFi360_LL_POSIX_Speeds[] = {
+	{9600, B9600}, {19200, B19200}, {38400, B38400}, {57600, B57600}, {115200, B115200},
+	{230400, B230400}, {460800, B460800}, {500000, B500000}, {576000, B576000}, {921600, B921600},
+	{1000000, B1000000}, {1152000, B1152000}, {1500000, B1500000}, {2000000, B2000000},
+	{2500000, B2500000}, {3000000, B3000000}, {3500000, B3500000}, {4000000, B4000000}
+};
+
+/* Private functions */
+static uint8_t WizFi360_LL_POSIX_Configure(WizFi360_LL_POSIX_t* Posix, uint32_t baudrate);
+static uint32_t WizFi360_LL_POSIX_GetErrors(WizFi360_LL_POSIX_t* Posix);
+static void* WizFi360_LL_POSIX_Reader(void* arg);
+static uint8_t WizFi360_LL_POSIX_Open(void* Arg, WizFi360_t* WizFi360, uint32_t baudrate);
+static uint8_t WizFi360_LL_POSIX_Send(void* Arg, const uint8_t* data, uint16_t count);
+static uint8_t WizFi360_LL_POSIX_SetBaudrate(void* Arg, uint32_t baudrate);
+static void WizFi360_LL_POSIX_Delay(void* Arg, uint32_t ms);
+static uint32_t WizFi360_LL_POSIX_Now(void* Arg);
+static uint32_t WizFi360_LL_POSIX_Errors(void* Arg);
+
+void WizFi360_LL_POSIX_Init(WizFi360_LL_POSIX_t* Posix, const char* device, WizFi360_Transport_t* Transport) {
+	/* Save settings, port is opened from ESP stack */
+	memset(Posix, 0, sizeof(*Posix));
+	Posix->Device = device;
+	Posix->Fd = -1;
+	Posix->Epoll = -1;
+	Posix->WakeFd = -1;
+
+	/* Fill transport, no reset pin and no RTS control */
+	memset(Transport, 0, sizeof(*Transport));
+	Transport->Open = WizFi360_LL_POSIX_Open;
+	Transport->Send = WizFi360_LL_POSIX_Send;
+	Transport->SetBaudrate = WizFi360_LL_POSIX_SetBaudrate;
+	Transport->Delay = WizFi360_LL_POSIX_Delay;
+	Transport->Now = WizFi360_LL_POSIX_Now;
+	Transport->Errors = WizFi360_LL_POSIX_Errors;
+	Transport->Arg = Posix;
+}
+
+void WizFi360_LL_POSIX_DeInit(WizFi360_LL_POSIX_t* Posix) {
+	uint64_t one = 1;
+
+	/* Stop reader thread */
+	if (Posix->Running) {
+		Posix->Running = 0;
+		if (write(Posix->WakeFd, &one, sizeof(one)) < 0) {
+			/* Thread checks running flag also when it waits for free memory */
+		}
+		pthread_join(Posix->Thread, NULL);
+	}
+
+	/* Close descriptors */
+	if (Posix->Epoll >= 0) {
+		close(Posix->Epoll);
+		Posix->Epoll = -1;
+	}
+	if (Posix->WakeFd >= 0) {
+		close(Posix->WakeFd);
+		Posix->WakeFd = -1;
+	}
+	if (Posix->Fd >= 0) {
+		close(Posix->Fd);
+		Posix->Fd = -1;
+	}
+}
+
+/******************************************/
+/*           TRANSPORT FUNCTIONS          */
+/******************************************/
+static uint8_t WizFi360_LL_POSIX_Open(void* Arg, WizFi360_t* WizFi360, uint32_t baudrate) {
+	WizFi360_LL_POSIX_t* Posix = (WizFi360_LL_POSIX_t *)Arg;
+	struct epoll_event ev;
+
+	/* Save stack instance which receives data from reader thread */
+	Posix->WizFi360 = WizFi360;
+
+	/* Port is already open when ESP stack is initialized again */
+	if (Posix->Fd >= 0) {
+		return WizFi360_LL_POSIX_Configure(Posix, baudrate);
+	}
+
+	/* Open port */
+	Posix->Fd = open(Posix->Device, O_RDWR | O_NOCTTY | O_CLOEXEC);
+	if (Posix->Fd < 0) {
+		return 1;
+	}
+
+	/* Set raw mode and baudrate */
+	if (WizFi360_LL_POSIX_Configure(Posix, baudrate)) {
+		WizFi360_LL_POSIX_DeInit(Posix);
+		return 1;
+	}
+
+	/* Errors before open are not reported */
+	WizFi360_LL_POSIX_GetErrors(Posix);
+
+	/* Reader thread waits for data or for stop event */
+	Posix->Epoll = epoll_create1(EPOLL_CLOEXEC);
+	Posix->WakeFd = eventfd(0, EFD_CLOEXEC);
+	if (Posix->Epoll < 0 || Posix->WakeFd < 0) {
+		WizFi360_LL_POSIX_DeInit(Posix);
+		return 1;
+	}
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.fd = Posix->Fd;
+	epoll_ctl(Posix->Epoll, EPOLL_CTL_ADD, Posix->Fd, &ev);
+	ev.data.fd = Posix->WakeFd;
+	epoll_ctl(Posix->Epoll, EPOLL_CTL_ADD, Posix->WakeFd, &ev);
+
+	/* Start reader thread */
+	Posix->Running = 1;
+	if (pthread_create(&Posix->Thread, NULL, WizFi360_LL_POSIX_Reader, Posix)) {
+		Posix->Running = 0;
+		WizFi360_LL_POSIX_DeInit(Posix);
+		return 1;
+	}
+
+	/* Return 0 = Successful */
+	return 0;
+}
+
+static uint8_t WizFi360_LL_POSIX_Send(void* Arg, const uint8_t* data, uint16_t count) {
+	WizFi360_LL_POSIX_t* Posix = (WizFi360_LL_POSIX_t *)Arg;
+	ssize_t len;
+
+	/* Write all data, kernel sends them in background */
+	while (count) {
+		len = write(Posix->Fd, data, count);
+		if (len < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return 1;
+		}
+		data += len;
+		count -= len;
+	}
+
+	/* Return 0 = Successful */
+	return 0;
+}
+
+static uint8_t WizFi360_LL_POSIX_SetBaudrate(void* Arg, uint32_t baudrate) {
+	WizFi360_LL_POSIX_t* Posix = (WizFi360_LL_POSIX_t *)Arg;
+
+	/* Wait until written data are sent with current baudrate */
+	tcdrain(Posix->Fd);
+
+	/* Set new baudrate */
+	return WizFi360_LL_POSIX_Configure(Posix, baudrate);
+}
+
+static void WizFi360_LL_POSIX_Delay(void* Arg, uint32_t ms) {
+	struct timespec ts;
+
+	/* Sleep, continue after signal */
+	ts.tv_sec = ms / 1000;
+	ts.tv_nsec = (long)(ms % 1000) * 1000000L;
+	while (nanosleep(&ts, &ts) < 0 && errno == EINTR);
+}
+
+static uint32_t WizFi360_LL_POSIX_Now(void* Arg) {
+	struct timespec ts;
+
+	/* Monotonic time in milliseconds, overflow is handled by ESP stack */
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint32_t)((uint64_t)ts.tv_sec * 1000U + ts.tv_nsec / 1000000L);
+}
+
+static uint32_t WizFi360_LL_POSIX_Errors(void* Arg) {
+	/* Get errors since last call */
+	return WizFi360_LL_POSIX_GetErrors((WizFi360_LL_POSIX_t *)Arg);
+}
+
+/******************************************/
+/*           PRIVATE FUNCTIONS            */
+/******************************************/
+static uint8_t WizFi360_LL_POSIX_Configure(WizFi360_LL_POSIX_t* Posix, uint32_t baudrate) {
+	struct termios tio;
+	uint8_t i;
+
+	/* Find speed */
+	for (i = 0; i < sizeof(WizFi360_LL_POSIX_Speeds) / sizeof(WizFi360_LL_POSIX_Speeds[0]); i++) {
+		if (WizFi360_LL_POSIX_Speeds[i].Baudrate == baudrate) {
+			break;
+		}
+	}
+	if (i == sizeof(WizFi360_LL_POSIX_Speeds) / sizeof(WizFi360_LL_POSIX_Speeds[0])) {
+		return 1;
+	}
+
+	/* Raw mode, 8N1, read returns as soon as at least one byte is available */
+	if (tcgetattr(Posix->Fd, &tio)) {
+		return 1;
+	}
+	cfmakeraw(&tio);
+	tio.c_cflag |= CLOCAL | CREAD;
+	tio.c_cflag &= ~(CSTOPB | CRTSCTS);
+	tio.c_cc[VMIN] = 1;
+	tio.c_cc[VTIME] = 0;
+	cfsetispeed(&tio, WizFi360_LL_POSIX_Speeds[i].Speed);
+	cfsetospeed(&tio, WizFi360_LL_POSIX_Speeds[i].Speed);
+	if (tcsetattr(Posix->Fd, TCSANOW, &tio)) {
+		return 1;
+	}
+
+	/* Return 0 = Successful */
+	return 0;
+}
+
+static uint32_t WizFi360_LL_POSIX_GetErrors(WizFi360_LL_POSIX_t* Posix) {
+	struct serial_icounter_struct icount;
+	uint32_t total, errors;
+
+	/* Pseudo terminals and some USB adapters do not count errors */
+	if (ioctl(Posix->Fd, TIOCGICOUNT, &icount) < 0) {
+		return 0;
+	}
+
+	/* Get new errors since last check */
+	total = icount.frame + icount.parity + icount.overrun + icount.buf_overrun;
+	errors = total - Posix->Errors;
+	Posix->Errors = total;
+
+	/* Return number of errors */
+	return errors;
+}
+
+static void* WizFi360_LL_POSIX_Reader(void* arg) {
+	WizFi360_LL_POSIX_t* Posix = (WizFi360_LL_POSIX_t *)arg;
+	uint8_t data[WizFi360_LL_POSIX_CHUNK];
+	struct epoll_event ev;
+	uint8_t* ptr;
+	ssize_t len;
+	uint16_t written;
+
+	while (Posix->Running) {
+		/* Wait for data or stop event */
+		if (epoll_wait(Posix->Epoll, &ev, 1, -1) < 1) {
+			continue;
+		}
+		if (ev.data.fd == Posix->WakeFd) {
+			break;
+		}
+
+		/* Read all available data */
+		len = read(Posix->Fd, data, sizeof(data));
+		if (len <= 0) {
+			if (len < 0 && (errno == EINTR || errno == EAGAIN)) {
+				continue;
+			}
+
+			/* Other side of pseudo terminal was closed, wait only for stop event */
+			epoll_ctl(Posix->Epoll, EPOLL_CTL_DEL, Posix->Fd, NULL);
+			continue;
+		}
+
+		/* Deliver data to ESP stack, wait for free memory if buffer is full */
+		for (ptr = data; len && Posix->Running; ptr += written, len -= written) {
+			written = WizFi360_DataReceived(Posix->WizFi360, ptr, (uint16_t)len);
+			if (!written) {
+				WizFi360_LL_POSIX_Delay(Posix, 1);
+			}
+		}
+	}
+
+	return NULL;
+}
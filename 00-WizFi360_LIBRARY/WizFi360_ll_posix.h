@@ -0,0 +1,129 @@
+/**
+ * @author  Tilen Majerle
+ * @email   tilen@majerle.eu
+ * @website http://stm32f4-discovery.com
+ * @link
+ * @version v1.0
+ * @ide     GCC
+ * @license GNU GPL v3
+ * @brief   Low level part for POSIX hosts (Linux), communicates with ESP module over serial port or pseudo terminal.
+ *
+\verbatim
+   ----------------------------------------------------------------------
+    Copyright (C) Tilen Majerle, 2016
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+   ----------------------------------------------------------------------
+\endverbatim
+ */
+#ifndef WizFi360_LL_POSIX_H
+#define WizFi360_LL_POSIX_H 100
+
+/* C++ detection */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @defgroup WizFi360_LL_POSIX
+ * @brief    Low level part for POSIX hosts, with serial port (tty) or pseudo terminal (pty)
+ * @{
+ *
+ * Fills @ref WizFi360_Transport_t structure which is passed to @ref WizFi360_Init, so ESP stack runs on Linux host
+ * without changes, for example under perf, sanitizers or together with load generators.
+ *
+\verbatim
+WizFi360_LL_POSIX_t Posix;
+WizFi360_Transport_t Transport;
+
+WizFi360_LL_POSIX_Init(&Posix, "/dev/ttyUSB0", &Transport);
+WizFi360_Init(&WizFi360, 115200, &Transport);
+\endverbatim
+ *
+ * Port is set to raw mode, 8 data bits, no parity and 1 stop bit. Dedicated reader thread waits for data with epoll
+ * and delivers everything available (up to WizFi360_LL_POSIX_CHUNK bytes) with one @ref WizFi360_DataReceived call.
+ * When USART buffer is full, reader thread waits until stack reads data, so no data are lost and kernel buffers fill instead.
+ *
+ * Time is taken from monotonic clock with Now function of transport, @ref WizFi360_TimeUpdate is not needed.
+ * On serial ports which support TIOCGICOUNT, framing, parity and overrun errors are reported to ESP stack.
+ *
+ * There is no reset pin and no RTS flow control from ESP stack.
+ *
+ * Each port has its own working structure and reader thread, so more modules can be used at the same time,
+ * each with its own @ref WizFi360_t instance and transport.
+ *
+ * \par Dependencies
+ *
+\verbatim
+ - POSIX threads, link with -pthread
+ - Linux epoll and eventfd
+ - WizFi360.h
+\endverbatim
+ */
+
+/* Include ESP layer */
+#include "WizFi360.h"
+
+/* POSIX threads */
+#include <pthread.h>
+
+/**
+ * @brief  Maximal number of bytes reader thread reads and delivers at a time
+ */
+#ifndef WizFi360_LL_POSIX_CHUNK
+#define WizFi360_LL_POSIX_CHUNK    4096
+#endif
+
+/**
+ * @brief  POSIX port working structure
+ * @note   Members are used internally, structure must stay valid while transport is used
+ */
+typedef struct {
+	const char* Device;       /*!< Path to serial port or pseudo terminal */
+	int Fd;                   /*!< Port file descriptor, -1 when closed */
+	int Epoll;                /*!< Epoll descriptor of reader thread */
+	int WakeFd;               /*!< Event descriptor to stop reader thread */
+	pthread_t Thread;         /*!< Reader thread */
+	volatile uint8_t Running; /*!< Reader thread is running */
+	uint32_t Errors;          /*!< Receive errors reported by kernel on last check */
+	WizFi360_t* WizFi360;     /*!< Stack instance which receives data, set when port is opened */
+} WizFi360_LL_POSIX_t;
+
+/**
+ * @brief  Prepares POSIX port and fills transport structure for ESP stack
+ * @note   Port is opened later, when @ref WizFi360_Init calls Open function of transport
+ * @param  *Posix: Pointer to @ref WizFi360_LL_POSIX_t working structure
+ * @param  *device: Path to serial port or pseudo terminal, for example "/dev/ttyUSB0"
+ * @param  *Transport: Pointer to @ref WizFi360_Transport_t structure to fill
+ * @retval None
+ */
+void WizFi360_LL_POSIX_Init(WizFi360_LL_POSIX_t* Posix, const char* device, WizFi360_Transport_t* Transport);
+
+/**
+ * @brief  Stops reader thread and closes port
+ * @param  *Posix: Pointer to @ref WizFi360_LL_POSIX_t working structure
+ * @retval None
+ */
+void WizFi360_LL_POSIX_DeInit(WizFi360_LL_POSIX_t* Posix);
+
+/**
+ * @}
+ */
+
+/* C++ detection */
+#ifdef __cplusplus
+}
+#endif
+
+#endif
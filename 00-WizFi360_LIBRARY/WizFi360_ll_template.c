@@ -28,6 +28,9 @@
 /**************************************************************************/
 /**************************************************************************/
 
+/* Stack instance which receives data from USART, set when transport is opened */
+static WizFi360_t* USART_WizFi360;
+
 uint8_t WizFi360_LL_USARTInit(uint32_t baudrate) {
 	/* Init USART */
 	
@@ -49,5 +52,116 @@ void USART_RX_INTERRUPT_HANDLER_FUNCTION_NAME(void) {
 	
 	
 	/* Send received character to ESP stack */
-	WizFi360_DataReceived(&ch, 1);
+	WizFi360_DataReceived(USART_WizFi360, &ch, 1);
+}
+
+/******************************************/
+/*          TRANSPORT FOR ESP STACK       */
+/******************************************/
+static uint8_t WizFi360_LL_TransportOpen(void* Arg, WizFi360_t* WizFi360, uint32_t baudrate) {
+	/* Save stack instance, USART is bound to it */
+	USART_WizFi360 = WizFi360;
+	
+	/* Init reset pin */
+	WizFi360_RESET_INIT;
+	
+	/* Init USART */
+	return WizFi360_LL_USARTInit(baudrate);
 }
+
+static uint8_t WizFi360_LL_TransportSend(void* Arg, const uint8_t* data, uint16_t count) {
+	/* Send data via USART */
+	return WizFi360_LL_USARTSend((uint8_t *)data, count);
+}
+
+#ifdef WizFi360_LL_USARTSENDASYNC
+static uint8_t WizFi360_LL_TransportSendAsync(void* Arg, BUFFER_t* Buffer, const WizFi360_LL_Block_t* Blocks, uint8_t count) {
+	/* Queue blocks for transmission */
+	WizFi360_LL_USARTSENDASYNC(Buffer, Blocks, count);
+	
+	/* Return 0 = Successful */
+	return 0;
+}
+#endif
+
+static uint8_t WizFi360_LL_TransportSetBaudrate(void* Arg, uint32_t baudrate) {
+	/* Reinit USART */
+	return WizFi360_LL_USARTInit(baudrate);
+}
+
+static void WizFi360_LL_TransportReset(void* Arg, uint8_t state) {
+	/* Set reset pin */
+	if (state) {
+		WizFi360_RESET_HIGH;
+	} else {
+		WizFi360_RESET_LOW;
+	}
+}
+
+static void WizFi360_LL_TransportDelay(void* Arg, uint32_t ms) {
+	/* Delay for amount of milliseconds */
+	WizFi360_DELAYMS(ms);
+}
+
+#if defined(WizFi360_LL_USARTFLOWCONTROL) && defined(WizFi360_LL_USARTSETRTS)
+static void WizFi360_LL_TransportFlowControl(void* Arg, uint8_t enable) {
+	/* Enable or disable CTS on next init */
+	WizFi360_LL_USARTFLOWCONTROL(enable);
+}
+
+static void WizFi360_LL_TransportSetRTS(void* Arg, uint8_t stop) {
+	/* Set RTS line */
+	WizFi360_LL_USARTSETRTS(stop);
+}
+#endif
+
+#ifdef WizFi360_LL_USARTERRORS
+static uint32_t WizFi360_LL_TransportErrors(void* Arg) {
+	/* Get number of receive errors */
+	return WizFi360_LL_USARTERRORS();
+}
+#endif
+
+#ifdef WizFi360_LL_USARTUPDATE
+static void WizFi360_LL_TransportRxUpdate(void* Arg) {
+	/* Update buffer before it is read */
+	WizFi360_LL_USARTUPDATE();
+}
+#endif
+
+const WizFi360_Transport_t WizFi360_LL_Transport = {
+	WizFi360_LL_TransportOpen,
+	WizFi360_LL_TransportSend,
+#ifdef WizFi360_LL_USARTSENDASYNC
+	WizFi360_LL_TransportSendAsync,
+#else
+	NULL,
+#endif
+	WizFi360_LL_TransportSetBaudrate,
+	WizFi360_LL_TransportReset,
+	WizFi360_LL_TransportDelay,
+	NULL,                                  /* Time is updated with WizFi360_TimeUpdate */
+#if defined(WizFi360_LL_USARTFLOWCONTROL) && defined(WizFi360_LL_USARTSETRTS)
+	WizFi360_LL_TransportFlowControl,
+	WizFi360_LL_TransportSetRTS,
+#else
+	NULL,
+	NULL,
+#endif
+#ifdef WizFi360_LL_USARTERRORS
+	WizFi360_LL_TransportErrors,
+#else
+	NULL,
+#endif
+#ifdef WizFi360_LL_USARTBUFFER
+	WizFi360_LL_USARTBUFFER,
+#else
+	NULL,
+#endif
+#ifdef WizFi360_LL_USARTUPDATE
+	WizFi360_LL_TransportRxUpdate,
+#else
+	NULL,
+#endif
+	NULL
+};
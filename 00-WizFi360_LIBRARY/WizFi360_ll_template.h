@@ -81,6 +81,58 @@ uint8_t WizFi360_LL_USARTInit(uint32_t baudrate);
  */
 uint8_t WizFi360_LL_USARTSend(uint8_t* data, uint16_t count);
 
+/**
+ * @brief  Optional asynchronous transmit function, queues list of @ref WizFi360_LL_Block_t blocks and starts sending them
+ * @note   When defined, ESP stack does not use @ref WizFi360_LL_USARTSend. It passes complete command as list of blocks
+ *         and its transmit buffer, function must return without waiting for data to be sent.
+ *         Blocks which are not persistent must be copied (eg. to buffer with @ref BUFFER_Write) before function returns,
+ *         persistent blocks may be sent directly from their memory. Simplest driver copies all blocks to buffer and
+ *         sends data in background (DMA or TX interrupt), using @ref BUFFER_PeekRead to get linear block of data
+ *         and @ref BUFFER_CommitRead to remove it from buffer when it is sent.
+ *         Driver must also wait for running transmission to finish before USART is reinitialized.
+ *         When all queued data were sent, driver calls @ref WizFi360_DataSent from its interrupt
+ * @note   Declared as macro 
+ */
+//#define WizFi360_LL_USARTSENDASYNC(Buffer, Blocks, count)  USART_TX_Start(Buffer, Blocks, count)
+
+/**
+ * @brief  Optional pointer to @ref BUFFER_t structure, filled directly by USART RX interrupt
+ * @note   When defined, ESP stack parses received data from this buffer and does not use its own USART buffer.
+ *         Interrupt must write data into it (eg. with @ref BUFFER_WriteChar) and @ref WizFi360_DataReceived is not used.
+ *         Buffer size must be power of 2
+ * @note   Declared as macro 
+ */
+//#define WizFi360_LL_USARTBUFFER    (&USART_RX_Buffer)
+
+/**
+ * @brief  Optional function to update @ref WizFi360_LL_USARTBUFFER before ESP stack reads from it
+ * @note   Use it when buffer is filled by DMA and input index has to be calculated from DMA counter
+ * @note   Declared as macro 
+ */
+//#define WizFi360_LL_USARTUPDATE()  USART_RX_DMAUpdate()
+
+/**
+ * @brief  Optional function to enable or disable CTS flow control on USART, used on next @ref WizFi360_LL_USARTInit call
+ * @note   When defined together with @ref WizFi360_LL_USARTSETRTS, ESP stack enables RTS/CTS flow control on module
+ *         and calls this function with 1 before USART is reinitialized. @ref WizFi360_DataReceived must be used for received data
+ * @note   Declared as macro 
+ */
+//#define WizFi360_LL_USARTFLOWCONTROL(enable)  USART_CTS_Enable(enable)
+
+/**
+ * @brief  Optional function to set RTS pin, module stops sending data when pin is high
+ * @note   Called from ESP stack, also from @ref WizFi360_DataReceived in interrupt, depending on USART buffer watermarks
+ * @note   Declared as macro 
+ */
+//#define WizFi360_LL_USARTSETRTS(stop)         GPIO_SetPin(RTS_PIN, stop)
+
+/**
+ * @brief  Optional function which returns number of USART receive errors (framing, noise, overrun) since last call
+ * @note   Used by baudrate escalation, see WizFi360_USE_BAUDRATE_ESCALATION. Without it, only responses from module are checked
+ * @note   Declared as macro 
+ */
+//#define WizFi360_LL_USARTERRORS()             USART_GetErrors()
+
 /**
  * @brief  Initializes reset pin on platform
  * @note   Function is called from ESP stack module when needed
@@ -102,6 +154,12 @@ uint8_t WizFi360_LL_USARTSend(uint8_t* data, uint16_t count);
  */
 #define WizFi360_RESET_HIGH    (void)0
 
+/**
+ * @brief  Transport for ESP stack, built from low-level functions and macros above
+ * @note   Pass it to @ref WizFi360_Init
+ */
+extern const WizFi360_Transport_t WizFi360_LL_Transport;
+
 /**
  * @}
  */
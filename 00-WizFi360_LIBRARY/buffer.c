@@ -18,10 +18,23 @@
  */
 #include "buffer.h"
 
-uint8_t BUFFER_Init(BUFFER_t* Buffer, uint16_t Size, uint8_t* BufferPtr) {
+/* Mask for buffer index */
+#define BUFFER_MASK(Buffer)         ((BUFFER_Size_t)((Buffer)->Size - 1))
+
+/* Private functions */
+static BUFFER_Pos_t BUFFER_INT_FindElement(BUFFER_t* Buffer, BUFFER_Size_t from, BUFFER_Size_t count, uint8_t Element);
+static void BUFFER_INT_AdvanceOut(BUFFER_t* Buffer, BUFFER_Size_t count);
+static BUFFER_Size_t BUFFER_INT_AddStats(BUFFER_t* Buffer, BUFFER_Size_t free, BUFFER_Size_t count);
+
+uint8_t BUFFER_Init(BUFFER_t* Buffer, BUFFER_Size_t Size, uint8_t* BufferPtr) {
 	/* Set buffer values to all zeros */
 	memset(Buffer, 0, sizeof(BUFFER_t));
 	
+	/* Size must be power of 2, round it down if not */
+	while (!BUFFER_IS_POWER_OF_2(Size) && Size) {
+		Size &= Size - 1;
+	}
+	
 	/* Set default values */
 	Buffer->Size = Size;
 	Buffer->Buffer = BufferPtr;
@@ -69,346 +82,555 @@ void BUFFER_Free(BUFFER_t* Buffer) {
 	Buffer->Size = 0;
 }
 
-uint16_t BUFFER_Write(BUFFER_t* Buffer, uint8_t* Data, uint16_t count) {
-	uint8_t i = 0;
+BUFFER_Size_t BUFFER_Write(BUFFER_t* Buffer, uint8_t* Data, BUFFER_Size_t count) {
+	BUFFER_Size_t i, in, free, mask;
 	
 	/* Check buffer structure */
-	if (Buffer == NULL) {
+	if (Buffer == NULL || Buffer->Size == 0) {
 		return 0;
 	}
-
-	/* Check input pointer */
-	if (Buffer->In >= Buffer->Size) {
-		Buffer->In = 0;
+	
+	/* Input index is owned by producer, output index is read once */
+	in = Buffer->In;
+	free = Buffer->Size - (BUFFER_Size_t)(in - Buffer->Out);
+	mask = BUFFER_MASK(Buffer);
+	
+	/* Make sure consumer has finished reading memory we will overwrite */
+	BUFFER_MEMORY_BARRIER();
+	
+	/* Write only as much as we have space for */
+	count = BUFFER_INT_AddStats(Buffer, free, count);
+	
+	/* Copy first segment, up to the end of memory */
+	in &= mask;
+	i = Buffer->Size - in;
+	if (i > count) {
+		i = count;
 	}
+	memcpy(&Buffer->Buffer[in], Data, i);
 	
-	/* Go through all elements */
-	while (count--) {
-		/* Check if buffer full */
-		if (
-			(Buffer->In == (Buffer->Out - 1)) ||
-			(Buffer->Out == 0 && Buffer->In == (Buffer->Size - 1))
-		) {
-			break;
-		}
-		
-		/* Add to buffer */
-		Buffer->Buffer[Buffer->In++] = *Data++;
-		
-		/* Increase pointers */
-		i++;
-		
-		/* Check input overflow */
-		if (Buffer->In >= Buffer->Size) {
-			Buffer->In = 0;
-		}
+	/* Copy second segment from the beginning of memory */
+	if (count > i) {
+		memcpy(&Buffer->Buffer[0], &Data[i], count - i);
 	}
 	
+	/* Publish data to consumer after they are written to memory */
+	BUFFER_MEMORY_BARRIER();
+	Buffer->In += count;
+	
 	/* Return number of elements stored in memory */
-	return i;
+	return count;
 }
 
-uint16_t BUFFER_Read(BUFFER_t* Buffer, uint8_t* Data, uint16_t count) {
-	uint16_t i = 0;
+BUFFER_Size_t BUFFER_Read(BUFFER_t* Buffer, uint8_t* Data, BUFFER_Size_t count) {
+	BUFFER_Size_t i, out, full, mask;
 	
 	/* Check buffer structure */
-	if (Buffer == NULL) {
+	if (Buffer == NULL || Buffer->Size == 0) {
 		return 0;
 	}
-
-	/* Check output pointer */
-	if (Buffer->Out >= Buffer->Size) {
-		Buffer->Out = 0;
+	
+	/* Output index is owned by consumer, input index is read once */
+	out = Buffer->Out;
+	full = (BUFFER_Size_t)(Buffer->In - out);
+	mask = BUFFER_MASK(Buffer);
+	
+	/* Make sure data are read after input index */
+	BUFFER_MEMORY_BARRIER();
+	
+	/* Read only as much as we have in buffer */
+	if (count > full) {
+		count = full;
 	}
 	
-	/* Go through all elements */
-	while (count--) {
-		/* Check if pointers are same = buffer is empty */
-		if (Buffer->Out == Buffer->In) {
-			break;
-		}
-		
-		/* Save to user buffer */
-		*Data++ = Buffer->Buffer[Buffer->Out++];
-		
-		/* Increase pointers */
-		i++;
-
-		/* Check output overflow */
-		if (Buffer->Out >= Buffer->Size) {
-			Buffer->Out = 0;
-		}
+	/* Copy first segment, up to the end of memory */
+	out &= mask;
+	i = Buffer->Size - out;
+	if (i > count) {
+		i = count;
+	}
+	memcpy(Data, &Buffer->Buffer[out], i);
+	
+	/* Copy second segment from the beginning of memory */
+	if (count > i) {
+		memcpy(&Data[i], &Buffer->Buffer[0], count - i);
 	}
 	
+	/* Release memory to producer after data are read */
+	BUFFER_INT_AdvanceOut(Buffer, count);
+	
 	/* Return number of elements read from buffer */
-	return i;
+	return count;
 }
 
-uint16_t BUFFER_GetFree(BUFFER_t* Buffer) {
-	uint32_t size, in, out;
+BUFFER_Size_t BUFFER_PeekRead(BUFFER_t* Buffer, uint8_t** Data) {
+	BUFFER_Size_t out, full, linear;
 	
 	/* Check buffer structure */
-	if (Buffer == NULL) {
+	if (Buffer == NULL || Buffer->Size == 0) {
 		return 0;
 	}
 	
-	/* Save values */
-	in = Buffer->In;
+	/* Get number of elements and start of data */
 	out = Buffer->Out;
+	full = (BUFFER_Size_t)(Buffer->In - out);
+	out &= BUFFER_MASK(Buffer);
+	
+	/* Make sure data are read after input index */
+	BUFFER_MEMORY_BARRIER();
 	
-	/* Check if the same */
-	if (in == out) {
-		size = Buffer->Size;
+	/* Limit to the end of memory */
+	linear = Buffer->Size - out;
+	if (linear > full) {
+		linear = full;
 	}
+	
+	/* Save pointer and return length */
+	*Data = &Buffer->Buffer[out];
+	return linear;
+}
 
-	/* Check normal mode */
-	if (out > in) {
-		size = out - in;
+BUFFER_Size_t BUFFER_CommitRead(BUFFER_t* Buffer, BUFFER_Size_t count) {
+	BUFFER_Size_t full;
+	
+	/* Check buffer structure */
+	if (Buffer == NULL) {
+		return 0;
 	}
 	
-	/* Check if overflow mode */
-	if (in > out) {
-		size = Buffer->Size - (in - out);
+	/* Check number of elements */
+	full = BUFFER_GetFull(Buffer);
+	if (count > full) {
+		count = full;
 	}
 	
-	/* Return free memory */
-	return size - 1;
+	/* Release memory to producer after data are read */
+	BUFFER_INT_AdvanceOut(Buffer, count);
+	
+	/* Return number of elements removed */
+	return count;
 }
 
-uint16_t BUFFER_GetFull(BUFFER_t* Buffer) {
-	uint32_t in, out, size;
+BUFFER_Size_t BUFFER_PeekWrite(BUFFER_t* Buffer, uint8_t** Data) {
+	BUFFER_Size_t in, free, linear;
 	
 	/* Check buffer structure */
-	if (Buffer == NULL) {
+	if (Buffer == NULL || Buffer->Size == 0) {
 		return 0;
 	}
 	
-	/* Save values */
+	/* Get free space and start of free memory */
 	in = Buffer->In;
-	out = Buffer->Out;
+	free = Buffer->Size - (BUFFER_Size_t)(in - Buffer->Out);
+	in &= BUFFER_MASK(Buffer);
 	
-	/* Pointer are same? */
-	if (in == out) {
-		size = 0;
-	}
+	/* Make sure consumer has finished reading memory we will overwrite */
+	BUFFER_MEMORY_BARRIER();
 	
-	/* Check pointers and return values */
-	/* Buffer is not in overflow mode */
-	if (in > out) {
-		size = in - out;
+	/* Limit to the end of memory */
+	linear = Buffer->Size - in;
+	if (linear > free) {
+		linear = free;
 	}
 	
-	/* Buffer is in overflow mode */
-	if (out > in) {
-		size = Buffer->Size - (out - in);
+	/* Save pointer and return length */
+	*Data = &Buffer->Buffer[in];
+	return linear;
+}
+
+BUFFER_Size_t BUFFER_CommitWrite(BUFFER_t* Buffer, BUFFER_Size_t count) {
+	BUFFER_Size_t free;
+	
+	/* Check buffer structure */
+	if (Buffer == NULL) {
+		return 0;
 	}
 	
-	/* Return number of elements in buffer */
-	return size;
+	/* Check free space */
+	free = BUFFER_GetFree(Buffer);
+	count = BUFFER_INT_AddStats(Buffer, free, count);
+	
+	/* Publish data to consumer after they are written to memory */
+	BUFFER_MEMORY_BARRIER();
+	Buffer->In += count;
+	
+	/* Return number of elements added */
+	return count;
 }
 
-void BUFFER_Reset(BUFFER_t* Buffer) {
+void BUFFER_ResetStats(BUFFER_t* Buffer) {
 	/* Check buffer structure */
 	if (Buffer == NULL) {
 		return;
 	}
 	
-	/* Reset values */
-	Buffer->In = 0;
-	Buffer->Out = 0;
+	/* Clear statistics, peak starts from current fill level */
+	Buffer->Peak = BUFFER_GetFull(Buffer);
+	Buffer->Dropped = 0;
+	Buffer->FullCount = 0;
 }
 
-int16_t BUFFER_FindElement(BUFFER_t* Buffer, uint8_t Element) {
-	uint16_t Num, Out, retval = 0;
+BUFFER_Size_t BUFFER_GetFree(BUFFER_t* Buffer) {
+	/* Check buffer structure */
+	if (Buffer == NULL) {
+		return 0;
+	}
+	
+	/* Return free memory */
+	return Buffer->Size - BUFFER_GetFull(Buffer);
+}
+
+BUFFER_Size_t BUFFER_GetFull(BUFFER_t* Buffer) {
+	BUFFER_Size_t in, out;
 	
 	/* Check buffer structure */
 	if (Buffer == NULL) {
-		return -1;
+		return 0;
 	}
 	
-	/* Create temporary variables */
-	Num = BUFFER_GetFull(Buffer);
-	Out = Buffer->Out;
+	/* Save values */
+	in = Buffer->In;
+	out = Buffer->Out;
 	
-	/* Go through input elements */
-	while (Num > 0) {
-		/* Check output overflow */
-		if (Out >= Buffer->Size) {
-			Out = 0;
-		}
-		
-		/* Check for element */
-		if ((uint8_t)Buffer->Buffer[Out] == (uint8_t)Element) {
-			/* Element found, return position in buffer */
-			return retval;
-		}
-		
-		/* Set new variables */
-		Out++;
-		Num--;
-		retval++;
+	/* Return number of elements in buffer, indexes are free-running */
+	return (BUFFER_Size_t)(in - out);
+}
+
+void BUFFER_Reset(BUFFER_t* Buffer) {
+	/* Check buffer structure */
+	if (Buffer == NULL) {
+		return;
 	}
 	
-	/* Element is not in buffer */
-	return -1;
+	/* Discard all data, only consumer indexes are modified */
+	Buffer->Out = Buffer->In;
+	Buffer->Scan = Buffer->Out;
+}
+
+BUFFER_Pos_t BUFFER_FindElement(BUFFER_t* Buffer, uint8_t Element) {
+	/* Check buffer structure */
+	if (Buffer == NULL) {
+		return -1;
+	}
+	
+	/* Search all elements in buffer */
+	return (BUFFER_Pos_t)BUFFER_INT_FindElement(Buffer, 0, BUFFER_GetFull(Buffer), Element);
 }
 
-int16_t BUFFER_Find(BUFFER_t* Buffer, uint8_t* Data, uint16_t Size) {
-	uint16_t Num, Out, i, retval = 0;
-	uint8_t found = 0;
+BUFFER_Pos_t BUFFER_Find(BUFFER_t* Buffer, uint8_t* Data, BUFFER_Size_t Size) {
+	BUFFER_Size_t Num, Out, mask, i, retval;
 
 	/* Check buffer structure and number of elements in buffer */
-	if (Buffer == NULL || (Num = BUFFER_GetFull(Buffer)) < Size) {
+	if (Buffer == NULL || Size == 0 || (Num = BUFFER_GetFull(Buffer)) < Size) {
 		return -1;
 	}
 
 	/* Create temporary variables */
 	Out = Buffer->Out;
+	mask = BUFFER_MASK(Buffer);
+	BUFFER_MEMORY_BARRIER();
 
-	/* Go through input elements in buffer */
-	while (Num > 0) {
-		/* Check output overflow */
-		if (Out >= Buffer->Size) {
-			Out = 0;
-		}
-
+	/* Go through all possible start positions in buffer */
+	for (retval = 0; retval <= (BUFFER_Size_t)(Num - Size); retval++) {
 		/* Check if current element in buffer matches first element in data array */
-		if ((uint8_t)Buffer->Buffer[Out] == (uint8_t)Data[0]) {
-			found = 1;
+		if ((uint8_t)Buffer->Buffer[(BUFFER_Size_t)(Out + retval) & mask] != (uint8_t)Data[0]) {
+			continue;
 		}
-
-		/* Set new variables */
-		Out++;
-		Num--;
-		retval++;
-
-		/* We have found first element */
-		if (found) {
-			/* First character found */
-			/* Check others */
-			i = 1;
-			while (i < Size) {
-				/* Check output overflow */
-				if (Out >= Buffer->Size) {
-					Out = 0;
-				}
-
-				/* Check if current character in buffer matches character in string */
-				if ((uint8_t)Buffer->Buffer[Out] != (uint8_t)Data[i]) {
-					retval += i - 1;
-					break;
-				}
-
-				/* Set new variables */
-				Out++;
-				Num--;
-				i++;
-			}
-
-			/* We have found data sequence in buffer */
-			if (i == Size) {
-				return retval - 1;
+		
+		/* First character found, check others */
+		for (i = 1; i < Size; i++) {
+			if ((uint8_t)Buffer->Buffer[(BUFFER_Size_t)(Out + retval + i) & mask] != (uint8_t)Data[i]) {
+				break;
 			}
 		}
+		
+		/* We have found data sequence in buffer */
+		if (i == Size) {
+			return retval;
+		}
 	}
 
 	/* Data sequence is not in buffer */
 	return -1;
 }
 
-uint16_t BUFFER_WriteString(BUFFER_t* Buffer, char* buff) {
+BUFFER_Size_t BUFFER_WriteString(BUFFER_t* Buffer, char* buff) {
 	/* Write string to buffer */
 	return BUFFER_Write(Buffer, (uint8_t *)buff, strlen(buff));
 }
 
-uint16_t BUFFER_ReadString(BUFFER_t* Buffer, char* buff, uint16_t buffsize) {
-	uint16_t i = 0;
-	uint8_t ch;
-	uint16_t freeMem;
+BUFFER_Size_t BUFFER_ReadString(BUFFER_t* Buffer, char* buff, BUFFER_Size_t buffsize) {
+	BUFFER_Size_t full, scanned, len;
+	BUFFER_Pos_t pos;
 	
 	/* Check value buffer */
-	if (Buffer == NULL) {
+	if (Buffer == NULL || buffsize == 0) {
 		return 0;
 	}
 	
-	/* Get free */
-	freeMem = BUFFER_GetFree(Buffer);
+	/* Get number of elements in buffer */
+	full = BUFFER_GetFull(Buffer);
 	
 	/* Check for any data on USART */
-	if (
-		freeMem == 0 ||                                                /*!< Buffer empty */
-		(
-			BUFFER_FindElement(Buffer, Buffer->StringDelimiter) < 0 && /*!< String delimiter is not in buffer */
-			freeMem != 0 &&                                            /*!< Buffer is not full */
-			BUFFER_GetFull(Buffer) < buffsize                          /*!< User buffer size is larger than number of elements in buffer */
-		)
-	) {
-		/* Return 0 */
+	if (full == 0) {                                                   /*!< Buffer empty */
 		return 0;
 	}
 	
-	/* If available buffer size is more than 0 characters */
-	while (i < (buffsize - 1)) {
-		/* We have available data */
-		BUFFER_Read(Buffer, &ch, 1);
-		
-		/* Save character */
-		buff[i] = (char)ch;
+	/* Search for delimiter only in data which were not checked yet */
+	scanned = (BUFFER_Size_t)(Buffer->Scan - Buffer->Out);
+	pos = BUFFER_INT_FindElement(Buffer, scanned, full - scanned, Buffer->StringDelimiter);
+	
+	/* Check for string delimiter */
+	if (pos < 0) {
+		/* Remember where to continue next time */
+		Buffer->Scan = Buffer->Out + full;
 		
-		/* Check for end of string */
-		if ((char)buff[i] == (char)Buffer->StringDelimiter) {
-			/* Done */
-			break;
+		/* Check if we should wait for more data */
+		if (
+			full != Buffer->Size &&                                    /*!< Buffer is not full */
+			full < buffsize                                            /*!< User buffer size is larger than number of elements in buffer */
+		) {
+			/* Return 0 */
+			return 0;
 		}
-		
-		/* Increase */
-		i++;
+		len = full;
+	} else {
+		/* Delimiter is part of string */
+		Buffer->Scan = Buffer->Out + (BUFFER_Size_t)pos;
+		len = (BUFFER_Size_t)pos + 1;
 	}
 	
-	/* Add zero to the end of string */
-	if (i == (buffsize - 1)) {
-		buff[i] = 0;
-	} else {
-		buff[++i] = 0;
+	/* Leave space for zero at the end */
+	if (len > (buffsize - 1)) {
+		len = buffsize - 1;
 	}
+	
+	/* Read string at once */
+	len = BUFFER_Read(Buffer, (uint8_t *)buff, len);
+	
+	/* Add zero to the end of string */
+	buff[len] = 0;
 
 	/* Return number of characters in buffer */
-	return i;
+	return len;
 }
 
-int8_t BUFFER_CheckElement(BUFFER_t* Buffer, uint16_t pos, uint8_t* element) {
-	uint16_t In, Out, i = 0;
+int8_t BUFFER_CheckElement(BUFFER_t* Buffer, BUFFER_Size_t pos, uint8_t* element) {
+	BUFFER_Size_t Out;
 	
 	/* Check value buffer */
 	if (Buffer == NULL) {
 		return 0;
 	}
 	
-	/* Read current values */
-	In = Buffer->In;
+	/* Check if position is inside data in buffer */
 	Out = Buffer->Out;
+	if (pos >= (BUFFER_Size_t)(Buffer->In - Out)) {
+		/* Return zero */
+		return 0;
+	}
+	BUFFER_MEMORY_BARRIER();
+	
+	/* Save element */
+	*element = Buffer->Buffer[(BUFFER_Size_t)(Out + pos) & BUFFER_MASK(Buffer)];
 	
-	/* Set pointers to right location */
-	while (i < pos && (In != Out)) {
-		/* Increase output pointer */
-		Out++;
-		i++;
+	/* Return OK */
+	return 1;
+}
+
+uint8_t BUFFER_MatcherInit(BUFFER_Matcher_t* Matcher, const char* const* Tokens, uint8_t count) {
+	uint8_t Fail[BUFFER_MATCHER_MAX_STATES];
+	uint8_t Queue[BUFFER_MATCHER_MAX_STATES];
+	uint8_t head = 0, tail = 0;
+	uint8_t i, c, state, next;
+	const char* ch;
+	
+	/* Check matcher structure */
+	if (Matcher == NULL || count > BUFFER_MATCHER_MAX_TOKENS) {
+		return 1;
+	}
+	
+	/* Set matcher values to all zeros, state 0 is root */
+	memset(Matcher, 0, sizeof(BUFFER_Matcher_t));
+	Matcher->States = 1;
+	Matcher->Classes = 1;
+	
+	/* Build trie from all tokens */
+	for (i = 0; i < count; i++) {
+		state = 0;
+		for (ch = Tokens[i]; *ch; ch++) {
+			/* Assign class to new character */
+			if (!Matcher->Class[(uint8_t)*ch]) {
+				if (Matcher->Classes >= BUFFER_MATCHER_MAX_CLASSES) {
+					return 1;
+				}
+				Matcher->Class[(uint8_t)*ch] = Matcher->Classes++;
+			}
+			c = Matcher->Class[(uint8_t)*ch];
+			
+			/* Add new state if needed */
+			if (!Matcher->Next[state][c]) {
+				if (Matcher->States >= BUFFER_MATCHER_MAX_STATES) {
+					return 1;
+				}
+				Matcher->Next[state][c] = Matcher->States++;
+			}
+			state = Matcher->Next[state][c];
+		}
 		
-		/* Check overflow */
-		if (Out >= Buffer->Size) {
-			Out = 0;
+		/* Empty tokens are not allowed */
+		if (state == 0) {
+			return 1;
 		}
+		
+		/* Save token end */
+		Matcher->Token[state] = i + 1;
+		Matcher->Length[i] = ch - Tokens[i];
 	}
 	
-	/* If positions match */
-	if (i == pos) {
-		/* Save element */
-		*element = Buffer->Buffer[Out];
-		
-		/* Return OK */
-		return 1;
+	/* Failure links of first level states point to root */
+	for (c = 1; c < Matcher->Classes; c++) {
+		if ((next = Matcher->Next[0][c]) != 0) {
+			Fail[next] = 0;
+			Queue[tail++] = next;
+		}
+	}
+	
+	/* Go through states in breadth first order and complete transition table */
+	while (head < tail) {
+		state = Queue[head++];
+		for (c = 0; c < Matcher->Classes; c++) {
+			next = Matcher->Next[state][c];
+			if (next) {
+				/* Trie edge, set failure and dictionary links */
+				Fail[next] = Matcher->Next[Fail[state]][c];
+				Matcher->Dict[next] = Matcher->Token[Fail[next]] ? Fail[next] : Matcher->Dict[Fail[next]];
+				Queue[tail++] = next;
+			} else {
+				/* Missing edge, use transition from failure state */
+				Matcher->Next[state][c] = Matcher->Next[Fail[state]][c];
+			}
+		}
 	}
 	
-	/* Return zero */
+	/* Initialized OK */
 	return 0;
 }
+
+BUFFER_Size_t BUFFER_MatcherProcess(BUFFER_t* Buffer, BUFFER_Matcher_t* Matcher, BUFFER_MatchCallback_t Callback, void* arg) {
+	BUFFER_Size_t in, mask, found = 0;
+	uint8_t state, token;
+	
+	/* Check structures */
+	if (Buffer == NULL || Matcher == NULL || Buffer->Size == 0) {
+		return 0;
+	}
+	
+	/* Read input index once and make sure data are read after it */
+	in = Buffer->In;
+	mask = BUFFER_MASK(Buffer);
+	BUFFER_MEMORY_BARRIER();
+	
+	/* Go through all new characters */
+	state = Matcher->State;
+	while (1) {
+		/* Skip characters consumer has already removed */
+		if ((BUFFER_Pos_t)(Buffer->Out - Matcher->Pos) > 0) {
+			Matcher->Pos = Buffer->Out;
+			state = 0;
+		}
+		
+		/* Check if everything is processed */
+		if ((BUFFER_Pos_t)(in - Matcher->Pos) <= 0) {
+			break;
+		}
+		
+		/* Make transition */
+		state = Matcher->Next[state][Matcher->Class[Buffer->Buffer[Matcher->Pos & mask]]];
+		Matcher->Pos++;
+		
+		/* Report all tokens which end at this character */
+		token = Matcher->Token[state] ? state : Matcher->Dict[state];
+		while (token) {
+			found++;
+			
+			/* Call user function */
+			if (Callback) {
+				Matcher->State = state;
+				Callback(arg, Matcher->Token[token] - 1, (BUFFER_Pos_t)(Matcher->Pos - Matcher->Length[Matcher->Token[token] - 1] - Buffer->Out));
+			}
+			token = Matcher->Dict[token];
+		}
+	}
+	
+	/* Save state for next call */
+	Matcher->State = state;
+	
+	/* Return number of tokens found */
+	return found;
+}
+
+/******************************************/
+/*           PRIVATE FUNCTIONS            */
+/******************************************/
+static BUFFER_Pos_t BUFFER_INT_FindElement(BUFFER_t* Buffer, BUFFER_Size_t from, BUFFER_Size_t count, uint8_t Element) {
+	BUFFER_Size_t start, linear;
+	uint8_t* ptr;
+	
+	/* Check for data */
+	if (count == 0 || Buffer->Size == 0) {
+		return -1;
+	}
+	
+	/* Make sure data are read after input index */
+	BUFFER_MEMORY_BARRIER();
+	
+	/* Search first segment, up to the end of memory */
+	start = (BUFFER_Size_t)(Buffer->Out + from) & BUFFER_MASK(Buffer);
+	linear = Buffer->Size - start;
+	if (linear > count) {
+		linear = count;
+	}
+	if ((ptr = memchr(&Buffer->Buffer[start], Element, linear)) != NULL) {
+		return from + (ptr - &Buffer->Buffer[start]);
+	}
+	
+	/* Search second segment from the beginning of memory */
+	if (count > linear && (ptr = memchr(&Buffer->Buffer[0], Element, count - linear)) != NULL) {
+		return from + linear + (ptr - &Buffer->Buffer[0]);
+	}
+	
+	/* Element is not in buffer */
+	return -1;
+}
+
+static void BUFFER_INT_AdvanceOut(BUFFER_t* Buffer, BUFFER_Size_t count) {
+	/* Release memory to producer after data are read */
+	BUFFER_MEMORY_BARRIER();
+	
+	/* Keep delimiter scan index inside data, Out <= Scan <= In */
+	if ((BUFFER_Size_t)(Buffer->Scan - Buffer->Out) < count) {
+		Buffer->Scan = Buffer->Out + count;
+	}
+	Buffer->Out += count;
+}
+
+static BUFFER_Size_t BUFFER_INT_AddStats(BUFFER_t* Buffer, BUFFER_Size_t free, BUFFER_Size_t count) {
+	/* Check if data do not fit into buffer */
+	if (count > free) {
+		/* Count dropped data */
+		Buffer->Dropped += count - free;
+		Buffer->FullCount++;
+		
+		/* Write only as much as we have space for */
+		count = free;
+	}
+	
+	/* Update high watermark */
+	if ((BUFFER_Size_t)(Buffer->Size - free + count) > Buffer->Peak) {
+		Buffer->Peak = Buffer->Size - free + count;
+	}
+	
+	/* Return number of elements to write */
+	return count;
+}
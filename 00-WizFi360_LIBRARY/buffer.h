@@ -57,6 +57,21 @@ extern "C" {
 - If user buffer size is less than number of characters in buffer before string delimiter is found, 
     string is also filled in user buffer
 - In all other cases, if there is no string delimiter in buffer, buffer will not return anything and will check for it first.
+- Buffer remembers how far it has already searched for delimiter, so each new call only checks newly received characters
+\endverbatim
+ *
+ * \par Single producer, single consumer
+ *
+ * Buffer is designed to be written from one context (producer, eg. USART RX interrupt) and read from another context (consumer, eg. main loop)
+ * at the same time without disabling interrupts:
+ *
+\verbatim
+- Buffer size must be power of 2. If it is not, it is rounded down to nearest power of 2 in @ref BUFFER_Init
+- Input and output indexes are free-running and are masked with (Size - 1) only when memory is accessed
+- Only producer writes In index and only consumer writes Out index
+- Producer writes data first and then publishes new In index after memory barrier (release)
+- Consumer reads In index, issues memory barrier (acquire) and only then reads data
+- All read, find and reset functions are consumer functions, write functions are producer functions
 \endverbatim
  *
  * \par Dependencies
@@ -80,6 +95,81 @@ extern "C" {
 #define BUFFER_INITIALIZED     0x01 /*!< Buffer initialized flag */
 #define BUFFER_MALLOC          0x02 /*!< Buffer uses malloc for memory */
 
+/**
+ * @brief  Enables (1) or disables (0) 32-bit buffer indexes
+ *
+ *         With 16-bit indexes (default) maximal buffer size is 32768 bytes. Enable 32-bit indexes on devices with large SRAM
+ *         when bigger buffers are needed. Sizes, indexes and positions in all functions use @ref BUFFER_Size_t and @ref BUFFER_Pos_t types.
+ *
+ * @note   Option changes @ref BUFFER_t structure layout and must be set globally for all files (in compiler defines), not in source file
+ */
+#ifndef BUFFER_WIDE_INDEX
+#define BUFFER_WIDE_INDEX          0
+#endif
+
+/**
+ * @brief  Maximal buffer size which can be used with selected index width
+ */
+#if BUFFER_WIDE_INDEX
+#define BUFFER_MAX_SIZE            0x80000000UL
+#else
+#define BUFFER_MAX_SIZE            0x8000UL
+#endif
+
+/**
+ * @brief  Memory barrier used between data access and index update
+ * @note   On single core Cortex-M it costs few cycles and is executed once per read/write call, not per byte
+ */
+#ifndef BUFFER_MEMORY_BARRIER
+#if defined(__CC_ARM)
+#define BUFFER_MEMORY_BARRIER()    __dmb(0xF)
+#elif defined(__ICCARM__)
+#include "intrinsics.h"
+#define BUFFER_MEMORY_BARRIER()    __DMB()
+#elif defined(__GNUC__)
+#define BUFFER_MEMORY_BARRIER()    __sync_synchronize()
+#else
+#define BUFFER_MEMORY_BARRIER()    (void)0
+#endif
+#endif
+
+/**
+ * @brief  Checks if value is power of 2 and can be used as buffer size
+ */
+#define BUFFER_IS_POWER_OF_2(x)    ((x) != 0 && (((x) & ((x) - 1)) == 0))
+
+/**
+ * @brief  Keyword for functions implemented in header file and inlined into caller
+ */
+#ifndef BUFFER_INLINE
+#if defined(__CC_ARM) || defined(__GNUC__)
+#define BUFFER_INLINE              static __inline
+#else
+#define BUFFER_INLINE              static inline
+#endif
+#endif
+
+/**
+ * @brief  Maximal number of states for @ref BUFFER_Matcher_t. At least sum of all token lengths + 1 is required
+ */
+#ifndef BUFFER_MATCHER_MAX_STATES
+#define BUFFER_MATCHER_MAX_STATES  40
+#endif
+
+/**
+ * @brief  Maximal number of different characters in all tokens + 1 for @ref BUFFER_Matcher_t
+ */
+#ifndef BUFFER_MATCHER_MAX_CLASSES
+#define BUFFER_MATCHER_MAX_CLASSES 20
+#endif
+
+/**
+ * @brief  Maximal number of tokens for @ref BUFFER_Matcher_t
+ */
+#ifndef BUFFER_MATCHER_MAX_TOKENS
+#define BUFFER_MATCHER_MAX_TOKENS  8
+#endif
+
 /* Custom allocation and free functions if needed */
 #ifndef LIB_ALLOC_FUNC
 #define LIB_ALLOC_FUNC         malloc
@@ -98,19 +188,62 @@ extern "C" {
  * @{
  */
 
+/**
+ * @brief  Buffer index types, selected with @ref BUFFER_WIDE_INDEX
+ */
+#if BUFFER_WIDE_INDEX
+typedef uint32_t BUFFER_Size_t; /*!< Type for buffer sizes, counts and free-running indexes */
+typedef int32_t BUFFER_Pos_t;   /*!< Type for positions in buffer, negative value means not found */
+#else
+typedef uint16_t BUFFER_Size_t; /*!< Type for buffer sizes, counts and free-running indexes */
+typedef int16_t BUFFER_Pos_t;   /*!< Type for positions in buffer, negative value means not found */
+#endif
+
 /**
  * @brief  Buffer structure
  */
 typedef struct _BUFFER_t {
-	uint16_t Size;           /*!< Size of buffer in units of bytes, DO NOT MOVE OFFSET, 0 */
-	uint16_t In;             /*!< Input pointer to save next value, DO NOT MOVE OFFSET, 1 */
-	uint16_t Out;            /*!< Output pointer to read next value, DO NOT MOVE OFFSET, 2 */
-	uint8_t* Buffer;         /*!< Pointer to buffer data array, DO NOT MOVE OFFSET, 3 */
-	uint8_t Flags;           /*!< Flags for buffer, DO NOT MOVE OFFSET, 4 */
-	uint8_t StringDelimiter; /*!< Character for string delimiter when reading from buffer as string, DO NOT MOVE OFFSET, 5 */
-	void* UserParameters;    /*!< Pointer to user value if needed */
+	BUFFER_Size_t Size;          /*!< Size of buffer in units of bytes, power of 2, DO NOT MOVE OFFSET, 0 */
+	volatile BUFFER_Size_t In;   /*!< Free-running input index, written by producer only, DO NOT MOVE OFFSET, 1 */
+	volatile BUFFER_Size_t Out;  /*!< Free-running output index, written by consumer only, DO NOT MOVE OFFSET, 2 */
+	uint8_t* Buffer;             /*!< Pointer to buffer data array, DO NOT MOVE OFFSET, 3 */
+	uint8_t Flags;               /*!< Flags for buffer, DO NOT MOVE OFFSET, 4 */
+	uint8_t StringDelimiter;     /*!< Character for string delimiter when reading from buffer as string, DO NOT MOVE OFFSET, 5 */
+	void* UserParameters;        /*!< Pointer to user value if needed */
+	BUFFER_Size_t Scan;          /*!< Free-running consumer index up to which data were already checked for string delimiter */
+	BUFFER_Size_t Peak;          /*!< Maximal number of elements in buffer at the same time, updated by producer */
+	uint32_t Dropped;            /*!< Number of elements which were not written because buffer was full, updated by producer */
+	uint32_t FullCount;          /*!< Number of write calls where buffer was full, updated by producer */
 } BUFFER_t;
 
+/**
+ * @brief  Callback function called from @ref BUFFER_MatcherProcess when token is detected in buffer
+ * @param  *arg: User argument as passed to @ref BUFFER_MatcherProcess
+ * @param  token: Index of token in array passed to @ref BUFFER_MatcherInit
+ * @param  pos: Position of first token character in buffer, starting from 0 (same as @ref BUFFER_Find).
+ *            Negative value when token started in characters consumer has already removed from buffer,
+ *            -pos characters of token were removed and the rest of token starts at position 0
+ * @retval None
+ */
+typedef void (*BUFFER_MatchCallback_t)(void* arg, uint8_t token, BUFFER_Pos_t pos);
+
+/**
+ * @brief  Multi token matcher structure
+ * @note   Tokens are compiled to Aho-Corasick automaton with full transition table over character classes,
+ *         so each received character is processed with one table lookup, regardless of number of tokens
+ */
+typedef struct _BUFFER_Matcher_t {
+	uint8_t Class[256];                                                 /*!< Character to character class lookup, class 0 is for characters not used in any token */
+	uint8_t Next[BUFFER_MATCHER_MAX_STATES][BUFFER_MATCHER_MAX_CLASSES]; /*!< Transition table */
+	uint8_t Token[BUFFER_MATCHER_MAX_STATES];                           /*!< Token index + 1 which ends in state or 0 if none */
+	uint8_t Dict[BUFFER_MATCHER_MAX_STATES];                            /*!< Next state on suffix chain which ends a token or 0 if none */
+	uint8_t Length[BUFFER_MATCHER_MAX_TOKENS];                          /*!< Length of each token */
+	uint8_t States;                                                     /*!< Number of used states */
+	uint8_t Classes;                                                    /*!< Number of used character classes */
+	uint8_t State;                                                      /*!< Current state */
+	BUFFER_Size_t Pos;                                                  /*!< Free-running buffer index of next character to process */
+} BUFFER_Matcher_t;
+
 /**
  * @}
  */
@@ -124,14 +257,14 @@ typedef struct _BUFFER_t {
 /**
  * @brief  Initializes buffer structure for work
  * @param  *Buffer: Pointer to @ref BUFFER_t structure to initialize
- * @param  Size: Size of buffer in units of bytes
+ * @param  Size: Size of buffer in units of bytes. Must be power of 2 and not more than @ref BUFFER_MAX_SIZE, otherwise it is rounded down to nearest power of 2
  * @param  *BufferPtr: Pointer to array for buffer storage. Its length should be equal to @param Size parameter.
  *           If NULL is passed as parameter, @ref malloc will be used to allocate memory on heap.
  * @retval Buffer initialization status:
  *            - 0: Buffer initialized OK
  *            - > 0: Buffer initialization error. Malloc has failed with allocation
  */
-uint8_t BUFFER_Init(BUFFER_t* Buffer, uint16_t Size, uint8_t* BufferPtr);
+uint8_t BUFFER_Init(BUFFER_t* Buffer, BUFFER_Size_t Size, uint8_t* BufferPtr);
 
 /**
  * @brief  Free memory for buffer allocated using @ref malloc
@@ -143,38 +276,125 @@ void BUFFER_Free(BUFFER_t* Buffer);
 
 /**
  * @brief  Writes data to buffer
+ * @note   Producer function. If there is not enough space, only part of data is written and rest is counted in Dropped statistics
  * @param  *Buffer: Pointer to @ref BUFFER_t structure
  * @param  *Data: Pointer to data to be written
  * @param  count: Number of elements of type unsigned char to write
  * @retval Number of elements written in buffer 
  */
-uint16_t BUFFER_Write(BUFFER_t* Buffer, uint8_t* Data, uint16_t count);
+BUFFER_Size_t BUFFER_Write(BUFFER_t* Buffer, uint8_t* Data, BUFFER_Size_t count);
+
+/**
+ * @brief  Writes single element to buffer
+ * @note   Producer function, inlined into caller. Use it in receive interrupts to store byte without any function call.
+ *         Buffer must be initialized with @ref BUFFER_Init or have power of 2 size set statically
+ * @param  *Buffer: Pointer to @ref BUFFER_t structure
+ * @param  ch: Element to write
+ * @retval Number of elements written in buffer:
+ *            - 0: Buffer is full, element was dropped
+ *            - 1: Element written
+ */
+BUFFER_INLINE uint8_t BUFFER_WriteChar(BUFFER_t* Buffer, uint8_t ch) {
+	BUFFER_Size_t in = Buffer->In;
+	BUFFER_Size_t full = (BUFFER_Size_t)(in - Buffer->Out);
+	
+	/* Check if there is space for element */
+	if (full >= Buffer->Size) {
+		/* Count dropped data */
+		Buffer->Dropped++;
+		Buffer->FullCount++;
+		return 0;
+	}
+	
+	/* Store element, slot is not overwritten before consumer releases it with new output index */
+	Buffer->Buffer[in & (BUFFER_Size_t)(Buffer->Size - 1)] = ch;
+	
+	/* Update high watermark */
+	if (full >= Buffer->Peak) {
+		Buffer->Peak = full + 1;
+	}
+	
+	/* Make data visible before index */
+	BUFFER_MEMORY_BARRIER();
+	Buffer->In = in + 1;
+	
+	/* Element written */
+	return 1;
+}
 
 /**
  * @brief  Reads data from buffer
+ * @note   Consumer function
  * @param  *Buffer: Pointer to @ref BUFFER_t structure
  * @param  *Data: Pointer to data where read values will be stored
  * @param  count: Number of elements of type unsigned char to read
  * @retval Number of elements read from buffer 
  */
-uint16_t BUFFER_Read(BUFFER_t* Buffer, uint8_t* Data, uint16_t count);
+BUFFER_Size_t BUFFER_Read(BUFFER_t* Buffer, uint8_t* Data, BUFFER_Size_t count);
+
+/**
+ * @brief  Gets pointer and length of largest linear block of data available for read
+ * @note   Consumer function. Data are not removed from buffer until @ref BUFFER_CommitRead is called.
+ *         When data wrap around end of memory, call this function again after commit to get remaining part
+ * @param  *Buffer: Pointer to @ref BUFFER_t structure
+ * @param  **Data: Pointer to pointer where start address of linear block will be saved
+ * @retval Number of elements available in linear block
+ */
+BUFFER_Size_t BUFFER_PeekRead(BUFFER_t* Buffer, uint8_t** Data);
+
+/**
+ * @brief  Removes data from buffer after they were processed in place
+ * @note   Consumer function
+ * @param  *Buffer: Pointer to @ref BUFFER_t structure
+ * @param  count: Number of elements to remove. It is limited to number of elements in buffer
+ * @retval Number of elements removed from buffer
+ */
+BUFFER_Size_t BUFFER_CommitRead(BUFFER_t* Buffer, BUFFER_Size_t count);
+
+/**
+ * @brief  Gets pointer and length of largest linear block of free memory available for write
+ * @note   Producer function. Data written to block are not visible to consumer until @ref BUFFER_CommitWrite is called
+ * @param  *Buffer: Pointer to @ref BUFFER_t structure
+ * @param  **Data: Pointer to pointer where start address of linear block will be saved
+ * @retval Number of elements which can be written to linear block
+ */
+BUFFER_Size_t BUFFER_PeekWrite(BUFFER_t* Buffer, uint8_t** Data);
+
+/**
+ * @brief  Publishes data written directly to memory returned by @ref BUFFER_PeekWrite
+ * @note   Producer function
+ * @param  *Buffer: Pointer to @ref BUFFER_t structure
+ * @param  count: Number of elements written. It is limited to number of free elements in buffer
+ * @retval Number of elements added to buffer
+ */
+BUFFER_Size_t BUFFER_CommitWrite(BUFFER_t* Buffer, BUFFER_Size_t count);
+
+/**
+ * @brief  Clears overflow statistics (Dropped, FullCount) and sets high watermark (Peak) to current number of elements in buffer
+ * @note   Statistics are updated by producer. Call this function when producer is not active or some counts may be lost
+ * @param  *Buffer: Pointer to @ref BUFFER_t structure
+ * @retval None
+ */
+void BUFFER_ResetStats(BUFFER_t* Buffer);
 
 /**
  * @brief  Gets number of free elements in buffer 
  * @param  *Buffer: Pointer to @ref BUFFER_t structure
  * @retval Number of free elements in buffer
  */
-uint16_t BUFFER_GetFree(BUFFER_t* Buffer);
+BUFFER_Size_t BUFFER_GetFree(BUFFER_t* Buffer);
 
 /**
  * @brief  Gets number of elements in buffer 
  * @param  *Buffer: Pointer to @ref BUFFER_t structure
  * @retval Number of elements in buffer
  */
-uint16_t BUFFER_GetFull(BUFFER_t* Buffer);
+BUFFER_Size_t BUFFER_GetFull(BUFFER_t* Buffer);
 
 /**
  * @brief  Resets (clears) buffer pointers
+ * @note   Consumer function. It discards all data currently in buffer by moving output index to input index,
+ *         so it is safe to call while producer is writing to buffer
  * @param  *Buffer: Pointer to @ref BUFFER_t structure
  * @retval None
  */
@@ -189,7 +409,7 @@ void BUFFER_Reset(BUFFER_t* Buffer);
  *            - >= 0: Element found, location in buffer is returned
  *                   Ex: If value 1 is returned, it means 1 read from buffer and your element will be returned
  */
-int16_t BUFFER_FindElement(BUFFER_t* Buffer, uint8_t Element);
+BUFFER_Pos_t BUFFER_FindElement(BUFFER_t* Buffer, uint8_t Element);
 
 /**
  * @brief  Checks if specific data sequence are stored in buffer
@@ -200,7 +420,7 @@ int16_t BUFFER_FindElement(BUFFER_t* Buffer, uint8_t Element);
  *            -  < 0: Sequence was not found
  *            - >= 0: Sequence found, start sequence location in buffer is returned
  */
-int16_t BUFFER_Find(BUFFER_t* Buffer, uint8_t* Data, uint16_t Size);
+BUFFER_Pos_t BUFFER_Find(BUFFER_t* Buffer, uint8_t* Data, BUFFER_Size_t Size);
 
 /**
  * @brief  Sets string delimiter character when reading from buffer as string
@@ -208,7 +428,7 @@ int16_t BUFFER_Find(BUFFER_t* Buffer, uint8_t* Data, uint16_t Size);
  * @param  StringDelimIter: Character as string delimiter
  * @retval None
  */
-#define BUFFER_SetStringDelimiter(Buffer, StrDel)  ((Buffer)->StringDelimiter = (StrDel))
+#define BUFFER_SetStringDelimiter(Buffer, StrDel)  ((Buffer)->StringDelimiter = (StrDel), (Buffer)->Scan = (Buffer)->Out)
 
 /**
  * @brief  Writes string formatted data to buffer
@@ -216,7 +436,7 @@ int16_t BUFFER_Find(BUFFER_t* Buffer, uint8_t* Data, uint16_t Size);
  * @param  *buff: Pointer to string to write 
  * @retval Number of characters written
  */
-uint16_t BUFFER_WriteString(BUFFER_t* Buffer, char* buff);
+BUFFER_Size_t BUFFER_WriteString(BUFFER_t* Buffer, char* buff);
 
 /**
  * @brief  Reads from buffer as string
@@ -225,7 +445,31 @@ uint16_t BUFFER_WriteString(BUFFER_t* Buffer, char* buff);
  * @param  buffsize: Buffer size in units of bytes
  * @retval Number of characters in string
  */
-uint16_t BUFFER_ReadString(BUFFER_t* Buffer, char* buff, uint16_t buffsize);
+BUFFER_Size_t BUFFER_ReadString(BUFFER_t* Buffer, char* buff, BUFFER_Size_t buffsize);
+
+/**
+ * @brief  Compiles list of tokens for @ref BUFFER_MatcherProcess
+ * @param  *Matcher: Pointer to @ref BUFFER_Matcher_t structure
+ * @param  **Tokens: Array of strings to search for
+ * @param  count: Number of tokens in array
+ * @retval Initialization status:
+ *            - 0: Matcher initialized OK
+ *            - > 0: Tokens do not fit into @ref BUFFER_MATCHER_MAX_STATES, @ref BUFFER_MATCHER_MAX_CLASSES or @ref BUFFER_MATCHER_MAX_TOKENS
+ */
+uint8_t BUFFER_MatcherInit(BUFFER_Matcher_t* Matcher, const char* const* Tokens, uint8_t count);
+
+/**
+ * @brief  Processes characters received in buffer since last call and reports every token found
+ * @note   Consumer function. Each character is processed only once and is not removed from buffer.
+ *         If consumer has already removed characters which were not processed, they are skipped.
+ *         Callback function may remove data from buffer
+ * @param  *Buffer: Pointer to @ref BUFFER_t structure
+ * @param  *Matcher: Pointer to @ref BUFFER_Matcher_t structure
+ * @param  Callback: Function to call for each token found
+ * @param  *arg: User argument passed to callback function
+ * @retval Number of tokens found
+ */
+BUFFER_Size_t BUFFER_MatcherProcess(BUFFER_t* Buffer, BUFFER_Matcher_t* Matcher, BUFFER_MatchCallback_t Callback, void* arg);
 
 /**
  * @brief  Checks if character exists in location in buffer
@@ -236,7 +480,7 @@ uint16_t BUFFER_ReadString(BUFFER_t* Buffer, char* buff, uint16_t buffsize);
  *            - 0: Buffer is not so long as position desired
  *            - > 0: Position to check was inside buffer data size
  */
-int8_t BUFFER_CheckElement(BUFFER_t* Buffer, uint16_t pos, uint8_t* element);
+int8_t BUFFER_CheckElement(BUFFER_t* Buffer, BUFFER_Size_t pos, uint8_t* element);
 
 /**
  * @}
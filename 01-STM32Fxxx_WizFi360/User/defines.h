@@ -39,7 +39,20 @@
 //#define RCC_PLLQ              7                      /*!< Used for PLL Q parameter */
 //#define RCC_PLLR              10                     /*!< Used for PLL R parameter, available on STM32F446xx */
 
-/* Use custom IRQ handler function for USART */
-#define TM_USART1_USE_CUSTOM_IRQ  
+/* USART1 RX buffer is used directly by WizFi360 stack, size must be power of 2 */
+#define TM_USART1_BUFFER_SIZE     1024
+
+/* Uncomment to receive WizFi360 data with circular DMA, needed for baudrates above 1 Mbaud */
+/* 1 = DMA directly into stack buffer, 2 = DMA with idle line interrupt, bursts delivered to WizFi360_DataReceived */
+//#define WizFi360_USART_USE_DMA    1
+
+/* Uncomment to send WizFi360 commands and data with DMA in background, stack does not wait for USART */
+//#define WizFi360_USART_USE_DMA_TX 1
+
+/* Uncomment to use RTS/CTS flow control with WizFi360 (CTS on PA11, RTS on PA12), needs WizFi360_USART_USE_DMA 2 or custom IRQ */
+//#define WizFi360_USART_USE_FLOWCONTROL 1
+
+/* Uncomment to pass received bytes to WizFi360 stack with custom IRQ handler and WizFi360_DataReceived */
+//#define TM_USART1_USE_CUSTOM_IRQ  
 
 #endif
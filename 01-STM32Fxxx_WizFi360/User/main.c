@@ -21,11 +21,15 @@
 #include "tm_stm32_disco.h"
 #include "tm_stm32_delay.h"
 #include "tm_stm32_usart.h"
-#include "WizFi360.h"
+#include "WizFi360_ll.h"
 
 /* WizFi360 working structure */
 WizFi360_t WizFi360;
 
+/* USART of WizFi360 module and transport for ESP stack */
+WizFi360_LL_USART_t WizFi360_USART1;
+WizFi360_Transport_t WizFi360_Transport;
+
 int main(void) {
 	uint8_t sock;
 	char tmp[20];
@@ -52,8 +56,12 @@ int main(void) {
 	/* Display message */
 	printf("WizFi360 AT commands parser\r\n");
 	
+	/* Fill transport for USART1 */
+	WizFi360_LL_USARTDefaults(&WizFi360_USART1);
+	WizFi360_LL_TransportInit(&WizFi360_USART1, &WizFi360_Transport);
+	
 	/* Init ESP module */
-	while (WizFi360_Init(&WizFi360, 115200) != ESP_OK) {
+	while (WizFi360_Init(&WizFi360, 115200, &WizFi360_Transport) != ESP_OK) {
 		printf("Problems with initializing module!\r\n");
 	}
 	
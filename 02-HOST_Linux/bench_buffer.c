@@ -0,0 +1,381 @@
+/**
+ * |----------------------------------------------------------------------
+ * | Copyright (C) Tilen Majerle, 2016
+ * |
+ * | This program is free software: you can redistribute it and/or modify
+ * | it under the terms of the GNU General Public License as published by
+ * | the Free Software Foundation, either version 3 of the License, or
+ * | any later version.
+ * |
+ * | This program is distributed in the hope that it will be useful,
+ * | but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * | MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * | GNU General Public License for more details.
+ * |
+ * | You should have received a copy of the GNU General Public License
+ * | along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * |----------------------------------------------------------------------
+ *
+ * Host benchmark for cyclic buffer library (buffer.c)
+ *
+ * Build and run with "make bench" in this directory. Each result is printed
+ * as one JSON object per line (JSON Lines) on stdout:
+ *
+ *   {"rev":"...","bench":"write","size":1024,"chunk":64,"fill":0,"wrap":1,"bytes":...,"ns":...,"mbps":...}
+ *
+ * Fields "bench", "size", "chunk", "fill" and "wrap" identify the measurement
+ * and are the same between runs, so output of two commits can be joined on them.
+ *
+ * Usage: bench_buffer [min_time_ms]
+ */
+#include "buffer.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+/* Revision string, set from Makefile */
+#ifndef BENCH_REVISION
+#define BENCH_REVISION          "unknown"
+#endif
+
+/* Buffer sizes to test */
+static const uint32_t BenchSizes[] = {
+	256, 1024, 4096, 32768,
+#if BUFFER_WIDE_INDEX
+	262144,
+#endif
+};
+
+/* Write/read chunk sizes, 1 = byte per call as from USART interrupt */
+static const uint32_t BenchChunks[] = {1, 16, 64, 256};
+
+/* Fill levels in percent for search and string functions */
+static const uint32_t BenchFills[] = {10, 50, 90};
+
+/* Realistic AT responses, as received from module */
+static const char* const BenchLines[] = {
+	"OK\r\n",
+	"\r\n",
+	"AT+CIPSEND=0,512\r\r\n",
+	"SEND OK\r\n",
+	"0,CONNECT\r\n",
+	"0,CLOSED\r\n",
+	"WIFI CONNECTED\r\n",
+	"WIFI GOT IP\r\n",
+	"+CIFSR:STAIP,\"192.168.1.105\"\r\n",
+	"+CIFSR:STAMAC,\"18:fe:34:a1:b2:c3\"\r\n",
+	"+CWLAP:(3,\"MyNetwork\",-67,\"a0:f3:c1:12:34:56\",6,12,0)\r\n",
+	"+CWLAP:(4,\"Office-2.4GHz-Guest\",-81,\"c4:6e:1f:aa:bb:cc\",11,-5,0)\r\n",
+	"+CIPSTATUS:0,\"TCP\",\"216.58.214.46\",80,1024,0\r\n",
+	"+IPD,0,64:HTTP/1.1 200 OK\r\nContent-Type: text/html\r\nContent-Length: 8\r\n",
+	"busy p...\r\n",
+};
+
+/* Relative frequency of each line in replayed stream */
+static const uint8_t BenchLineWeights[] = {
+	10, 6, 2, 2, 1, 1, 1, 1, 1, 1, 3, 3, 1, 2, 1
+};
+
+/* Minimal measurement time per result */
+static uint64_t MinTime = 50000000ULL;
+
+/* Result sink, prevents compiler to optimize away benchmark loops */
+static volatile uint32_t Sink;
+
+/* Source and destination data */
+static uint8_t* SrcData;
+static uint8_t* DstData;
+
+/* Private functions */
+static uint64_t GetTime(void);
+static void Report(const char* bench, uint32_t size, uint32_t chunk, uint32_t fill, uint32_t wrap, uint64_t bytes, uint64_t ns);
+static void SetPosition(BUFFER_t* Buffer, BUFFER_Size_t start, BUFFER_Size_t full);
+static BUFFER_Size_t GetStart(BUFFER_t* Buffer, uint32_t amount, uint32_t wrap);
+static uint32_t FillLines(uint8_t* data, uint32_t size, uint32_t seed);
+static void BenchWrite(BUFFER_t* Buffer, uint32_t chunk, uint32_t wrap);
+static void BenchRead(BUFFER_t* Buffer, uint32_t chunk, uint32_t wrap);
+static void BenchFindElement(BUFFER_t* Buffer, uint32_t fill, uint32_t wrap);
+static void BenchFind(BUFFER_t* Buffer, uint32_t fill, uint32_t wrap);
+static void BenchReadString(BUFFER_t* Buffer, uint32_t fill, uint32_t wrap);
+static void BenchReplay(BUFFER_t* Buffer);
+
+int main(int argc, char** argv) {
+	BUFFER_t Buffer;
+	uint32_t s, c, f, w, size, max;
+	
+	/* Get minimal time from arguments */
+	if (argc > 1) {
+		MinTime = (uint64_t)strtoul(argv[1], NULL, 10) * 1000000ULL;
+	}
+	
+	/* Allocate data for largest buffer */
+	max = BenchSizes[sizeof(BenchSizes) / sizeof(BenchSizes[0]) - 1];
+	SrcData = malloc(max);
+	DstData = malloc(max);
+	if (!SrcData || !DstData) {
+		return 1;
+	}
+	
+	/* Go through all buffer sizes */
+	for (s = 0; s < sizeof(BenchSizes) / sizeof(BenchSizes[0]); s++) {
+		size = BenchSizes[s];
+		
+		/* Init buffer with dynamic memory */
+		if (BUFFER_Init(&Buffer, size, NULL)) {
+			return 1;
+		}
+		
+		/* Linear and wrap-around position */
+		for (w = 0; w < 2; w++) {
+			for (c = 0; c < sizeof(BenchChunks) / sizeof(BenchChunks[0]); c++) {
+				BenchWrite(&Buffer, BenchChunks[c], w);
+				BenchRead(&Buffer, BenchChunks[c], w);
+			}
+			for (f = 0; f < sizeof(BenchFills) / sizeof(BenchFills[0]); f++) {
+				BenchFindElement(&Buffer, BenchFills[f], w);
+				BenchFind(&Buffer, BenchFills[f], w);
+				BenchReadString(&Buffer, BenchFills[f], w);
+			}
+		}
+		
+		/* Realistic stream */
+		BenchReplay(&Buffer);
+		
+		/* Free memory */
+		BUFFER_Free(&Buffer);
+	}
+	
+	/* Free memory */
+	free(SrcData);
+	free(DstData);
+	
+	return 0;
+}
+
+/******************************************/
+/*           PRIVATE FUNCTIONS            */
+/******************************************/
+static uint64_t GetTime(void) {
+	struct timespec ts;
+	
+	/* Get monotonic time in nanoseconds */
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void Report(const char* bench, uint32_t size, uint32_t chunk, uint32_t fill, uint32_t wrap, uint64_t bytes, uint64_t ns) {
+	/* Print one JSON object per line */
+	printf(
+		"{\"rev\":\"%s\",\"bench\":\"%s\",\"size\":%u,\"chunk\":%u,\"fill\":%u,\"wrap\":%u,\"bytes\":%llu,\"ns\":%llu,\"mbps\":%.2f}\n",
+		BENCH_REVISION, bench, (unsigned)size, (unsigned)chunk, (unsigned)fill, (unsigned)wrap,
+		(unsigned long long)bytes, (unsigned long long)ns, ns ? (double)bytes * 1000.0 / (double)ns : 0.0
+	);
+	fflush(stdout);
+}
+
+static void SetPosition(BUFFER_t* Buffer, BUFFER_Size_t start, BUFFER_Size_t full) {
+	/* Set indexes directly, memory content stays as it is */
+	Buffer->Out = start;
+	Buffer->Scan = start;
+	Buffer->In = start + full;
+}
+
+static BUFFER_Size_t GetStart(BUFFER_t* Buffer, uint32_t amount, uint32_t wrap) {
+	/* Linear data start at the beginning of memory */
+	if (!wrap) {
+		return 0;
+	}
+	
+	/* Wrapped data have half of them at the end of memory */
+	return (BUFFER_Size_t)(Buffer->Size - amount / 2);
+}
+
+static uint32_t FillLines(uint8_t* data, uint32_t size, uint32_t seed) {
+	uint32_t i, len, total = 0, weights = 0;
+	
+	/* Get sum of weights */
+	for (i = 0; i < sizeof(BenchLineWeights); i++) {
+		weights += BenchLineWeights[i];
+	}
+	
+	/* Fill with complete lines only */
+	while (1) {
+		/* Select line with weighted pseudo random number */
+		seed = seed * 1103515245UL + 12345UL;
+		len = (seed >> 16) % weights;
+		for (i = 0; len >= BenchLineWeights[i]; i++) {
+			len -= BenchLineWeights[i];
+		}
+		
+		/* Check if it fits */
+		len = strlen(BenchLines[i]);
+		if (total + len > size) {
+			break;
+		}
+		memcpy(&data[total], BenchLines[i], len);
+		total += len;
+	}
+	
+	/* Return number of bytes filled */
+	return total;
+}
+
+static void BenchWrite(BUFFER_t* Buffer, uint32_t chunk, uint32_t wrap) {
+	uint64_t bytes = 0, start, ns;
+	uint32_t amount = Buffer->Size / 2, i;
+	BUFFER_Size_t pos;
+	
+	/* Chunk must fit into amount of data */
+	if (chunk > amount) {
+		return;
+	}
+	
+	/* Write half of buffer in each round */
+	pos = GetStart(Buffer, amount, wrap);
+	start = GetTime();
+	do {
+		SetPosition(Buffer, pos, 0);
+		for (i = 0; i < amount; i += chunk) {
+			Sink += BUFFER_Write(Buffer, &SrcData[i], chunk);
+		}
+		bytes += amount;
+	} while ((ns = GetTime() - start) < MinTime);
+	
+	/* Report result */
+	Report("write", Buffer->Size, chunk, 50, wrap, bytes, ns);
+}
+
+static void BenchRead(BUFFER_t* Buffer, uint32_t chunk, uint32_t wrap) {
+	uint64_t bytes = 0, start, ns;
+	uint32_t amount = Buffer->Size / 2, i;
+	BUFFER_Size_t pos;
+	
+	/* Chunk must fit into amount of data */
+	if (chunk > amount) {
+		return;
+	}
+	
+	/* Read half of buffer in each round */
+	pos = GetStart(Buffer, amount, wrap);
+	start = GetTime();
+	do {
+		SetPosition(Buffer, pos, amount);
+		for (i = 0; i < amount; i += chunk) {
+			Sink += BUFFER_Read(Buffer, &DstData[i], chunk);
+		}
+		bytes += amount;
+	} while ((ns = GetTime() - start) < MinTime);
+	
+	/* Report result */
+	Report("read", Buffer->Size, chunk, 50, wrap, bytes, ns);
+}
+
+static void BenchFindElement(BUFFER_t* Buffer, uint32_t fill, uint32_t wrap) {
+	uint64_t bytes = 0, start, ns;
+	uint32_t amount = Buffer->Size * fill / 100;
+	BUFFER_Size_t pos;
+	
+	/* Fill data without searched element, element is last one */
+	pos = GetStart(Buffer, amount, wrap);
+	memset(SrcData, 'a', amount);
+	SrcData[amount - 1] = '\n';
+	SetPosition(Buffer, pos, 0);
+	BUFFER_Write(Buffer, SrcData, amount);
+	
+	/* Search through whole data each round */
+	start = GetTime();
+	do {
+		Sink += BUFFER_FindElement(Buffer, '\n');
+		bytes += amount;
+	} while ((ns = GetTime() - start) < MinTime);
+	
+	/* Report result */
+	Report("find_element", Buffer->Size, 1, fill, wrap, bytes, ns);
+}
+
+static void BenchFind(BUFFER_t* Buffer, uint32_t fill, uint32_t wrap) {
+	uint64_t bytes = 0, start, ns;
+	uint32_t amount = Buffer->Size * fill / 100;
+	BUFFER_Size_t pos;
+	static char needle[] = "\r\nSEND OK\r\n";
+	
+	/* Fill with lines which do not contain needle, put needle at the end */
+	pos = GetStart(Buffer, amount, wrap);
+	amount = FillLines(SrcData, amount - (sizeof(needle) - 1), 1);
+	memcpy(&SrcData[amount], needle, sizeof(needle) - 1);
+	amount += sizeof(needle) - 1;
+	SetPosition(Buffer, pos, 0);
+	BUFFER_Write(Buffer, SrcData, amount);
+	
+	/* Search through whole data each round */
+	start = GetTime();
+	do {
+		Sink += BUFFER_Find(Buffer, (uint8_t *)needle, sizeof(needle) - 1);
+		bytes += amount;
+	} while ((ns = GetTime() - start) < MinTime);
+	
+	/* Report result */
+	Report("find", Buffer->Size, sizeof(needle) - 1, fill, wrap, bytes, ns);
+}
+
+static void BenchReadString(BUFFER_t* Buffer, uint32_t fill, uint32_t wrap) {
+	uint64_t bytes = 0, start, ns;
+	uint32_t amount = Buffer->Size * fill / 100;
+	BUFFER_Size_t pos, len;
+	char str[128];
+	
+	/* Fill with AT response lines */
+	pos = GetStart(Buffer, amount, wrap);
+	amount = FillLines(SrcData, amount, 2);
+	SetPosition(Buffer, pos, 0);
+	BUFFER_Write(Buffer, SrcData, amount);
+	
+	/* Read all lines each round */
+	start = GetTime();
+	do {
+		SetPosition(Buffer, pos, amount);
+		while ((len = BUFFER_ReadString(Buffer, str, sizeof(str))) > 0) {
+			Sink += len;
+		}
+		bytes += amount;
+	} while ((ns = GetTime() - start) < MinTime);
+	
+	/* Report result */
+	Report("read_string", Buffer->Size, sizeof(str), fill, wrap, bytes, ns);
+}
+
+static void BenchReplay(BUFFER_t* Buffer) {
+	uint64_t bytes = 0, start, ns;
+	uint32_t amount, i, burst, seed;
+	BUFFER_Size_t len;
+	char str[128];
+	
+	/* Prepare stream of AT responses */
+	amount = FillLines(SrcData, BenchSizes[sizeof(BenchSizes) / sizeof(BenchSizes[0]) - 1], 3);
+	
+	/* Write data in bursts as received, then process all received lines as stack does */
+	SetPosition(Buffer, 0, 0);
+	start = GetTime();
+	do {
+		seed = 4;
+		for (i = 0; i < amount; i += burst) {
+			/* Pseudo random burst length between 1 and 64 bytes */
+			seed = seed * 1103515245UL + 12345UL;
+			burst = 1 + ((seed >> 16) & 0x3F);
+			if (burst > amount - i) {
+				burst = amount - i;
+			}
+			BUFFER_Write(Buffer, &SrcData[i], burst);
+			
+			/* Read complete lines */
+			while ((len = BUFFER_ReadString(Buffer, str, sizeof(str))) > 0) {
+				Sink += len;
+			}
+		}
+		bytes += amount;
+	} while ((ns = GetTime() - start) < MinTime);
+	
+	/* Report result */
+	Report("replay", Buffer->Size, sizeof(str), 0, 0, bytes, ns);
+}
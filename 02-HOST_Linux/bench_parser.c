@@ -0,0 +1,247 @@
+/**
+ * |----------------------------------------------------------------------
+ * | Copyright (C) Tilen Majerle, 2016
+ * |
+ * | This program is free software: you can redistribute it and/or modify
+ * | it under the terms of the GNU General Public License as published by
+ * | the Free Software Foundation, either version 3 of the License, or
+ * | any later version.
+ * |
+ * | This program is distributed in the hope that it will be useful,
+ * | but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * | MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * | GNU General Public License for more details.
+ * |
+ * | You should have received a copy of the GNU General Public License
+ * | along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * |----------------------------------------------------------------------
+ *
+ * Host benchmark for parsing of received lines in ESP stack (WizFi360.c)
+ *
+ * Stack source is included to this file, so private ParseStream function is
+ * measured directly, without transport. Lines are written once to USART ring
+ * buffer, which is then parsed as received data, also across end of ring. Each
+ * result is printed as one JSON object per line (JSON Lines) on stdout:
+ *
+ *   {"rev":"...","bench":"stream","line":"OK\r\n","lines":...,"ns":...,"lps":...}
+ *
+ * Each line from recorded mix is measured alone (ring is filled with copies of
+ * it, time is read once per batch of BENCH_MIX_LINES lines), then complete mix
+ * is measured with line named "mix". Fields "bench" and "line" identify the
+ * measurement, so output of two commits can be joined on them.
+ *
+ * Usage: bench_parser [min_time_ms]
+ */
+#include "WizFi360.c"
+#include <stdlib.h>
+#include <time.h>
+
+/* Revision string, set from Makefile */
+#ifndef BENCH_REVISION
+#define BENCH_REVISION          "unknown"
+#endif
+
+/* Lines received from module with server and two clients, AT firmware 1.x */
+static const char* const BenchLines[] = {
+	"OK\r\n",
+	"\r\n",
+	"SEND OK\r\n",
+	"Recv 7 bytes\r\n",
+	"+IPD,0,7,192.168.1.10,50123:",
+	"0,CONNECT\r\n",
+	"1,CLOSED\r\n",
+	"2,CONNECT FAIL\r\n",
+	"ERROR\r\n",
+	"busy p...\r\n",
+	"ready\r\n",
+	"WIFI CONNECTED\r\n",
+	"WIFI GOT IP\r\n",
+	"WIFI DISCONNECT\r\n",
+	"+CWLAP:(3,\"MyNetwork\",-67,\"a0:f3:c1:12:34:56\",6,12,0)\r\n",
+};
+
+/* Relative frequency of each line in recorded mix */
+static const uint8_t BenchLineWeights[] = {
+	10, 8, 4, 4, 4, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1
+};
+
+/* Payload which follows +IPD header, its size is announced in header */
+#define BENCH_IPD_PAYLOAD       "payload"
+
+/* Number of lines in recorded mix and in batch of single line */
+#define BENCH_MIX_LINES         1024
+
+/* Ring buffer size, enough for mix and for most copies of single line */
+#define BENCH_RING_SIZE         16384
+
+/* Minimal measurement time per result */
+static uint64_t MinTime = 50000000ULL;
+
+/* Stack instance and dummy transport, parser does not send anything */
+static WizFi360_t Bench;
+static WizFi360_Transport_t BenchTransport;
+
+/* Ring buffer used as USART buffer of stack */
+static BUFFER_t BenchRing;
+static uint8_t BenchRingData[BENCH_RING_SIZE];
+
+/* Private functions */
+static uint64_t GetTime(void);
+static void Report(const char* line, uint64_t lines, uint64_t ns);
+static void BenchReset(void);
+static uint32_t BenchWrite(const char* line);
+static void BenchParse(const char* name, uint32_t count);
+
+int main(int argc, char** argv) {
+	uint32_t i, j, seed = 1, weights = 0, sel, count;
+
+	/* Get minimal time from arguments */
+	if (argc > 1) {
+		MinTime = (uint64_t)strtoul(argv[1], NULL, 10) * 1000000ULL;
+	}
+
+	/* Each line alone, as many copies as fit to ring */
+	for (i = 0; i < sizeof(BenchLines) / sizeof(BenchLines[0]); i++) {
+		BenchReset();
+		for (count = 0; count < BENCH_MIX_LINES && BenchWrite(BenchLines[i]); count++);
+		BenchParse(BenchLines[i], count);
+	}
+
+	/* Get sum of weights */
+	for (i = 0; i < sizeof(BenchLineWeights); i++) {
+		weights += BenchLineWeights[i];
+	}
+
+	/* Build mix with weighted pseudo random lines */
+	BenchReset();
+	for (count = 0; count < BENCH_MIX_LINES; count++) {
+		seed = seed * 1103515245UL + 12345UL;
+		sel = (seed >> 16) % weights;
+		for (j = 0; sel >= BenchLineWeights[j]; j++) {
+			sel -= BenchLineWeights[j];
+		}
+		if (!BenchWrite(BenchLines[j])) {
+			break;
+		}
+	}
+	BenchParse("mix", count);
+
+	return 0;
+}
+
+/* Dummy transport functions */
+static uint8_t BenchOpen(void* Arg, WizFi360_t* WizFi360, uint32_t baudrate) {
+	return 0;
+}
+
+static uint8_t BenchSend(void* Arg, const uint8_t* data, uint16_t count) {
+	return 0;
+}
+
+static uint8_t BenchSetBaudrate(void* Arg, uint32_t baudrate) {
+	return 0;
+}
+
+static void BenchDelay(void* Arg, uint32_t ms) {
+
+}
+
+/******************************************/
+/*           PRIVATE FUNCTIONS            */
+/******************************************/
+static uint64_t GetTime(void) {
+	struct timespec ts;
+
+	/* Get monotonic time in nanoseconds */
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void Report(const char* line, uint64_t lines, uint64_t ns) {
+	char name[128];
+	uint32_t i = 0;
+
+	/* Escape line for JSON string */
+	for (; *line && i < sizeof(name) - 3; line++) {
+		if (*line == '\r' || *line == '\n') {
+			name[i++] = '\\';
+			name[i++] = *line == '\r' ? 'r' : 'n';
+		} else if (*line == '"' || *line == '\\') {
+			name[i++] = '\\';
+			name[i++] = *line;
+		} else {
+			name[i++] = *line;
+		}
+	}
+	name[i] = 0;
+
+	/* Print one JSON object per line */
+	printf(
+		"{\"rev\":\"%s\",\"bench\":\"stream\",\"line\":\"%s\",\"lines\":%llu,\"ns\":%llu,\"lps\":%.0f}\n",
+		BENCH_REVISION, name, (unsigned long long)lines, (unsigned long long)ns,
+		ns ? (double)lines * 1000000000.0 / (double)ns : 0.0
+	);
+	fflush(stdout);
+}
+
+static void BenchReset(void) {
+	/* Clean instance with temporary buffer, as after init */
+	memset(&Bench, 0, sizeof(Bench));
+	BenchTransport.Open = BenchOpen;
+	BenchTransport.Send = BenchSend;
+	BenchTransport.SetBaudrate = BenchSetBaudrate;
+	BenchTransport.Delay = BenchDelay;
+	Bench.Transport = &BenchTransport;
+	Bench.USART_Buffer = &BenchRing;
+	BUFFER_Init(Bench.USART_Buffer, BENCH_RING_SIZE, BenchRingData);
+	BUFFER_Init(&Bench.TMP_Buffer, WizFi360_TMPBUFFER_SIZE, Bench.TMPBuffer);
+
+	/* Start in the middle of ring, so data wrap around its end */
+	BenchRing.In = BenchRing.Out = BENCH_RING_SIZE / 2 + 1;
+}
+
+static uint32_t BenchWrite(const char* line) {
+	uint32_t len = strlen(line), payload = 0;
+
+	/* Data announced by +IPD header follow it */
+	if (strncmp(line, "+IPD,", 5) == 0) {
+		payload = sizeof(BENCH_IPD_PAYLOAD) - 1;
+	}
+
+	/* Write complete line or nothing */
+	if (BUFFER_GetFree(&BenchRing) < (len + payload)) {
+		return 0;
+	}
+	BUFFER_Write(&BenchRing, (uint8_t *)line, len);
+	BUFFER_Write(&BenchRing, (uint8_t *)BENCH_IPD_PAYLOAD, payload);
+	return 1;
+}
+
+static void BenchParse(const char* name, uint32_t count) {
+	uint64_t lines = 0, start, ns;
+	BUFFER_Size_t out = BenchRing.Out;
+	uint32_t i;
+
+	/* Parse ring contents again each round, data stay in memory after they are read */
+	start = GetTime();
+	do {
+		for (i = 0; i < BENCH_MIX_LINES; i += count) {
+			/* Rewind ring, all data were already checked by token matcher */
+			BenchRing.Out = out;
+			Bench.USART_Matcher.Pos = BenchRing.In;
+
+			/* Parse until ring is empty, payload of +IPD is removed as update function would read it */
+			while (BenchRing.Out != BenchRing.In) {
+				ParseStream(&Bench);
+				if (Bench.IPD.InIPD) {
+					BUFFER_CommitRead(&BenchRing, Bench.Connection[Bench.IPD.ConnNumber].BytesReceived);
+					Bench.IPD.InIPD = 0;
+				}
+			}
+		}
+		lines += i;
+	} while ((ns = GetTime() - start) < MinTime);
+
+	/* Report result */
+	Report(name, lines, ns);
+}
@@ -0,0 +1,97 @@
+/**
+ * |----------------------------------------------------------------------
+ * | Copyright (C) Tilen Majerle, 2016
+ * |
+ * | This program is free software: you can redistribute it and/or modify
+ * | it under the terms of the GNU General Public License as published by
+ * | the Free Software Foundation, either version 3 of the License, or
+ * | any later version.
+ * |
+ * | This program is distributed in the hope that it will be useful,
+ * | but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * | MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * | GNU General Public License for more details.
+ * |
+ * | You should have received a copy of the GNU General Public License
+ * | along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * |----------------------------------------------------------------------
+ *
+ * Host program running ESP stack on Linux with POSIX low level (WizFi360_ll_posix.c)
+ *
+ * Module is connected to serial port (for example USB to UART adapter) or
+ * emulated on other side of pseudo terminal. Program initializes stack, reads
+ * MAC and IP address and calls update function for given time, then prints
+ * buffer statistics.
+ *
+ * Usage: wizfi360_host device [baudrate] [run_time_ms]
+ */
+#include "WizFi360_ll_posix.h"
+#include <stdlib.h>
+
+/* ESP working structure and POSIX port */
+static WizFi360_t WizFi360;
+static WizFi360_LL_POSIX_t Posix;
+static WizFi360_Transport_t Transport;
+
+/* Prints statistics of one buffer */
+static void PrintBufferStats(const char* name, WizFi360_BufferStats_t* Stats) {
+	printf("%-10s size: %6u, peak: %6u, dropped: %6u, full: %6u\n",
+		name, (unsigned)Stats->Size, (unsigned)Stats->Peak, (unsigned)Stats->Dropped, (unsigned)Stats->FullCount);
+}
+
+int main(int argc, char** argv) {
+	WizFi360_Stats_t Stats;
+	WizFi360_Result_t res;
+	uint32_t baudrate = 115200, run_time = 1000, start;
+	
+	/* Check arguments */
+	if (argc < 2) {
+		fprintf(stderr, "Usage: %s device [baudrate] [run_time_ms]\n", argv[0]);
+		return 1;
+	}
+	if (argc > 2) {
+		baudrate = strtoul(argv[2], NULL, 0);
+	}
+	if (argc > 3) {
+		run_time = strtoul(argv[3], NULL, 0);
+	}
+	
+	/* Prepare port and initialize ESP stack */
+	WizFi360_LL_POSIX_Init(&Posix, argv[1], &Transport);
+	res = WizFi360_Init(&WizFi360, baudrate, &Transport);
+	printf("Init: %d, baudrate: %u\n", res, (unsigned)WizFi360.Baudrate);
+	if (res != ESP_OK) {
+		WizFi360_LL_POSIX_DeInit(&Posix);
+		return 1;
+	}
+	
+	/* Read station MAC and IP address */
+	WizFi360_WaitReady(&WizFi360);
+	if (WizFi360_GetSTAMAC(&WizFi360) == ESP_OK) {
+		WizFi360_WaitReady(&WizFi360);
+	}
+	printf("MAC: %02X:%02X:%02X:%02X:%02X:%02X\n",
+		WizFi360.STAMAC[0], WizFi360.STAMAC[1], WizFi360.STAMAC[2], WizFi360.STAMAC[3], WizFi360.STAMAC[4], WizFi360.STAMAC[5]);
+	if (WizFi360_GetSTAIPBlocking(&WizFi360) == ESP_OK) {
+		printf("IP: %d.%d.%d.%d\n", WizFi360.STAIP[0], WizFi360.STAIP[1], WizFi360.STAIP[2], WizFi360.STAIP[3]);
+	}
+	
+	/* Process module events */
+	start = WizFi360.Time;
+	while ((uint32_t)(WizFi360.Time - start) < run_time) {
+		WizFi360_Update(&WizFi360);
+		Transport.Delay(Transport.Arg, 1);
+	}
+	
+	/* Print buffer statistics */
+	WizFi360_GetBufferStats(&WizFi360, &Stats);
+	PrintBufferStats("USART", &Stats.USART);
+	PrintBufferStats("TMP", &Stats.TMP);
+	PrintBufferStats("Connection", &Stats.Connection);
+	printf("Max update interval: %u ms\n", (unsigned)Stats.MaxUpdateInterval);
+	
+	/* Stop reader thread and close port */
+	WizFi360_LL_POSIX_DeInit(&Posix);
+	
+	return 0;
+}
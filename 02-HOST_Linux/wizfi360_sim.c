@@ -0,0 +1,932 @@
+/**
+ * |----------------------------------------------------------------------
+ * | Copyright (C) Tilen Majerle, 2016
+ * |
+ * | This program is free software: you can redistribute it and/or modify
+ * | it under the terms of the GNU General Public License as published by
+ * | the Free Software Foundation, either version 3 of the License, or
+ * | any later version.
+ * |
+ * | This program is distributed in the hope that it will be useful,
+ * | but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * | MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * | GNU General Public License for more details.
+ * |
+ * | You should have received a copy of the GNU General Public License
+ * | along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * |----------------------------------------------------------------------
+ *
+ * WizFi360 AT firmware simulator, local stand-in for the module
+ *
+ * Simulator creates pseudo terminal and prints path of its slave side on first
+ * line of stdout, or uses already open descriptor (for example one end of
+ * socketpair inherited from parent process). Program with ESP stack opens it
+ * as serial port, for example wizfi360_host with POSIX low level.
+ *
+ * Supported commands are the ones ESP stack uses: AT, ATE, AT+RST, AT+UART,
+ * AT+CWMODE, AT+CIPMUX, AT+CIPDINFO, AT+CWJAP, AT+CWQAP, AT+CWLAP, AT+CIPSTA,
+ * AT+CIPAP, AT+CIPSTAMAC, AT+CIPAPMAC, AT+CWSAP, AT+CIPSTART, AT+CIPSEND(EX)
+ * with "> " prompt, AT+CIPCLOSE, AT+CIPSERVER, AT+CIPSTO and AT+PING.
+ * Every access point can be joined with any password.
+ *
+ * Connections are forwarded to real TCP and UDP sockets: AT+CIPSTART connects
+ * to given host and port, AT+CIPSERVER listens on bind address and data from
+ * sockets are sent to ESP stack as +IPD. AT+PING only resolves host name and
+ * returns latency as ping time, ICMP needs privileges.
+ *
+ * Usage: wizfi360_sim [options]
+ *   -b baudrate  emulated baudrate, data to ESP stack are paced to it (default 0 = no pacing).
+ *                AT+UART changes it when pacing is enabled
+ *   -l latency   latency in milliseconds before response to each command (default 0)
+ *   -u ms:text   inject URC line every ms milliseconds, for example "-u 1000:WIFI GOT IP"
+ *   -i           inject each line read from stdin as URC
+ *   -a address   bind address for AT+CIPSERVER (default 127.0.0.1)
+ *   -f fd        use open descriptor instead of pseudo terminal
+ *
+ * Statistics are printed to stderr when simulator is stopped with SIGINT or SIGTERM.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+/* Simulator limits */
+#define SIM_LINKS           5
+#define SIM_LINE_SIZE       512
+#define SIM_IN_SIZE         8192
+#define SIM_OUT_SIZE        65536
+#define SIM_IPD_SIZE        2048
+#define SIM_SEND_SIZE       2048
+
+/* Station and access point addresses */
+#define SIM_STA_MAC         "18:fe:34:00:00:01"
+#define SIM_AP_MAC          "1a:fe:34:00:00:01"
+#define SIM_STA_IP          "192.168.1.100"
+#define SIM_BSSID           "a0:f3:c1:00:00:01"
+
+/* Connection link */
+typedef struct {
+	int Fd;                          /* Socket, -1 when link is not active */
+	uint8_t Udp;                     /* Link is UDP */
+	char IP[INET_ADDRSTRLEN];        /* Remote IP address */
+	uint16_t Port;                   /* Remote port */
+} SimLink_t;
+
+/* Settings */
+static uint32_t Baudrate;
+static uint32_t Latency;
+static uint32_t UrcPeriod;
+static const char* UrcText;
+static uint8_t UrcStdin;
+static const char* BindAddress = "127.0.0.1";
+
+/* Module state */
+static int AtFd = -1;
+static int ServerFd = -1;
+static SimLink_t Links[SIM_LINKS];
+static uint8_t Echo, Mux, DInfo, WifiConnected;
+static char Ssid[33];
+static volatile sig_atomic_t Running = 1;
+
+/* Data from ESP stack */
+static uint8_t In[SIM_IN_SIZE];
+static uint32_t InLen;
+static char Line[SIM_LINE_SIZE];
+static uint32_t LineLen;
+
+/* Command waiting for latency */
+static uint8_t Pending;
+static uint64_t PendingTime;
+
+/* Data mode after "> " prompt */
+static int8_t SendLink = -1;
+static uint8_t SendEx;
+static uint8_t SendData[SIM_SEND_SIZE];
+static uint32_t SendLen, SendPtr;
+
+/* Data to ESP stack, paced with emulated baudrate */
+static uint8_t Out[SIM_OUT_SIZE];
+static uint32_t OutStart, OutLen;
+static uint64_t TxTime;
+
+/* Next URC injection */
+static uint64_t UrcTime;
+
+/* Statistics */
+static uint64_t StatCommands, StatBytesIn, StatBytesOut, StatIPD, StatSent;
+
+/* Private functions */
+static uint64_t GetTime(void);
+static int OpenPty(void);
+static void Output(const char* fmt, ...);
+static void OutputData(const uint8_t* data, uint32_t len);
+static void Flush(uint64_t now);
+static void ProcessInput(uint64_t now);
+static void ProcessData(void);
+static void Execute(char* cmd);
+static const char* Match(const char* line, const char* cmd);
+static char* NextArg(char** ptr);
+static void Reset(void);
+static void StartLink(char* args);
+static void CloseLink(int8_t id, uint8_t report);
+static void ServerStart(uint16_t port);
+static void ServerAccept(void);
+static void LinkReceive(int8_t id);
+static void SignalHandler(int sig);
+
+int main(int argc, char** argv) {
+	struct pollfd fds[SIM_LINKS + 3];
+	int8_t linkmap[SIM_LINKS + 3];
+	uint64_t now, wake;
+	int opt, nfds, timeout, i;
+	char* ptr;
+
+	/* Parse options */
+	while ((opt = getopt(argc, argv, "b:l:u:ia:f:")) != -1) {
+		switch (opt) {
+			case 'b': Baudrate = strtoul(optarg, NULL, 0); break;
+			case 'l': Latency = strtoul(optarg, NULL, 0); break;
+			case 'u':
+				UrcPeriod = strtoul(optarg, &ptr, 0);
+				UrcText = *ptr == ':' ? ptr + 1 : "";
+				break;
+			case 'i': UrcStdin = 1; break;
+			case 'a': BindAddress = optarg; break;
+			case 'f': AtFd = strtol(optarg, NULL, 0); break;
+			default:
+				fprintf(stderr, "Usage: %s [-b baudrate] [-l latency_ms] [-u ms:text] [-i] [-a bind_address] [-f fd]\n", argv[0]);
+				return 1;
+		}
+	}
+
+	/* Open pseudo terminal if descriptor is not given */
+	if (AtFd < 0 && (AtFd = OpenPty()) < 0) {
+		perror("pty");
+		return 1;
+	}
+	fcntl(AtFd, F_SETFL, fcntl(AtFd, F_GETFL) | O_NONBLOCK);
+
+	/* Stop on signals, socket errors are handled on write */
+	signal(SIGINT, SignalHandler);
+	signal(SIGTERM, SignalHandler);
+	signal(SIGPIPE, SIG_IGN);
+
+	/* Module starts with default settings */
+	for (i = 0; i < SIM_LINKS; i++) {
+		Links[i].Fd = -1;
+	}
+	Reset();
+	UrcTime = GetTime() + UrcPeriod * 1000ULL;
+
+	while (Running) {
+		now = GetTime();
+
+		/* Process commands and send data */
+		ProcessInput(now);
+		Flush(now);
+
+		/* Inject periodic URC */
+		if (UrcPeriod && now >= UrcTime) {
+			if (SendLink < 0) {
+				Output("\r\n%s\r\n", UrcText);
+			}
+			UrcTime += UrcPeriod * 1000ULL;
+		}
+
+		/* Find time of next event */
+		wake = UINT64_MAX;
+		if (Pending) {
+			wake = PendingTime;
+		}
+		if (OutLen && TxTime > now && TxTime < wake) {
+			wake = TxTime;
+		}
+		if (UrcPeriod && UrcTime < wake) {
+			wake = UrcTime;
+		}
+		timeout = wake == UINT64_MAX ? -1 : (int)((wake > now ? wake - now : 0) + 999) / 1000;
+
+		/* AT side, read only when there is memory for data */
+		nfds = 0;
+		fds[nfds].fd = AtFd;
+		fds[nfds].events = (InLen < sizeof(In) ? POLLIN : 0) | (OutLen && TxTime <= now ? POLLOUT : 0);
+		linkmap[nfds++] = -1;
+
+		/* Sockets are read only when +IPD fits to output and ESP stack is not sending data */
+		if (SendLink < 0 && sizeof(Out) - OutLen >= SIM_IPD_SIZE + 64) {
+			for (i = 0; i < SIM_LINKS; i++) {
+				if (Links[i].Fd >= 0) {
+					fds[nfds].fd = Links[i].Fd;
+					fds[nfds].events = POLLIN;
+					linkmap[nfds++] = i;
+				}
+			}
+			if (ServerFd >= 0) {
+				fds[nfds].fd = ServerFd;
+				fds[nfds].events = POLLIN;
+				linkmap[nfds++] = -2;
+			}
+		}
+		if (UrcStdin) {
+			fds[nfds].fd = STDIN_FILENO;
+			fds[nfds].events = POLLIN;
+			linkmap[nfds++] = -3;
+		}
+
+		/* Wait for event */
+		if (poll(fds, nfds, timeout) < 0) {
+			continue;
+		}
+
+		/* Process events */
+		for (i = 0; i < nfds; i++) {
+			if (!fds[i].revents) {
+				continue;
+			}
+			if (linkmap[i] == -1) {
+				ssize_t len;
+
+				/* Read data from ESP stack */
+				if (fds[i].revents & POLLIN) {
+					len = read(AtFd, &In[InLen], sizeof(In) - InLen);
+					if (len > 0) {
+						InLen += len;
+						StatBytesIn += len;
+					}
+				}
+			} else if (linkmap[i] == -2) {
+				ServerAccept();
+			} else if (linkmap[i] == -3) {
+				char urc[SIM_LINE_SIZE];
+
+				/* Inject line from stdin */
+				if (fgets(urc, sizeof(urc), stdin) == NULL) {
+					UrcStdin = 0;
+				} else {
+					urc[strcspn(urc, "\r\n")] = 0;
+					Output("\r\n%s\r\n", urc);
+				}
+			} else {
+				LinkReceive(linkmap[i]);
+			}
+		}
+	}
+
+	/* Print statistics */
+	fprintf(stderr, "commands: %llu, bytes from stack: %llu, bytes to stack: %llu, ipd bytes: %llu, sent bytes: %llu\n",
+		(unsigned long long)StatCommands, (unsigned long long)StatBytesIn, (unsigned long long)StatBytesOut,
+		(unsigned long long)StatIPD, (unsigned long long)StatSent);
+
+	return 0;
+}
+
+static uint64_t GetTime(void) {
+	struct timespec ts;
+
+	/* Monotonic time in microseconds */
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static int OpenPty(void) {
+	struct termios tio;
+	int fd, slave;
+
+	/* Create pseudo terminal */
+	fd = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+	if (fd < 0 || grantpt(fd) || unlockpt(fd)) {
+		return -1;
+	}
+
+	/* Keep slave side open, so master does not report hangup when ESP stack closes port */
+	slave = open(ptsname(fd), O_RDWR | O_NOCTTY | O_CLOEXEC);
+	if (slave < 0) {
+		return -1;
+	}
+
+	/* Raw mode, until ESP stack configures port */
+	tcgetattr(slave, &tio);
+	cfmakeraw(&tio);
+	tcsetattr(slave, TCSANOW, &tio);
+
+	/* Print path for ESP stack */
+	printf("%s\n", ptsname(fd));
+	fflush(stdout);
+
+	return fd;
+}
+
+static void Output(const char* fmt, ...) {
+	char str[SIM_LINE_SIZE];
+	va_list args;
+	int len;
+
+	/* Format string */
+	va_start(args, fmt);
+	len = vsnprintf(str, sizeof(str), fmt, args);
+	va_end(args);
+	if (len >= (int)sizeof(str)) {
+		len = sizeof(str) - 1;
+	}
+
+	/* Add to output */
+	OutputData((uint8_t *)str, len);
+}
+
+static void OutputData(const uint8_t* data, uint32_t len) {
+	/* Move data to beginning of buffer */
+	if (OutStart) {
+		memmove(Out, &Out[OutStart], OutLen);
+		OutStart = 0;
+	}
+
+	/* Drop data when ESP stack does not read, as UART would */
+	if (len > sizeof(Out) - OutLen) {
+		len = sizeof(Out) - OutLen;
+	}
+	memcpy(&Out[OutLen], data, len);
+	OutLen += len;
+}
+
+static void Flush(uint64_t now) {
+	uint32_t count;
+	ssize_t len;
+
+	/* Wait until previous data are sent with emulated baudrate */
+	if (!OutLen || TxTime > now) {
+		return;
+	}
+
+	/* Send 1 millisecond of data at a time, 10 bits per byte */
+	count = OutLen;
+	if (Baudrate && count > Baudrate / 10000 + 1) {
+		count = Baudrate / 10000 + 1;
+	}
+	len = write(AtFd, &Out[OutStart], count);
+	if (len <= 0) {
+		return;
+	}
+	OutStart += len;
+	OutLen -= len;
+	StatBytesOut += len;
+	if (!OutLen) {
+		OutStart = 0;
+	}
+
+	/* Calculate when line is free again */
+	if (Baudrate) {
+		if (TxTime < now) {
+			TxTime = now;
+		}
+		TxTime += (uint64_t)len * 10000000ULL / Baudrate;
+	}
+}
+
+static void ProcessInput(uint64_t now) {
+	uint32_t i = 0;
+
+	/* Command is waiting for latency */
+	if (Pending) {
+		if (now < PendingTime) {
+			return;
+		}
+		Pending = 0;
+		Execute(Line);
+		LineLen = 0;
+	}
+
+	while (i < InLen && !Pending) {
+		/* Data after "> " prompt */
+		if (SendLink >= 0) {
+			uint32_t used = InLen - i;
+
+			/* Copy and move buffer as data are consumed */
+			memmove(In, &In[i], used);
+			InLen = used;
+			i = 0;
+			ProcessData();
+
+			/* Backslash at the end waits for next character */
+			if (SendLink >= 0) {
+				return;
+			}
+			continue;
+		}
+
+		/* Collect command line */
+		if (In[i] == '\n') {
+			/* Remove \r from end */
+			if (LineLen && Line[LineLen - 1] == '\r') {
+				LineLen--;
+			}
+			Line[LineLen] = 0;
+			i++;
+
+			/* Ignore empty lines */
+			if (!LineLen) {
+				continue;
+			}
+
+			/* Echo command */
+			if (Echo) {
+				Output("%s\r\n", Line);
+			}
+
+			/* Execute now or after latency */
+			if (Latency) {
+				Pending = 1;
+				PendingTime = now + Latency * 1000ULL;
+			} else {
+				Execute(Line);
+				LineLen = 0;
+			}
+		} else {
+			if (LineLen < sizeof(Line) - 1) {
+				Line[LineLen++] = In[i];
+			}
+			i++;
+		}
+	}
+
+	/* Remove processed data */
+	memmove(In, &In[i], InLen - i);
+	InLen -= i;
+}
+
+static void ProcessData(void) {
+	SimLink_t* Link = &Links[SendLink];
+	uint32_t i = 0;
+	ssize_t len;
+	uint8_t end = 0;
+
+	/* Copy data until requested length */
+	while (i < InLen && SendPtr < SendLen) {
+		if (SendEx && In[i] == '\\') {
+			/* Wait for next character */
+			if (i + 1 >= InLen) {
+				break;
+			}
+
+			/* "\0" ends data, "\\" is one backslash */
+			if (In[i + 1] == '0') {
+				i += 2;
+				end = 1;
+				break;
+			}
+			if (In[i + 1] == '\\') {
+				i++;
+			}
+		}
+		SendData[SendPtr++] = In[i++];
+	}
+
+	/* Remove processed data */
+	memmove(In, &In[i], InLen - i);
+	InLen -= i;
+
+	/* Still waiting for data */
+	if (!end && SendPtr < SendLen) {
+		return;
+	}
+
+	/* Send data to socket */
+	Output("\r\nRecv %u bytes\r\n", (unsigned)SendPtr);
+	len = send(Link->Fd, SendData, SendPtr, MSG_NOSIGNAL);
+	if (len == (ssize_t)SendPtr) {
+		StatSent += SendPtr;
+		Output("\r\nSEND OK\r\n");
+	} else {
+		Output("\r\nSEND FAIL\r\n");
+	}
+	SendLink = -1;
+}
+
+static void Execute(char* cmd) {
+	const char* args;
+	char* ptr;
+	char* arg;
+	char name[32];
+	int8_t id;
+
+	StatCommands++;
+
+	/* Basic commands */
+	if (strcmp(cmd, "AT") == 0) {
+		Output("\r\nOK\r\n");
+	} else if (strncmp(cmd, "ATE", 3) == 0) {
+		Echo = cmd[3] == '1';
+		Output("\r\nOK\r\n");
+	} else if (Match(cmd, "AT+RST") || Match(cmd, "AT+RESTORE")) {
+		Output("\r\nOK\r\n");
+		Reset();
+		Output("\r\nready\r\n");
+	} else if (Match(cmd, "AT+GMR")) {
+		Output("AT version:1.1.1.7\r\nSDK version:3.0.5\r\nWizFi360 simulator\r\n\r\nOK\r\n");
+	} else if ((args = Match(cmd, "AT+UART")) != NULL && *args == '=') {
+		/* Change emulated baudrate when pacing is enabled */
+		Output("\r\nOK\r\n");
+		if (Baudrate) {
+			Baudrate = strtoul(args + 1, NULL, 10);
+		}
+	} else if ((args = Match(cmd, "AT+CWMODE")) != NULL) {
+		if (*args == '?') {
+			Output("+CWMODE_CUR:1\r\n");
+		}
+		Output("\r\nOK\r\n");
+	} else if ((args = Match(cmd, "AT+CIPMUX")) != NULL) {
+		if (*args == '=') {
+			Mux = args[1] == '1';
+		}
+		Output("\r\nOK\r\n");
+	} else if ((args = Match(cmd, "AT+CIPDINFO")) != NULL) {
+		if (*args == '=') {
+			DInfo = args[1] == '1';
+		}
+		Output("\r\nOK\r\n");
+
+	/* Wi-Fi */
+	} else if ((args = Match(cmd, "AT+CWJAP")) != NULL) {
+		if (*args == '?') {
+			if (WifiConnected) {
+				Output("+CWJAP_CUR:\"%s\",\"" SIM_BSSID "\",6,-50\r\n", Ssid);
+			} else {
+				Output("No AP\r\n");
+			}
+			Output("\r\nOK\r\n");
+		} else if (*args == '=') {
+			ptr = (char *)args + 1;
+			arg = NextArg(&ptr);
+			if (WifiConnected) {
+				Output("WIFI DISCONNECT\r\n");
+			}
+			snprintf(Ssid, sizeof(Ssid), "%s", arg);
+			WifiConnected = 1;
+			Output("WIFI CONNECTED\r\nWIFI GOT IP\r\n\r\nOK\r\n");
+		} else {
+			Output("\r\nERROR\r\n");
+		}
+	} else if (Match(cmd, "AT+CWQAP")) {
+		Output("\r\nOK\r\n");
+		if (WifiConnected) {
+			for (id = 0; id < SIM_LINKS; id++) {
+				CloseLink(id, 0);
+			}
+			WifiConnected = 0;
+			Output("WIFI DISCONNECT\r\n");
+		}
+	} else if (Match(cmd, "AT+CWLAP")) {
+		Output("+CWLAP:(3,\"%s\",-50,\"" SIM_BSSID "\",6,0,0)\r\n", Ssid[0] ? Ssid : "WizFi360_SIM");
+		Output("+CWLAP:(4,\"Office\",-71,\"a0:f3:c1:00:00:02\",1,-3,0)\r\n");
+		Output("+CWLAP:(0,\"Guest\",-83,\"a0:f3:c1:00:00:03\",11,5,0)\r\n");
+		Output("\r\nOK\r\n");
+	} else if ((args = Match(cmd, "AT+CIPSTA")) != NULL || (args = Match(cmd, "AT+CIPAP")) != NULL) {
+		/* Response uses command name as it was sent, with or without _CUR */
+		snprintf(name, sizeof(name), "%.*s", (int)strcspn(cmd + 3, "=?"), cmd + 3);
+		if (*args == '?' && cmd[6] == 'S') {
+			Output("+%s:ip:\"%s\"\r\n", name, WifiConnected ? SIM_STA_IP : "0.0.0.0");
+			Output("+%s:gateway:\"%s\"\r\n", name, WifiConnected ? "192.168.1.1" : "0.0.0.0");
+			Output("+%s:netmask:\"%s\"\r\n", name, WifiConnected ? "255.255.255.0" : "0.0.0.0");
+		} else if (*args == '?') {
+			Output("+%s:ip:\"192.168.4.1\"\r\n", name);
+			Output("+%s:gateway:\"192.168.4.1\"\r\n", name);
+			Output("+%s:netmask:\"255.255.255.0\"\r\n", name);
+		}
+		Output("\r\nOK\r\n");
+	} else if ((args = Match(cmd, "AT+CIPSTAMAC")) != NULL || (args = Match(cmd, "AT+CIPAPMAC")) != NULL) {
+		snprintf(name, sizeof(name), "%.*s", (int)strcspn(cmd + 3, "=?"), cmd + 3);
+		if (*args == '?') {
+			Output("+%s:\"%s\"\r\n", name, strstr(name, "STA") ? SIM_STA_MAC : SIM_AP_MAC);
+		}
+		Output("\r\nOK\r\n");
+	} else if ((args = Match(cmd, "AT+CWSAP")) != NULL) {
+		if (*args == '?') {
+			Output("+CWSAP_CUR:\"WizFi360_SIM\",\"\",1,0,4,0\r\n");
+		}
+		Output("\r\nOK\r\n");
+	} else if (Match(cmd, "AT+CWLIF") || Match(cmd, "AT+CIPSTO") || Match(cmd, "AT+SLEEP") || Match(cmd, "AT+GSLP")) {
+		Output("\r\nOK\r\n");
+
+	/* Connections */
+	} else if ((args = Match(cmd, "AT+CIPSTART")) != NULL && *args == '=') {
+		StartLink((char *)args + 1);
+	} else if (((args = Match(cmd, "AT+CIPSENDEX")) != NULL || (args = Match(cmd, "AT+CIPSEND")) != NULL) && *args == '=') {
+		ptr = (char *)args + 1;
+		id = Mux ? atoi(NextArg(&ptr)) : 0;
+		arg = NextArg(&ptr);
+		if (id < 0 || id >= SIM_LINKS || Links[id].Fd < 0 || !arg) {
+			Output("link is not valid\r\n\r\nERROR\r\n");
+		} else {
+			/* Wait for data */
+			SendLink = id;
+			SendEx = cmd[10] == 'E';
+			SendLen = strtoul(arg, NULL, 10);
+			if (SendLen > SIM_SEND_SIZE) {
+				SendLen = SIM_SEND_SIZE;
+			}
+			SendPtr = 0;
+			Output("\r\nOK\r\n> ");
+		}
+	} else if ((args = Match(cmd, "AT+CIPCLOSE")) != NULL) {
+		id = *args == '=' ? atoi(args + 1) : 0;
+		if (id == SIM_LINKS) {
+			for (id = 0; id < SIM_LINKS; id++) {
+				CloseLink(id, 1);
+			}
+			Output("\r\nOK\r\n");
+		} else if (id >= 0 && id < SIM_LINKS && Links[id].Fd >= 0) {
+			CloseLink(id, 1);
+			Output("\r\nOK\r\n");
+		} else {
+			Output("\r\nERROR\r\n");
+		}
+	} else if ((args = Match(cmd, "AT+CIPSERVER")) != NULL && *args == '=') {
+		ptr = (char *)args + 1;
+		arg = NextArg(&ptr);
+		if (arg && atoi(arg) == 1) {
+			arg = NextArg(&ptr);
+			ServerStart(arg ? atoi(arg) : 333);
+		} else {
+			if (ServerFd >= 0) {
+				close(ServerFd);
+				ServerFd = -1;
+			}
+			Output("\r\nOK\r\n");
+		}
+	} else if ((args = Match(cmd, "AT+PING")) != NULL && *args == '=') {
+		struct addrinfo* res;
+
+		/* Resolve host only */
+		ptr = (char *)args + 1;
+		arg = NextArg(&ptr);
+		if (WifiConnected && arg && getaddrinfo(arg, NULL, NULL, &res) == 0) {
+			freeaddrinfo(res);
+			Output("+%u\r\n\r\nOK\r\n", Latency ? (unsigned)Latency : 1);
+		} else {
+			Output("+timeout\r\n\r\nERROR\r\n");
+		}
+	} else {
+		Output("\r\nERROR\r\n");
+	}
+}
+
+static const char* Match(const char* line, const char* cmd) {
+	size_t len = strlen(cmd);
+
+	/* Check command name */
+	if (strncmp(line, cmd, len)) {
+		return NULL;
+	}
+	line += len;
+
+	/* Ignore _CUR and _DEF suffix */
+	if (strncmp(line, "_CUR", 4) == 0 || strncmp(line, "_DEF", 4) == 0) {
+		line += 4;
+	}
+
+	/* Name must end here */
+	if (*line && *line != '=' && *line != '?') {
+		return NULL;
+	}
+	return line;
+}
+
+static char* NextArg(char** ptr) {
+	char* arg = *ptr;
+	char* end;
+
+	/* No more arguments */
+	if (arg == NULL || !*arg) {
+		return NULL;
+	}
+
+	/* Quoted string */
+	if (*arg == '"') {
+		arg++;
+		end = strchr(arg, '"');
+		if (end) {
+			*end++ = 0;
+		} else {
+			end = arg + strlen(arg);
+		}
+	} else {
+		end = arg + strcspn(arg, ",");
+	}
+
+	/* Skip comma */
+	if (*end == ',') {
+		*end++ = 0;
+	}
+	*ptr = end;
+
+	return arg;
+}
+
+static void Reset(void) {
+	int8_t id;
+
+	/* Close everything */
+	for (id = 0; id < SIM_LINKS; id++) {
+		CloseLink(id, 0);
+	}
+	if (ServerFd >= 0) {
+		close(ServerFd);
+		ServerFd = -1;
+	}
+
+	/* Default settings */
+	Echo = 1;
+	Mux = 0;
+	DInfo = 0;
+	WifiConnected = 0;
+	SendLink = -1;
+}
+
+static void StartLink(char* args) {
+	struct addrinfo hints, *res;
+	struct sockaddr_in addr;
+	socklen_t addrlen = sizeof(addr);
+	char* type;
+	char* host;
+	char* port;
+	char service[8];
+	int8_t id;
+	int fd;
+
+	/* Parse arguments */
+	id = Mux ? atoi(NextArg(&args)) : 0;
+	type = NextArg(&args);
+	host = NextArg(&args);
+	port = NextArg(&args);
+	if (id < 0 || id >= SIM_LINKS || !type || !host || !port) {
+		Output("\r\nERROR\r\n");
+		return;
+	}
+	if (Links[id].Fd >= 0) {
+		Output("ALREADY CONNECTED\r\n\r\nERROR\r\n");
+		return;
+	}
+	if (!WifiConnected) {
+		Output("no ip\r\n\r\nERROR\r\n");
+		return;
+	}
+
+	/* Resolve and connect */
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = strcmp(type, "UDP") == 0 ? SOCK_DGRAM : SOCK_STREAM;
+	snprintf(service, sizeof(service), "%d", atoi(port));
+	if (getaddrinfo(host, service, &hints, &res)) {
+		Output("DNS Fail\r\n\r\nERROR\r\n");
+		return;
+	}
+	fd = socket(res->ai_family, res->ai_socktype | SOCK_CLOEXEC, 0);
+	if (fd < 0 || connect(fd, res->ai_addr, res->ai_addrlen)) {
+		if (fd >= 0) {
+			close(fd);
+		}
+		freeaddrinfo(res);
+		Output("\r\nERROR\r\n");
+		if (Mux) {
+			Output("%d,CLOSED\r\n", id);
+		} else {
+			Output("CLOSED\r\n");
+		}
+		return;
+	}
+	freeaddrinfo(res);
+
+	/* Save link */
+	Links[id].Fd = fd;
+	Links[id].Udp = hints.ai_socktype == SOCK_DGRAM;
+	getpeername(fd, (struct sockaddr *)&addr, &addrlen);
+	inet_ntop(AF_INET, &addr.sin_addr, Links[id].IP, sizeof(Links[id].IP));
+	Links[id].Port = ntohs(addr.sin_port);
+
+	if (Mux) {
+		Output("%d,CONNECT\r\n\r\nOK\r\n", id);
+	} else {
+		Output("CONNECT\r\n\r\nOK\r\n");
+	}
+}
+
+static void CloseLink(int8_t id, uint8_t report) {
+	/* Check if active */
+	if (Links[id].Fd < 0) {
+		return;
+	}
+	close(Links[id].Fd);
+	Links[id].Fd = -1;
+
+	/* Notify ESP stack */
+	if (report) {
+		if (Mux) {
+			Output("%d,CLOSED\r\n", id);
+		} else {
+			Output("CLOSED\r\n");
+		}
+	}
+}
+
+static void ServerStart(uint16_t port) {
+	struct sockaddr_in addr;
+	int fd, one = 1;
+
+	/* Server needs multiple connections */
+	if (!Mux || ServerFd >= 0) {
+		Output("\r\nERROR\r\n");
+		return;
+	}
+
+	/* Listen on bind address */
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	inet_pton(AF_INET, BindAddress, &addr.sin_addr);
+	fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) || listen(fd, SIM_LINKS)) {
+		close(fd);
+		Output("\r\nERROR\r\n");
+		return;
+	}
+	ServerFd = fd;
+	Output("\r\nOK\r\n");
+}
+
+static void ServerAccept(void) {
+	struct sockaddr_in addr;
+	socklen_t addrlen = sizeof(addr);
+	int8_t id;
+	int fd;
+
+	/* Accept connection */
+	fd = accept4(ServerFd, (struct sockaddr *)&addr, &addrlen, SOCK_CLOEXEC);
+	if (fd < 0) {
+		return;
+	}
+
+	/* Find free link, highest first as module does */
+	for (id = SIM_LINKS - 1; id >= 0; id--) {
+		if (Links[id].Fd < 0) {
+			break;
+		}
+	}
+	if (id < 0) {
+		close(fd);
+		return;
+	}
+
+	/* Save link */
+	Links[id].Fd = fd;
+	Links[id].Udp = 0;
+	inet_ntop(AF_INET, &addr.sin_addr, Links[id].IP, sizeof(Links[id].IP));
+	Links[id].Port = ntohs(addr.sin_port);
+	Output("%d,CONNECT\r\n", id);
+}
+
+static void LinkReceive(int8_t id) {
+	uint8_t data[SIM_IPD_SIZE];
+	ssize_t len;
+
+	/* Read data from socket */
+	len = recv(Links[id].Fd, data, sizeof(data), 0);
+	if (len < 0 && (errno == EINTR || errno == EAGAIN)) {
+		return;
+	}
+	if (len <= 0) {
+		/* Remote side closed connection */
+		if (!Links[id].Udp) {
+			CloseLink(id, 1);
+		}
+		return;
+	}
+
+	/* Send +IPD statement with data */
+	if (!Mux) {
+		Output("\r\n+IPD,%d:", (int)len);
+	} else if (DInfo) {
+		Output("\r\n+IPD,%d,%d,%s,%d:", id, (int)len, Links[id].IP, Links[id].Port);
+	} else {
+		Output("\r\n+IPD,%d,%d:", id, (int)len);
+	}
+	OutputData(data, len);
+	StatIPD += len;
+}
+
+static void SignalHandler(int sig) {
+	/* Stop main loop */
+	Running = 0;
+}